@@ -0,0 +1,356 @@
+#include "executor-private.h"
+#include "cache-private.h"
+
+/* Auto-linking maps every audio and video stream of the auto-link inputs of
+ * a job to each of its auto-link outputs, with a copy of their meta
+ * profiles.
+ *
+ * Streams are discovered by running urisourcebin ! parsebin until parsebin
+ * has exposed all of its pads, each of them blocked as soon as it appears:
+ * inputs are only read as far as needed to tell their streams apart, and
+ * nothing is ever decoded. Inputs are probed concurrently on a pool of
+ * threads, each probe maps the streams it found once it is done. With a
+ * discovery cache, inputs found in it aren't probed at all.
+ */
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  /* GstTranscodingOutput, auto-link ones only */
+  GPtrArray *outputs;
+
+  /* Cancels the remaining probes once one has failed */
+  GCancellable *cancellable;
+  GMutex lock;
+  GCond cond;
+  guint n_pending;
+  GError *error;
+} AutoLinker;
+
+typedef struct
+{
+  GMutex lock;
+  GstTranscodingMediaInfo *info;
+} ProbeContext;
+
+static GstPadProbeReturn
+block_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+probe_pad_added_cb (GstElement *parsebin, GstPad *pad, ProbeContext *ctx)
+{
+  gchar *stream_id = gst_pad_get_stream_id (pad);
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  const gchar *name = "";
+  gint64 duration;
+
+  /* No data goes further than parsebin */
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, block_probe, NULL, NULL);
+
+  if (!caps)
+    caps = gst_pad_query_caps (pad, NULL);
+
+  if (gst_caps_get_size (caps))
+    name = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+
+  g_mutex_lock (&ctx->lock);
+
+  if (stream_id && (g_str_has_prefix (name, "video/") || g_str_has_prefix (name, "audio/"))) {
+    gchar *caps_str = gst_caps_to_string (caps);
+
+    _gst_transcoding_media_info_add_stream (ctx->info, stream_id,
+        g_str_has_prefix (name, "video/") ? VIDEO : AUDIO, caps_str);
+    g_free (caps_str);
+  }
+
+  /* Demuxers know it from the headers they already parsed */
+  if (gst_pad_query_duration (pad, GST_FORMAT_TIME, &duration) && duration >= 0 &&
+      (!GST_CLOCK_TIME_IS_VALID (ctx->info->duration) || (GstClockTime) duration > ctx->info->duration))
+    ctx->info->duration = duration;
+
+  g_mutex_unlock (&ctx->lock);
+
+  gst_caps_unref (caps);
+  g_free (stream_id);
+}
+
+static void
+probe_no_more_pads_cb (GstElement *parsebin, gpointer user_data)
+{
+  gst_element_post_message (parsebin,
+      gst_message_new_application (GST_OBJECT (parsebin), gst_structure_new_empty ("no-more-pads")));
+}
+
+/* Adds the audio and video streams of @input to @info */
+static gboolean
+probe_input (GstTranscodingInput *input, GstTranscodingMediaInfo *info, GCancellable *cancellable, GError **error)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstClockTime timeout = 100 * GST_MSECOND;
+  GstElement *parsebin;
+  ProbeContext ctx = { 0, };
+  gboolean ret = FALSE;
+  gboolean done = FALSE;
+  GstBus *bus;
+
+  g_mutex_init (&ctx.lock);
+  ctx.info = info;
+
+  parsebin = _gst_transcoding_make_parsed_source (GST_BIN (pipeline), input->uri, NULL, error);
+  if (!parsebin)
+    goto out;
+
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (probe_pad_added_cb), &ctx);
+  g_signal_connect (parsebin, "no-more-pads", G_CALLBACK (probe_no_more_pads_cb), NULL);
+
+  bus = gst_element_get_bus (pipeline);
+
+  /* Never reaches PAUSED, the pads are blocked before anything prerolls */
+  if (gst_element_set_state (pipeline, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE)
+    timeout = 0;
+
+  while (!done) {
+    GstMessage *msg;
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+      break;
+
+    msg = gst_bus_timed_pop_filtered (bus, timeout, GST_MESSAGE_APPLICATION | GST_MESSAGE_ERROR);
+
+    if (!msg) {
+      if (timeout == 0) {
+        g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+            "Could not probe %s", input->uri);
+        break;
+      }
+      continue;
+    }
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      GError *err = NULL;
+
+      gst_message_parse_error (msg, &err, NULL);
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Could not probe %s: %s", input->uri, err->message);
+      g_error_free (err);
+      done = TRUE;
+    } else if (gst_message_has_name (msg, "no-more-pads")) {
+      ret = done = TRUE;
+    }
+
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+
+out:
+  gst_object_unref (pipeline);
+  g_mutex_clear (&ctx.lock);
+
+  /* Inputs without any stream are still known, as such */
+  if (ret && !info->streams)
+    info->streams = g_ptr_array_new ();
+
+  return ret;
+}
+
+GstTranscodingMediaInfo *
+_gst_transcoding_probe_input (GstTranscodingInput *input, const gchar *cache, GCancellable *cancellable, GError **error)
+{
+  GstTranscodingMediaInfo *info = NULL;
+
+  if (cache)
+    info = _gst_transcoding_cache_lookup (cache, input->uri);
+
+  /* Entries written by the segmenter only know about keyframes */
+  if (!info || !info->streams) {
+    if (!info)
+      info = _gst_transcoding_media_info_new ();
+
+    if (!probe_input (input, info, cancellable, error)) {
+      _gst_transcoding_media_info_free (info);
+      return NULL;
+    }
+
+    if (cache)
+      _gst_transcoding_cache_store (cache, input->uri, info);
+  }
+
+  return info;
+}
+
+static gboolean
+input_is_mapped_to (GstTranscodingInput *input, const gchar *stream_id, GstTranscodingOutput *output)
+{
+  GPtrArray *profiles;
+  gboolean ret = FALSE;
+  guint i;
+
+  g_mutex_lock (&input->lock);
+
+  profiles = g_hash_table_lookup (input->profiles, stream_id);
+  for (i = 0; profiles && i < profiles->len && !ret; i++)
+    ret = _gst_transcoding_stream_profile_get_private (g_ptr_array_index (profiles, i))->output == output;
+
+  g_mutex_unlock (&input->lock);
+
+  return ret;
+}
+
+/* Streams already mapped to an output, by hand or by an earlier pass, are
+ * left alone */
+static gboolean
+auto_linker_link (AutoLinker *self, GstTranscodingInput *input, GPtrArray *streams, GError **error)
+{
+  guint i, j;
+
+  for (i = 0; i < streams->len; i++) {
+    GstTranscodingStreamInfo *stream = g_ptr_array_index (streams, i);
+
+    for (j = 0; j < self->outputs->len; j++) {
+      GstTranscodingOutput *output = g_ptr_array_index (self->outputs, j);
+      GstTranscodingStreamProfile *profile;
+
+      if (input_is_mapped_to (input, stream->stream_id, output))
+        continue;
+
+      if (stream->media_type == VIDEO)
+        profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (self->job, input->uri,
+            stream->stream_id, output->uri);
+      else
+        profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (self->job, input->uri,
+            stream->stream_id, output->uri);
+
+      if (!profile) {
+        g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+            "Stream %s of %s is already mapped as another media type", stream->stream_id, input->uri);
+        return FALSE;
+      }
+
+      g_object_unref (profile);
+    }
+  }
+
+  return TRUE;
+}
+
+static void
+auto_linker_run_probe (GstTranscodingInput *input, AutoLinker *self)
+{
+  GstTranscodingMediaInfo *info;
+  GError *error = NULL;
+  gboolean ret;
+
+  info = _gst_transcoding_probe_input (input, self->job->discovery_cache, self->cancellable, &error);
+  ret = info && auto_linker_link (self, input, info->streams, &error);
+
+  if (!ret) {
+    g_mutex_lock (&self->lock);
+    if (!self->error) {
+      self->error = error;
+      g_cancellable_cancel (self->cancellable);
+    } else {
+      g_error_free (error);
+    }
+    g_mutex_unlock (&self->lock);
+  }
+
+  if (info)
+    _gst_transcoding_media_info_free (info);
+
+  g_mutex_lock (&self->lock);
+  self->n_pending--;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+cancelled_cb (GCancellable *cancellable, GCancellable *ours)
+{
+  g_cancellable_cancel (ours);
+}
+
+gboolean
+gst_transcoding_job_auto_link (GstTranscodingJob *self, guint max_probes, GCancellable *cancellable, GError **error)
+{
+  AutoLinker linker = { 0, };
+  GPtrArray *inputs = g_ptr_array_new ();
+  GHashTableIter iter;
+  GstTranscodingInput *input;
+  GstTranscodingOutput *output;
+  GThreadPool *pool = NULL;
+  gulong cancelled_id = 0;
+  gboolean ret = TRUE;
+  guint i;
+
+  linker.job = self;
+  linker.outputs = g_ptr_array_new ();
+
+  g_mutex_lock (&self->lock);
+
+  g_hash_table_iter_init (&iter, self->inputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &input)) {
+    if (input->auto_link)
+      g_ptr_array_add (inputs, input);
+  }
+
+  g_hash_table_iter_init (&iter, self->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &output)) {
+    if (output->auto_link)
+      g_ptr_array_add (linker.outputs, output);
+  }
+
+  g_mutex_unlock (&self->lock);
+
+  /* Nothing to probe, or nothing to map the probed streams to */
+  if (!inputs->len || !linker.outputs->len)
+    goto out;
+
+  pool = g_thread_pool_new ((GFunc) auto_linker_run_probe, &linker,
+      max_probes ? max_probes : g_get_num_processors (), FALSE, error);
+  if (!pool) {
+    ret = FALSE;
+    goto out;
+  }
+
+  linker.cancellable = g_cancellable_new ();
+  if (cancellable)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (cancelled_cb),
+        g_object_ref (linker.cancellable), g_object_unref);
+  g_mutex_init (&linker.lock);
+  g_cond_init (&linker.cond);
+
+  linker.n_pending = inputs->len;
+
+  for (i = 0; i < inputs->len; i++)
+    g_thread_pool_push (pool, g_ptr_array_index (inputs, i), NULL);
+
+  g_mutex_lock (&linker.lock);
+  while (linker.n_pending)
+    g_cond_wait (&linker.cond, &linker.lock);
+  g_mutex_unlock (&linker.lock);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (linker.error) {
+    g_propagate_error (error, linker.error);
+    ret = FALSE;
+  }
+
+  if (cancellable)
+    g_cancellable_disconnect (cancellable, cancelled_id);
+
+  g_mutex_clear (&linker.lock);
+  g_cond_clear (&linker.cond);
+  g_object_unref (linker.cancellable);
+
+out:
+  g_ptr_array_unref (linker.outputs);
+  g_ptr_array_unref (inputs);
+
+  return ret;
+}
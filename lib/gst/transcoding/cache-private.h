@@ -0,0 +1,59 @@
+#pragma once
+
+#include "job-private.h"
+
+G_BEGIN_DECLS
+
+/* What is known of an input without decoding it, as found by probing or
+ * scanning it, and kept in the discovery cache between runs */
+
+typedef struct
+{
+  gchar *stream_id;
+  MediaType media_type;
+  gchar *caps;
+} GstTranscodingStreamInfo;
+
+typedef struct
+{
+  /* GstTranscodingStreamInfo, in the order parsebin exposed them, NULL
+   * until the input has been probed */
+  GPtrArray *streams;
+  GstClockTime duration;
+  /* stream-id -> GArray of sorted GstClockTime, for scanned streams */
+  GHashTable *keyframes;
+  /* SHA-256 of the whole input, NULL until computed */
+  gchar *content_hash;
+} GstTranscodingMediaInfo;
+
+G_GNUC_INTERNAL
+GstTranscodingMediaInfo * _gst_transcoding_media_info_new (void);
+
+G_GNUC_INTERNAL
+void _gst_transcoding_media_info_free (GstTranscodingMediaInfo *info);
+
+G_GNUC_INTERNAL
+void _gst_transcoding_media_info_add_stream (GstTranscodingMediaInfo *info,
+                                             const gchar *stream_id,
+                                             MediaType media_type,
+                                             const gchar *caps);
+
+/* Returns the streams of @input, as found in the discovery cache @dir if
+ * not NULL, or by probing it, NULL on error */
+G_GNUC_INTERNAL
+GstTranscodingMediaInfo * _gst_transcoding_probe_input (GstTranscodingInput *input,
+                                                        const gchar *dir,
+                                                        GCancellable *cancellable,
+                                                        GError **error);
+
+/* Returns what is cached in @dir about @uri, NULL if nothing is or the
+ * input changed since */
+G_GNUC_INTERNAL
+GstTranscodingMediaInfo * _gst_transcoding_cache_lookup (const gchar *dir, const gchar *uri);
+
+/* Replaces what is cached in @dir about @uri. Failing to is not an error,
+ * the input is probed again next time. */
+G_GNUC_INTERNAL
+void _gst_transcoding_cache_store (const gchar *dir, const gchar *uri, GstTranscodingMediaInfo *info);
+
+G_END_DECLS
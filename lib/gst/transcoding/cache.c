@@ -0,0 +1,240 @@
+#include <errno.h>
+#include <gst/gst.h>
+#include "cache-private.h"
+
+/* Discovery cache: one file per input in the cache directory, named after
+ * the checksum of its URI, holding a little endian serialized GVariant of
+ * CACHE_FORMAT:
+ *
+ * - format version, URI, then the size and modification time (in
+ *   microseconds) the input had when it was looked at: entries whose input
+ *   doesn't match them anymore are ignored
+ * - duration, streams (id, media type, caps) if the input was probed, the
+ *   keyframes of each scanned stream, and the checksum of the content of
+ *   the input, empty if it wasn't computed
+ */
+
+#define CACHE_VERSION 2
+#define CACHE_FORMAT "(ustttma(sys)a{sat}s)"
+
+static void
+stream_info_free (GstTranscodingStreamInfo *stream)
+{
+  g_free (stream->stream_id);
+  g_free (stream->caps);
+  g_free (stream);
+}
+
+GstTranscodingMediaInfo *
+_gst_transcoding_media_info_new (void)
+{
+  GstTranscodingMediaInfo *info = g_new0 (GstTranscodingMediaInfo, 1);
+
+  info->duration = GST_CLOCK_TIME_NONE;
+  info->keyframes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+
+  return info;
+}
+
+void
+_gst_transcoding_media_info_free (GstTranscodingMediaInfo *info)
+{
+  if (info->streams)
+    g_ptr_array_unref (info->streams);
+  g_hash_table_unref (info->keyframes);
+  g_free (info->content_hash);
+  g_free (info);
+}
+
+void
+_gst_transcoding_media_info_add_stream (GstTranscodingMediaInfo *info,
+                                        const gchar *stream_id,
+                                        MediaType media_type,
+                                        const gchar *caps)
+{
+  GstTranscodingStreamInfo *stream = g_new0 (GstTranscodingStreamInfo, 1);
+
+  if (!info->streams)
+    info->streams = g_ptr_array_new_with_free_func ((GDestroyNotify) stream_info_free);
+
+  stream->stream_id = g_strdup (stream_id);
+  stream->media_type = media_type;
+  stream->caps = g_strdup (caps);
+  g_ptr_array_add (info->streams, stream);
+}
+
+/* Only inputs with a size and modification time can be cached */
+static gboolean
+cache_stat (const gchar *uri, guint64 *size, guint64 *mtime)
+{
+  GFile *file = g_file_new_for_uri (uri);
+  GFileInfo *info;
+  gboolean ret = FALSE;
+
+  info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+      G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  if (info && g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) &&
+      g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED)) {
+    *size = g_file_info_get_size (info);
+    *mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+      g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+    ret = TRUE;
+  }
+
+  g_clear_object (&info);
+  g_object_unref (file);
+
+  return ret;
+}
+
+static gchar *
+cache_entry_path (const gchar *dir, const gchar *uri)
+{
+  gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  gchar *ret = g_build_filename (dir, checksum, NULL);
+
+  g_free (checksum);
+
+  return ret;
+}
+
+GstTranscodingMediaInfo *
+_gst_transcoding_cache_lookup (const gchar *dir, const gchar *uri)
+{
+  GstTranscodingMediaInfo *info = NULL;
+  guint64 size, mtime, cached_size, cached_mtime, duration;
+  GVariant *variant, *streams, *keyframes;
+  const gchar *cached_uri, *content_hash;
+  gchar *path, *contents;
+  gsize length;
+  GBytes *bytes;
+  guint32 version;
+
+  if (!cache_stat (uri, &size, &mtime))
+    return NULL;
+
+  path = cache_entry_path (dir, uri);
+  if (!g_file_get_contents (path, &contents, &length, NULL)) {
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+
+  /* Untrusted, a corrupted entry reads as default values, which don't
+   * match the input */
+  bytes = g_bytes_new_take (contents, length);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CACHE_FORMAT), bytes, FALSE));
+  g_bytes_unref (bytes);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (variant);
+
+    g_variant_unref (variant);
+    variant = swapped;
+  }
+
+  g_variant_get (variant, "(u&sttt@ma(sys)@a{sat}&s)", &version, &cached_uri, &cached_size, &cached_mtime,
+      &duration, &streams, &keyframes, &content_hash);
+
+  if (version == CACHE_VERSION && !g_strcmp0 (cached_uri, uri) && cached_size == size && cached_mtime == mtime) {
+    GVariant *maybe_streams = g_variant_get_maybe (streams);
+    GVariantIter iter;
+    const gchar *stream_id, *caps;
+    guchar media_type;
+    GVariant *timestamps;
+
+    info = _gst_transcoding_media_info_new ();
+    info->duration = duration;
+    if (*content_hash)
+      info->content_hash = g_strdup (content_hash);
+
+    if (maybe_streams) {
+      info->streams = g_ptr_array_new_with_free_func ((GDestroyNotify) stream_info_free);
+
+      g_variant_iter_init (&iter, maybe_streams);
+      while (g_variant_iter_next (&iter, "(&sy&s)", &stream_id, &media_type, &caps))
+        _gst_transcoding_media_info_add_stream (info, stream_id, media_type == VIDEO ? VIDEO : AUDIO, caps);
+
+      g_variant_unref (maybe_streams);
+    }
+
+    g_variant_iter_init (&iter, keyframes);
+    while (g_variant_iter_next (&iter, "{&s@at}", &stream_id, &timestamps)) {
+      GArray *array = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+      gsize n_timestamps;
+      gconstpointer data = g_variant_get_fixed_array (timestamps, &n_timestamps, sizeof (guint64));
+
+      g_array_append_vals (array, data, n_timestamps);
+      g_hash_table_insert (info->keyframes, g_strdup (stream_id), array);
+      g_variant_unref (timestamps);
+    }
+  }
+
+  g_variant_unref (streams);
+  g_variant_unref (keyframes);
+  g_variant_unref (variant);
+
+  return info;
+}
+
+void
+_gst_transcoding_cache_store (const gchar *dir, const gchar *uri, GstTranscodingMediaInfo *info)
+{
+  GVariantBuilder streams, keyframes;
+  GHashTableIter iter;
+  const gchar *stream_id;
+  GArray *timestamps;
+  guint64 size, mtime;
+  GVariant *variant;
+  GError *error = NULL;
+  gchar *path;
+  guint i;
+
+  if (!cache_stat (uri, &size, &mtime))
+    return;
+
+  g_variant_builder_init (&streams, G_VARIANT_TYPE ("a(sys)"));
+  for (i = 0; info->streams && i < info->streams->len; i++) {
+    GstTranscodingStreamInfo *stream = g_ptr_array_index (info->streams, i);
+
+    g_variant_builder_add (&streams, "(sys)", stream->stream_id, (guchar) stream->media_type,
+        stream->caps ? stream->caps : "");
+  }
+
+  g_variant_builder_init (&keyframes, G_VARIANT_TYPE ("a{sat}"));
+  g_hash_table_iter_init (&iter, info->keyframes);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &stream_id, (gpointer *) &timestamps)) {
+    if (timestamps->len)
+      g_variant_builder_add (&keyframes, "{s@at}", stream_id,
+          g_variant_new_fixed_array (G_VARIANT_TYPE_UINT64, timestamps->data, timestamps->len, sizeof (guint64)));
+  }
+
+  variant = g_variant_ref_sink (g_variant_new ("(usttt@ma(sys)a{sat}s)", CACHE_VERSION, uri, size, mtime,
+      info->duration, g_variant_new_maybe (G_VARIANT_TYPE ("a(sys)"),
+          info->streams ? g_variant_builder_end (&streams) : NULL), &keyframes,
+      info->content_hash ? info->content_hash : ""));
+
+  if (!info->streams)
+    g_variant_builder_clear (&streams);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (variant);
+
+    g_variant_unref (variant);
+    variant = swapped;
+  }
+
+  path = cache_entry_path (dir, uri);
+
+  /* Written to a temporary file then renamed, concurrent readers see
+   * either version */
+  if (g_mkdir_with_parents (dir, 0755) < 0 ||
+      !g_file_set_contents (path, g_variant_get_data (variant), g_variant_get_size (variant), &error)) {
+    GST_WARNING ("Could not cache what is known of %s: %s", uri, error ? error->message : g_strerror (errno));
+    g_clear_error (&error);
+  }
+
+  g_free (path);
+  g_variant_unref (variant);
+}
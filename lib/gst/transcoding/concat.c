@@ -0,0 +1,396 @@
+#include <glib/gstdio.h>
+#include "executor-private.h"
+#include "cache-private.h"
+
+/* Outputs with a sequence play their inputs one after the other:
+ *
+ * - each input of the sequence is transcoded on its own, into an
+ *   intermediate matroska file holding the streams it maps to the output
+ * - streams are compared across the inputs as parsed, without decoding:
+ *   a stream is copied from every input if it is already in the format of
+ *   its profile, with the same caps, in all of them, and re-encoded from
+ *   every input otherwise, as the output can't switch between the two
+ * - the intermediate files are then concatenated, each one following the
+ *   previous one in time, into the actual output, without re-encoding
+ *
+ * Outputs without a sequence are transcoded together, by a job of their
+ * own, before the sequences.
+ */
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  GCancellable *cancellable;
+  gchar *tmpdir;
+  /* Input URI -> GstTranscodingMediaInfo, probed once for all outputs */
+  GHashTable *infos;
+} Concatenator;
+
+typedef struct
+{
+  GstTranscodingInput *input;
+  /* GstTranscodingStreamProfile mapping the input to the output, and their
+   * stream-ids, in the order the executor requests their muxer pads */
+  GPtrArray *profiles;
+  GPtrArray *stream_ids;
+  /* Whether each of the profiles copies its stream */
+  gboolean *copy;
+  gchar *path;
+} Piece;
+
+static void
+piece_clear (Piece *piece)
+{
+  if (piece->path)
+    g_remove (piece->path);
+
+  g_ptr_array_unref (piece->profiles);
+  g_ptr_array_unref (piece->stream_ids);
+  g_free (piece->copy);
+  g_free (piece->path);
+}
+
+static void
+piece_init (Piece *piece, GstTranscodingInput *input, GstTranscodingOutput *output)
+{
+  GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *tmp;
+
+  piece->input = input;
+  piece->profiles = g_ptr_array_new ();
+  piece->stream_ids = g_ptr_array_new ();
+
+  for (tmp = stream_ids; tmp; tmp = tmp->next) {
+    GPtrArray *profiles = g_hash_table_lookup (input->profiles, tmp->data);
+    guint i;
+
+    for (i = 0; i < profiles->len; i++) {
+      GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+
+      if (_gst_transcoding_stream_profile_get_private (profile)->output == output) {
+        g_ptr_array_add (piece->profiles, profile);
+        g_ptr_array_add (piece->stream_ids, tmp->data);
+      }
+    }
+  }
+
+  g_list_free (stream_ids);
+
+  piece->copy = g_new0 (gboolean, piece->profiles->len);
+}
+
+/* Parsed caps of @stream_id, NULL if @input has no such stream */
+static GstCaps *
+concatenator_get_caps (Concatenator *self, GstTranscodingInput *input, const gchar *stream_id, GError **error)
+{
+  GstTranscodingMediaInfo *info = g_hash_table_lookup (self->infos, input->uri);
+  guint i;
+
+  if (!info) {
+    info = _gst_transcoding_probe_input (input, self->job->discovery_cache, self->cancellable, error);
+    if (!info)
+      return NULL;
+
+    g_hash_table_insert (self->infos, input->uri, info);
+  }
+
+  for (i = 0; i < info->streams->len; i++) {
+    GstTranscodingStreamInfo *stream = g_ptr_array_index (info->streams, i);
+
+    if (!g_strcmp0 (stream->stream_id, stream_id))
+      return gst_caps_from_string (stream->caps);
+  }
+
+  return NULL;
+}
+
+/* Decides which streams of which pieces are copied */
+static gboolean
+concatenator_compare_pieces (Concatenator *self, GstTranscodingOutput *output, GArray *pieces, GError **error)
+{
+  Piece *first = &g_array_index (pieces, Piece, 0);
+  guint i, k;
+
+  for (i = 1; i < pieces->len; i++) {
+    Piece *piece = &g_array_index (pieces, Piece, i);
+    gboolean same = piece->profiles->len == first->profiles->len;
+
+    for (k = 0; k < first->profiles->len && same; k++)
+      same = _gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (piece->profiles, k)) ==
+        _gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (first->profiles, k));
+
+    if (!same) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+          "%s and %s don't map the same streams to %s", first->input->uri, piece->input->uri, output->uri);
+      return FALSE;
+    }
+  }
+
+  for (k = 0; k < first->profiles->len; k++) {
+    GstCaps *reference = NULL;
+    gboolean copy = TRUE;
+
+    for (i = 0; i < pieces->len && copy; i++) {
+      Piece *piece = &g_array_index (pieces, Piece, i);
+      const GstTranscodingStreamSettings *settings =
+        _gst_transcoding_stream_profile_get_settings (g_ptr_array_index (piece->profiles, k));
+      GError *probe_error = NULL;
+      GstCaps *caps;
+
+      /* Passthrough anyway */
+      if (settings->format == GST_TRANSCODING_FORMAT_NONE)
+        continue;
+
+      if (!_gst_transcoding_stream_settings_allow_copy (settings)) {
+        copy = FALSE;
+        continue;
+      }
+
+      caps = concatenator_get_caps (self, piece->input, g_ptr_array_index (piece->stream_ids, k), &probe_error);
+
+      if (probe_error) {
+        g_propagate_error (error, probe_error);
+        if (reference)
+          gst_caps_unref (reference);
+        return FALSE;
+      }
+
+      if (!caps || !_gst_transcoding_format_matches_caps (settings->format, caps))
+        copy = FALSE;
+      else if (!reference)
+        reference = gst_caps_ref (caps);
+      else
+        copy = gst_caps_is_equal (caps, reference);
+
+      if (caps)
+        gst_caps_unref (caps);
+    }
+
+    if (reference)
+      gst_caps_unref (reference);
+
+    for (i = 0; i < pieces->len; i++)
+      g_array_index (pieces, Piece, i).copy[k] = copy;
+  }
+
+  return TRUE;
+}
+
+/* Transcodes the streams @piece maps to the output, and only those, into
+ * its intermediate file */
+static GstTranscodingJob *
+concatenator_create_piece_job (Concatenator *self, Piece *piece)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+  GstTranscodingInput *input;
+  gchar *uri = gst_filename_to_uri (piece->path, NULL);
+  guint k;
+
+  job->segment_duration = self->job->segment_duration;
+  job->smart_render = self->job->smart_render;
+  job->max_workers = self->job->max_workers;
+  job->worker_executable = g_strdup (self->job->worker_executable);
+  job->discovery_cache = g_strdup (self->job->discovery_cache);
+  job->encoder_threads = self->job->encoder_threads;
+  job->queue_max_bytes = self->job->queue_max_bytes;
+
+  gst_transcoding_container_profile_set_format (cprof, GST_TRANSCODING_FORMAT_MATROSKA);
+  g_object_unref (gst_transcoding_job_add_output (job, uri, cprof));
+
+  for (k = 0; k < piece->profiles->len; k++) {
+    GstTranscodingStreamProfile *profile = g_ptr_array_index (piece->profiles, k);
+    const gchar *stream_id = g_ptr_array_index (piece->stream_ids, k);
+    GstTranscodingStreamProfile *copy;
+
+    if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+      copy = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, piece->input->uri, stream_id, uri);
+    else
+      copy = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, piece->input->uri, stream_id, uri);
+
+    _gst_transcoding_stream_profile_copy_into (profile, copy);
+    if (piece->copy[k])
+      gst_transcoding_stream_profile_set_format (copy, GST_TRANSCODING_FORMAT_NONE);
+    g_object_unref (copy);
+  }
+
+  if ((input = g_hash_table_lookup (job->inputs, piece->input->uri))) {
+    input->start = piece->input->start;
+    input->stop = piece->input->stop;
+  }
+
+  g_free (uri);
+
+  return job;
+}
+
+static gboolean
+concatenator_run_output (Concatenator *self, GstTranscodingOutput *output, guint index, GError **error)
+{
+  GArray *pieces = g_array_new (FALSE, TRUE, sizeof (Piece));
+  gchar **paths = NULL;
+  gboolean ret = TRUE;
+  guint i;
+
+  g_array_set_clear_func (pieces, (GDestroyNotify) piece_clear);
+
+  for (i = 0; output->sequence[i] && ret; i++) {
+    GstTranscodingInput *input = g_hash_table_lookup (self->job->inputs, output->sequence[i]);
+    Piece piece = { 0, };
+
+    if (!input) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Sequence of %s names %s, which isn't an input of the job", output->uri, output->sequence[i]);
+      ret = FALSE;
+      break;
+    }
+
+    piece_init (&piece, input, output);
+    g_array_append_val (pieces, piece);
+  }
+
+  if (!ret || !pieces->len)
+    goto out;
+
+  if (!(ret = concatenator_compare_pieces (self, output, pieces, error)))
+    goto out;
+
+  paths = g_new0 (gchar *, pieces->len + 1);
+
+  for (i = 0; i < pieces->len && ret; i++) {
+    Piece *piece = &g_array_index (pieces, Piece, i);
+    gchar *filename = g_strdup_printf ("piece-%03u-%05u.mkv", index, i);
+    GstTranscodingJob *job;
+
+    piece->path = g_build_filename (self->tmpdir, filename, NULL);
+    paths[i] = piece->path;
+    g_free (filename);
+
+    job = concatenator_create_piece_job (self, piece);
+    ret = gst_transcoding_job_run (job, self->cancellable, error);
+    g_object_unref (job);
+  }
+
+  ret = ret && _gst_transcoding_stitch (self->job, g_array_index (pieces, Piece, 0).input, output,
+      paths, pieces->len, NULL, self->cancellable, error);
+
+out:
+  /* Points to the paths of the pieces */
+  g_free (paths);
+  g_array_unref (pieces);
+
+  return ret;
+}
+
+/* Same job, without the outputs that have a sequence. NULL if all of them
+ * do. */
+static GstTranscodingJob *
+concatenator_create_rest_job (Concatenator *self)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GHashTableIter iter;
+  GstTranscodingOutput *output;
+  GstTranscodingInput *input;
+
+  job->segment_duration = self->job->segment_duration;
+  job->smart_render = self->job->smart_render;
+  job->max_workers = self->job->max_workers;
+  job->worker_executable = g_strdup (self->job->worker_executable);
+  job->discovery_cache = g_strdup (self->job->discovery_cache);
+  job->encoder_threads = self->job->encoder_threads;
+  job->queue_max_bytes = self->job->queue_max_bytes;
+
+  g_hash_table_iter_init (&iter, self->job->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &output)) {
+    GstTranscodingContainerProfile *cprof;
+
+    if (output->sequence)
+      continue;
+
+    cprof = gst_transcoding_container_profile_new (NULL, NULL);
+    gst_transcoding_container_profile_set_format (cprof, output->profile->format);
+    g_object_unref (gst_transcoding_job_add_output (job, output->uri, cprof));
+  }
+
+  if (!g_hash_table_size (job->outputs)) {
+    g_object_unref (job);
+    return NULL;
+  }
+
+  g_hash_table_iter_init (&iter, self->job->inputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &input)) {
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *tmp;
+    GstTranscodingInput *copy;
+
+    for (tmp = stream_ids; tmp; tmp = tmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, tmp->data);
+      guint i;
+
+      for (i = 0; i < profiles->len; i++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+        GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+        GstTranscodingStreamProfile *mapped;
+
+        if (priv->output->sequence)
+          continue;
+
+        if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+          mapped = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, input->uri, tmp->data,
+              priv->output->uri);
+        else
+          mapped = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, input->uri, tmp->data,
+              priv->output->uri);
+
+        _gst_transcoding_stream_profile_copy_into (profile, mapped);
+        g_object_unref (mapped);
+      }
+    }
+
+    g_list_free (stream_ids);
+
+    if ((copy = g_hash_table_lookup (job->inputs, input->uri))) {
+      copy->start = input->start;
+      copy->stop = input->stop;
+    }
+  }
+
+  return job;
+}
+
+gboolean
+_gst_transcoding_concat_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error)
+{
+  Concatenator self = { 0, };
+  GstTranscodingJob *rest;
+  GList *uris, *tmp;
+  gboolean ret = TRUE;
+  guint index = 0;
+
+  self.tmpdir = g_dir_make_tmp ("gst-transcoding-XXXXXX", error);
+  if (!self.tmpdir)
+    return FALSE;
+
+  self.job = job;
+  self.cancellable = cancellable;
+  self.infos = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) _gst_transcoding_media_info_free);
+
+  if ((rest = concatenator_create_rest_job (&self))) {
+    ret = gst_transcoding_job_run (rest, cancellable, error);
+    g_object_unref (rest);
+  }
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs);
+
+  for (tmp = uris; tmp && ret; tmp = tmp->next) {
+    GstTranscodingOutput *output = g_hash_table_lookup (job->outputs, tmp->data);
+
+    if (output->sequence)
+      ret = concatenator_run_output (&self, output, index++, error);
+  }
+
+  g_list_free (uris);
+  g_hash_table_unref (self.infos);
+  g_rmdir (self.tmpdir);
+  g_free (self.tmpdir);
+
+  return ret;
+}
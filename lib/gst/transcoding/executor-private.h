@@ -0,0 +1,77 @@
+#pragma once
+
+#include <gst/gst.h>
+#include "format-private.h"
+
+G_BEGIN_DECLS
+
+/* Pipeline building blocks shared by the executor and the code that splits
+ * or stitches jobs around it. */
+
+G_GNUC_INTERNAL
+GList * _gst_transcoding_hash_table_get_sorted_keys (GHashTable *table);
+
+G_GNUC_INTERNAL
+GstElement * _gst_transcoding_make_element (const gchar *factory_name, GError **error);
+
+G_GNUC_INTERNAL
+GstElement * _gst_transcoding_make_element_for_format (GstElementFactoryListType type,
+                                                       GstTranscodingFormat format,
+                                                       GError **error);
+
+G_GNUC_INTERNAL
+GstPad * _gst_transcoding_element_request_pad_for_media_type (GstElement *element, MediaType media_type);
+
+/* Adds urisourcebin ! parsebin to @bin, returns the parsebin and, if
+ * @source isn't NULL, the urisourcebin */
+G_GNUC_INTERNAL
+GstElement * _gst_transcoding_make_parsed_source (GstBin *bin,
+                                                  const gchar *uri,
+                                                  GstElement **source,
+                                                  GError **error);
+
+/* Sets @pipeline to PLAYING and waits for EOS or an error, then sets it to
+ * @final_state */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_pipeline_run (GstElement *pipeline,
+                                        GstState final_state,
+                                        GCancellable *cancellable,
+                                        GError **error);
+
+/* Upper bounds of the number of encoders and queues running @job creates */
+G_GNUC_INTERNAL
+void _gst_transcoding_job_estimate_cost (GstTranscodingJob *job, guint *n_encoders, guint *n_queues);
+
+/* Runs @job as a single pipeline */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_executor_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error);
+
+/* Runs @job, which has a single input, in keyframe-aligned chunks, or
+ * smart-rendered */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_segment_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error);
+
+/* Concatenates the matroska files @paths, in order, into @output. Their
+ * streams are those @input maps to @output, named as the executor requests
+ * its muxer pads ("video_0", "audio_0"...). Unless @audio_path is NULL, the
+ * encoded audio streams are read from it as a whole instead. */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_stitch (GstTranscodingJob *job,
+                                  GstTranscodingInput *input,
+                                  GstTranscodingOutput *output,
+                                  gchar **paths,
+                                  guint n_paths,
+                                  const gchar *audio_path,
+                                  GCancellable *cancellable,
+                                  GError **error);
+
+/* Runs @job, which has outputs playing their inputs in sequence */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_concat_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error);
+
+/* Runs @job, copying the outputs found in its output cache instead of
+ * transcoding them */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_output_cache_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error);
+
+G_END_DECLS
@@ -0,0 +1,1485 @@
+#include <string.h>
+#include <gst/gst.h>
+#include "executor-private.h"
+
+/* The executor turns a job into a single pipeline:
+ *
+ * urisourcebin ! parsebin ! tee ! queue ! decodebin ! tee ! queue ! convert ! encoder ! muxer ! sink
+ *                               |                         ! queue ! convert ! encoder ! muxer ! sink
+ *                               ! queue ! muxer ! sink
+ *
+ * Each mapped stream of each input is parsed and decoded at most once, its
+ * decoded output is then teed to one encoding branch per distinct stream
+ * profile: equal profiles share a single encoder, teed to all their muxers.
+ * Encoded streams go through the parser of their format, when there is one,
+ * which converts them to the stream format their muxer takes.
+ * Passthrough profiles (GST_TRANSCODING_FORMAT_NONE) are fed straight from
+ * the parser, and a stream with only passthrough profiles is never decoded.
+ * Muxer pads are requested upfront, in a deterministic order, so that muxers
+ * know how many streams to wait for before they start producing data.
+ *
+ * Streams nothing is mapped to are left as the demuxer outputs them, with
+ * their data dropped right there: they are never parsed nor queued.
+ *
+ * Inputs with a time range have their parsed pads blocked until all of them
+ * are exposed, the input is then seeked before any data reaches a branch.
+ *
+ * All the branches are built before the pipeline starts, parsebin and
+ * decodebin pads only get linked to them. Once a job is done its pipeline
+ * is set to READY and kept idle, up to a limit, to run the next job of the
+ * same topology: same URI schemes, container formats, number of streams
+ * and stream profiles. Only the URIs are then changed, which saves creating
+ * the elements and getting them to READY again.
+ */
+
+typedef struct _Executor Executor;
+typedef struct _InputContext InputContext;
+
+typedef struct
+{
+  GstTranscodingOutput *output;
+  GstElement *muxer;
+  GstElement *sink;
+  guint n_streams;
+} OutputBranch;
+
+typedef struct
+{
+  InputContext *input;
+  /* Where parsed data goes */
+  GstElement *tee;
+  /* Where decoded data goes, NULL if the stream isn't decoded */
+  GstElement *decoded_tee;
+} StreamBranch;
+
+struct _InputContext
+{
+  Executor *executor;
+  GstTranscodingInput *input;
+  GstElement *src;
+  /* StreamBranch, in stream-id order */
+  GPtrArray *branches;
+  /* stream-id -> StreamBranch */
+  GHashTable *streams;
+  /* stream-ids exposed by parsebin so far, protected by the executor lock */
+  GHashTable *seen;
+  /* BlockedPad, held back until the input has been seeked to its range */
+  GPtrArray *blocked;
+  /* fakesinks of the streams nothing is mapped to, protected by the
+   * executor lock */
+  GPtrArray *dropped;
+};
+
+struct _Executor
+{
+  GstTranscodingJob *job;
+  GstElement *pipeline;
+  /* Key of the idle pipelines the executor can be exchanged with */
+  gchar *topology;
+
+  /* OutputBranch, in URI order */
+  GPtrArray *outputs;
+  /* InputContext, in URI order */
+  GPtrArray *inputs;
+  /* GstTranscodingStreamProfile -> GstPad, where the profile's branch ends,
+   * only while preparing */
+  GHashTable *profile_pads;
+
+  GMutex lock;
+};
+
+typedef struct
+{
+  GstPad *pad;
+  gulong probe_id;
+} BlockedPad;
+
+/* Idle executors, by topology, and how many of them there are in all */
+static GMutex pool_lock;
+static GHashTable *pool;
+static guint pool_size;
+static guint pool_max_size;
+
+static void
+blocked_pad_free (BlockedPad *blocked)
+{
+  gst_object_unref (blocked->pad);
+  g_free (blocked);
+}
+
+static void
+input_context_free (InputContext *ctx)
+{
+  g_ptr_array_unref (ctx->dropped);
+  g_ptr_array_unref (ctx->blocked);
+  g_hash_table_unref (ctx->seen);
+  g_hash_table_unref (ctx->streams);
+  g_ptr_array_unref (ctx->branches);
+  g_free (ctx);
+}
+
+GList *
+_gst_transcoding_hash_table_get_sorted_keys (GHashTable *table)
+{
+  return g_list_sort (g_hash_table_get_keys (table), (GCompareFunc) strcmp);
+}
+
+GstElement *
+_gst_transcoding_make_element (const gchar *factory_name, GError **error)
+{
+  GstElement *ret = gst_element_factory_make (factory_name, NULL);
+
+  if (!ret)
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_MISSING_ELEMENT,
+        "Missing element '%s'", factory_name);
+
+  return ret;
+}
+
+GstElement *
+_gst_transcoding_make_element_for_format (GstElementFactoryListType type, GstTranscodingFormat format, GError **error)
+{
+  GstElementFactory *factory = _gst_transcoding_find_factory_for_format (type, format);
+  GstElement *ret = NULL;
+
+  if (factory) {
+    ret = gst_element_factory_create (factory, NULL);
+    gst_object_unref (factory);
+  }
+
+  if (!ret)
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_MISSING_ELEMENT,
+        "No element available to produce %s", g_quark_to_string (format));
+
+  return ret;
+}
+
+GstPad *
+_gst_transcoding_element_request_pad_for_media_type (GstElement *element, MediaType media_type)
+{
+  const gchar *prefix = media_type == VIDEO ? "video/" : "audio/";
+  GList *tmp;
+  GstPad *ret = NULL;
+
+  tmp = gst_element_class_get_pad_template_list (GST_ELEMENT_GET_CLASS (element));
+
+  for (; tmp && !ret; tmp = tmp->next) {
+    GstPadTemplate *templ = tmp->data;
+    GstCaps *caps;
+    guint i;
+
+    if (GST_PAD_TEMPLATE_DIRECTION (templ) != GST_PAD_SINK ||
+        GST_PAD_TEMPLATE_PRESENCE (templ) != GST_PAD_REQUEST)
+      continue;
+
+    caps = gst_pad_template_get_caps (templ);
+
+    for (i = 0; i < gst_caps_get_size (caps); i++) {
+      const gchar *name = gst_structure_get_name (gst_caps_get_structure (caps, i));
+
+      if (g_str_has_prefix (name, prefix)) {
+        ret = gst_element_request_pad (element, templ, NULL, NULL);
+        break;
+      }
+    }
+
+    gst_caps_unref (caps);
+  }
+
+  return ret;
+}
+
+static gboolean
+input_has_range (GstTranscodingInput *input)
+{
+  return GST_CLOCK_TIME_IS_VALID (input->start) || GST_CLOCK_TIME_IS_VALID (input->stop);
+}
+
+static GstPadProbeReturn
+block_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+drop_data_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  return GST_PAD_PROBE_DROP;
+}
+
+/* Raw audio can be cut anywhere: the buffer running past @stop is cut
+ * there, or the next range, seeked to @stop, would repeat its end */
+static GstBuffer *
+clip_raw_audio (GstPad *pad, GstBuffer *buf, GstClockTime stop)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  GstStructure *structure;
+  guint64 n_frames, n_kept;
+  gint rate;
+
+  if (!caps)
+    return buf;
+
+  structure = gst_caps_get_structure (caps, 0);
+
+  if (gst_structure_has_name (structure, "audio/x-raw") &&
+      g_strcmp0 (gst_structure_get_string (structure, "layout"), "non-interleaved") &&
+      gst_structure_get_int (structure, "rate", &rate) && rate > 0) {
+    gsize size = gst_buffer_get_size (buf);
+
+    n_frames = gst_util_uint64_scale_round (GST_BUFFER_DURATION (buf), rate, GST_SECOND);
+    n_kept = gst_util_uint64_scale_round (stop - GST_BUFFER_PTS (buf), rate, GST_SECOND);
+
+    if (n_frames && size % n_frames == 0 && n_kept < n_frames) {
+      buf = gst_buffer_make_writable (buf);
+      gst_buffer_resize (buf, 0, n_kept * (size / n_frames));
+      GST_BUFFER_DURATION (buf) = stop - GST_BUFFER_PTS (buf);
+    }
+  }
+
+  gst_caps_unref (caps);
+
+  return buf;
+}
+
+/* Decoders clip to the seek segment, passthrough data has to be clipped by
+ * us. It starts on the keyframe the input was seeked to, as it can't start
+ * anywhere else without being re-encoded, and only gets cut at the stop.
+ * The input is looked up on each buffer, it changes when the pipeline is
+ * reused. */
+static GstPadProbeReturn
+clip_to_range_probe (GstPad *pad, GstPadProbeInfo *info, InputContext *ctx)
+{
+  GstTranscodingInput *input = ctx->input;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts) || !GST_CLOCK_TIME_IS_VALID (input->stop))
+    return GST_PAD_PROBE_OK;
+
+  if (pts >= input->stop)
+    return GST_PAD_PROBE_DROP;
+
+  if (GST_BUFFER_DURATION_IS_VALID (buf) && pts + GST_BUFFER_DURATION (buf) > input->stop)
+    GST_PAD_PROBE_INFO_DATA (info) = clip_raw_audio (pad, buf, input->stop);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstElement *
+executor_make_queue (Executor *self)
+{
+  GstElement *queue = gst_element_factory_make ("queue", NULL);
+
+  if (self->job->queue_max_bytes)
+    g_object_set (queue, "max-size-bytes", self->job->queue_max_bytes, NULL);
+
+  return queue;
+}
+
+static void
+executor_post_error (Executor *self, GError *error)
+{
+  gst_element_post_message (self->pipeline,
+      gst_message_new_error (GST_OBJECT (self->pipeline), error, NULL));
+  g_error_free (error);
+}
+
+static gboolean
+executor_add_output (Executor *self, GstTranscodingOutput *output, GError **error)
+{
+  OutputBranch *branch = g_new0 (OutputBranch, 1);
+  GstTranscodingFormat format = output->profile->format;
+
+  branch->output = output;
+  g_ptr_array_add (self->outputs, branch);
+
+  branch->sink = gst_element_make_from_uri (GST_URI_SINK, output->uri, NULL, error);
+  if (!branch->sink)
+    return FALSE;
+
+  gst_bin_add (GST_BIN (self->pipeline), branch->sink);
+
+  /* No muxer, the only stream of this output goes straight to the sink */
+  if (format == GST_TRANSCODING_FORMAT_NONE)
+    return TRUE;
+
+  branch->muxer = _gst_transcoding_make_element_for_format (GST_ELEMENT_FACTORY_TYPE_MUXER, format, error);
+  if (!branch->muxer)
+    return FALSE;
+
+  gst_bin_add (GST_BIN (self->pipeline), branch->muxer);
+
+  if (!gst_element_link (branch->muxer, branch->sink)) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not link muxer to the sink for %s", output->uri);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static OutputBranch *
+executor_find_output (Executor *self, GstTranscodingOutput *output)
+{
+  guint i;
+
+  for (i = 0; i < self->outputs->len; i++) {
+    OutputBranch *branch = g_ptr_array_index (self->outputs, i);
+
+    if (branch->output == output)
+      return branch;
+  }
+
+  return NULL;
+}
+
+static gboolean
+executor_add_profile (Executor *self, GstTranscodingStreamProfile *profile, GError **error)
+{
+  GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+  OutputBranch *branch = executor_find_output (self, priv->output);
+  GstPad *pad = NULL;
+
+  if (branch->muxer)
+    pad = _gst_transcoding_element_request_pad_for_media_type (branch->muxer, _gst_transcoding_stream_profile_get_media_type (profile));
+  else if (branch->n_streams == 0)
+    pad = gst_element_get_static_pad (branch->sink, "sink");
+
+  if (!pad) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+        "%s can't hold %u streams", priv->output->uri, branch->n_streams + 1);
+    return FALSE;
+  }
+
+  branch->n_streams++;
+  g_hash_table_insert (self->profile_pads, profile, pad);
+
+  return TRUE;
+}
+
+static gboolean
+executor_link_to_profile (Executor *self, GstElement *element, GstTranscodingStreamProfile *profile)
+{
+  GstPad *sinkpad = g_hash_table_lookup (self->profile_pads, profile);
+  GstPad *srcpad = gst_element_get_static_pad (element, "src");
+  gboolean ret = gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK;
+
+  gst_object_unref (srcpad);
+
+  return ret;
+}
+
+/* Profiles that would produce the same encoded stream share an encoder */
+static GPtrArray *
+group_equal_profiles (GPtrArray *profiles)
+{
+  GPtrArray *groups = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+  guint i, j;
+
+  for (i = 0; i < profiles->len; i++) {
+    GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+    GPtrArray *group = NULL;
+
+    for (j = 0; j < groups->len && !group; j++) {
+      GPtrArray *candidate = g_ptr_array_index (groups, j);
+
+      if (_gst_transcoding_stream_profile_equal (g_ptr_array_index (candidate, 0), profile))
+        group = candidate;
+    }
+
+    if (!group) {
+      group = g_ptr_array_new ();
+      g_ptr_array_add (groups, group);
+    }
+
+    g_ptr_array_add (group, profile);
+  }
+
+  return groups;
+}
+
+/* Encodes once for all the (equal) profiles in @group */
+static gboolean
+executor_encode_stream (Executor *self, GstElement *tee, GPtrArray *group, GError **error)
+{
+  GstTranscodingStreamProfile *profile = g_ptr_array_index (group, 0);
+  GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+  GstElement *queue, *convert, *encoder, *parser = NULL, *encoded, *encoded_tee;
+  GstElementFactory *factory;
+  gboolean ret = TRUE;
+  guint i;
+
+  encoder = _gst_transcoding_make_element_for_format (GST_ELEMENT_FACTORY_TYPE_ENCODER, priv->settings->format, error);
+  if (!encoder)
+    return FALSE;
+
+  /* Optional, most formats have a single stream format */
+  factory = _gst_transcoding_find_factory_for_format (GST_ELEMENT_FACTORY_TYPE_PARSER, priv->settings->format);
+  if (factory) {
+    parser = gst_element_factory_create (factory, NULL);
+    gst_object_unref (factory);
+  }
+
+  _gst_transcoding_configure_encoder (encoder, priv->settings, self->job->encoder_threads);
+
+  /* Only adapts to what the encoder takes, which is passthrough when the
+   * shared conversion already produces it */
+  if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+    convert = gst_parse_bin_from_description ("videoconvert", TRUE, error);
+  else
+    convert = gst_parse_bin_from_description ("audioconvert ! audioresample", TRUE, error);
+
+  if (!convert) {
+    if (parser)
+      gst_object_unref (parser);
+    gst_object_unref (encoder);
+    return FALSE;
+  }
+
+  queue = executor_make_queue (self);
+
+  gst_bin_add_many (GST_BIN (self->pipeline), queue, convert, encoder, NULL);
+
+  if (parser) {
+    gst_bin_add (GST_BIN (self->pipeline), parser);
+    ret = gst_element_link (encoder, parser);
+    encoded = parser;
+  } else {
+    encoded = encoder;
+  }
+
+  if (group->len == 1) {
+    ret = ret && executor_link_to_profile (self, encoded, profile);
+  } else {
+    encoded_tee = gst_element_factory_make ("tee", NULL);
+    gst_bin_add (GST_BIN (self->pipeline), encoded_tee);
+    ret = ret && gst_element_link (encoded, encoded_tee);
+
+    for (i = 0; i < group->len && ret; i++) {
+      GstElement *branch_queue = executor_make_queue (self);
+
+      gst_bin_add (GST_BIN (self->pipeline), branch_queue);
+      ret = executor_link_to_profile (self, branch_queue, g_ptr_array_index (group, i)) &&
+        gst_element_link (encoded_tee, branch_queue);
+    }
+  }
+
+  ret = ret && gst_element_link_many (tee, queue, convert, encoder, NULL);
+
+  if (!ret) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not link the %s encoder for %s", g_quark_to_string (priv->settings->format), priv->output->uri);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static const GstTranscodingStreamSettings *
+group_get_settings (GPtrArray *group)
+{
+  return _gst_transcoding_stream_profile_get_settings (g_ptr_array_index (group, 0));
+}
+
+static gboolean
+settings_is_converted (const GstTranscodingStreamSettings *settings)
+{
+  return settings->width || settings->height || settings->rate || settings->channels || settings->sample_format;
+}
+
+/* Only a size with both dimensions is known before the stream is, the
+ * other one otherwise follows the aspect ratio of the source */
+static gboolean
+settings_has_size (const GstTranscodingStreamSettings *settings)
+{
+  return settings->width && settings->height;
+}
+
+/* Unconverted first, then from the largest to the smallest area, so that
+ * each size can be scaled from the previous one, and last the sizes with a
+ * single dimension. Groups converting to the same raw format end up next to
+ * each other. */
+static gint
+group_compare_raw_format (GPtrArray **a, GPtrArray **b)
+{
+  const GstTranscodingStreamSettings *sa = group_get_settings (*a), *sb = group_get_settings (*b);
+  gboolean converted_a = settings_is_converted (sa), converted_b = settings_is_converted (sb);
+  gboolean sized_a = settings_has_size (sa), sized_b = settings_has_size (sb);
+  guint64 area_a = (guint64) sa->width * sa->height, area_b = (guint64) sb->width * sb->height;
+
+  if (converted_a != converted_b)
+    return converted_a - converted_b;
+
+  if (sized_a != sized_b)
+    return sized_b - sized_a;
+
+  if (area_a != area_b)
+    return area_a > area_b ? -1 : 1;
+
+  if (sa->height != sb->height)
+    return sa->height > sb->height ? -1 : 1;
+
+  if (sa->width != sb->width)
+    return sa->width > sb->width ? -1 : 1;
+
+  if (sa->rate != sb->rate)
+    return sa->rate > sb->rate ? -1 : 1;
+
+  if (sa->channels != sb->channels)
+    return sa->channels > sb->channels ? -1 : 1;
+
+  return g_strcmp0 (sa->sample_format, sb->sample_format);
+}
+
+static GstCaps *
+settings_get_raw_caps (const GstTranscodingStreamSettings *settings, MediaType media_type)
+{
+  GstStructure *structure;
+
+  if (media_type == VIDEO) {
+    structure = gst_structure_new_empty ("video/x-raw");
+    if (settings->width)
+      gst_structure_set (structure, "width", G_TYPE_INT, (gint) settings->width, NULL);
+    if (settings->height)
+      gst_structure_set (structure, "height", G_TYPE_INT, (gint) settings->height, NULL);
+  } else {
+    structure = gst_structure_new_empty ("audio/x-raw");
+    if (settings->rate)
+      gst_structure_set (structure, "rate", G_TYPE_INT, (gint) settings->rate, NULL);
+    if (settings->channels)
+      gst_structure_set (structure, "channels", G_TYPE_INT, (gint) settings->channels, NULL);
+    if (settings->sample_format)
+      gst_structure_set (structure, "format", G_TYPE_STRING, settings->sample_format, NULL);
+  }
+
+  return gst_caps_new_full (structure, NULL);
+}
+
+/* Converts what @tee outputs to the raw format of @settings, returning the
+ * tee the converted stream is available from */
+static GstElement *
+executor_convert_stream (Executor *self, GstElement *tee, const GstTranscodingStreamSettings *settings,
+                         MediaType media_type, GError **error)
+{
+  GstElement *queue, *convert, *capsfilter, *converted_tee;
+  GstCaps *caps;
+  gboolean ret;
+
+  if (media_type == VIDEO)
+    convert = gst_parse_bin_from_description ("videoscale", TRUE, error);
+  else
+    convert = gst_parse_bin_from_description ("audioconvert ! audioresample", TRUE, error);
+
+  if (!convert)
+    return NULL;
+
+  caps = settings_get_raw_caps (settings, media_type);
+  queue = executor_make_queue (self);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  g_object_set (capsfilter, "caps", caps, NULL);
+  converted_tee = gst_element_factory_make ("tee", NULL);
+
+  gst_bin_add_many (GST_BIN (self->pipeline), queue, convert, capsfilter, converted_tee, NULL);
+
+  ret = gst_element_link_many (tee, queue, convert, capsfilter, converted_tee, NULL);
+
+  if (!ret)
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not convert the decoded stream to %" GST_PTR_FORMAT, caps);
+
+  gst_caps_unref (caps);
+
+  return ret ? converted_tee : NULL;
+}
+
+static void
+decoded_pad_added_cb (GstElement *decodebin, GstPad *pad, StreamBranch *branch)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (branch->decoded_tee, "sink");
+
+  if (!gst_pad_is_linked (sinkpad))
+    gst_pad_link (pad, sinkpad);
+
+  gst_object_unref (sinkpad);
+}
+
+static gboolean
+executor_decode_stream (Executor *self, StreamBranch *branch, GPtrArray *profiles, GError **error)
+{
+  GstElement *decodebin = _gst_transcoding_make_element ("decodebin", error);
+  GstElement *queue, *tee;
+  MediaType media_type;
+  GPtrArray *groups;
+  gboolean ret = TRUE;
+  guint i;
+
+  if (!decodebin)
+    return FALSE;
+
+  g_signal_connect (decodebin, "pad-added", G_CALLBACK (decoded_pad_added_cb), branch);
+
+  queue = executor_make_queue (self);
+  branch->decoded_tee = gst_element_factory_make ("tee", NULL);
+  gst_bin_add_many (GST_BIN (self->pipeline), queue, decodebin, branch->decoded_tee, NULL);
+
+  if (!gst_element_link_many (branch->tee, queue, decodebin, NULL)) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not link parsed stream to a decoder");
+    return FALSE;
+  }
+
+  tee = branch->decoded_tee;
+  media_type = _gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (profiles, 0));
+  groups = group_equal_profiles (profiles);
+  g_ptr_array_sort (groups, (GCompareFunc) group_compare_raw_format);
+
+  /* Each raw format is converted once, for all the encoders needing it.
+   * Sizes are scaled from the next larger one rather than from the decoded
+   * stream, which is cheaper for the smaller ones. One missing a dimension
+   * may end up larger than any other, it is scaled from the decoded stream. */
+  for (i = 0; i < groups->len && ret; i++) {
+    GPtrArray *group = g_ptr_array_index (groups, i);
+    const GstTranscodingStreamSettings *settings = group_get_settings (group);
+
+    if (settings_is_converted (settings) &&
+        (i == 0 || group_compare_raw_format (&g_ptr_array_index (groups, i - 1), &group)))
+      tee = executor_convert_stream (self,
+          media_type == VIDEO && settings_has_size (settings) ? tee : branch->decoded_tee, settings, media_type, error);
+
+    ret = tee && executor_encode_stream (self, tee, group, error);
+  }
+
+  g_ptr_array_unref (groups);
+
+  return ret;
+}
+
+/* Parsed data goes to the muxer, or the sink, untouched */
+static gboolean
+executor_passthrough_stream (Executor *self, StreamBranch *branch, GstTranscodingStreamProfile *profile, GError **error)
+{
+  GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+  GstElement *queue = executor_make_queue (self);
+
+  gst_bin_add (GST_BIN (self->pipeline), queue);
+
+  if (input_has_range (priv->input)) {
+    GstPad *sinkpad = gst_element_get_static_pad (queue, "sink");
+
+    gst_pad_add_probe (sinkpad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) clip_to_range_probe, branch->input, NULL);
+    gst_object_unref (sinkpad);
+  }
+
+  if (!executor_link_to_profile (self, queue, profile) || !gst_element_link (branch->tee, queue)) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not pass the stream through to %s", priv->output->uri);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Builds all the branches of a stream, parsebin's pad only has to be linked
+ * to it once exposed */
+static gboolean
+executor_add_stream (Executor *self, InputContext *ctx, const gchar *stream_id, GPtrArray *profiles, GError **error)
+{
+  StreamBranch *branch = g_new0 (StreamBranch, 1);
+  GPtrArray *encoded = g_ptr_array_new ();
+  gboolean ret = TRUE;
+  guint i;
+
+  branch->input = ctx;
+  branch->tee = gst_element_factory_make ("tee", NULL);
+  gst_bin_add (GST_BIN (self->pipeline), branch->tee);
+  g_ptr_array_add (ctx->branches, branch);
+  g_hash_table_insert (ctx->streams, (gpointer) stream_id, branch);
+
+  for (i = 0; i < profiles->len && ret; i++) {
+    GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+
+    if (gst_transcoding_stream_profile_get_format (profile) == GST_TRANSCODING_FORMAT_NONE)
+      ret = executor_passthrough_stream (self, branch, profile, error);
+    else
+      g_ptr_array_add (encoded, profile);
+  }
+
+  if (ret && encoded->len)
+    ret = executor_decode_stream (self, branch, encoded, error);
+
+  g_ptr_array_unref (encoded);
+
+  return ret;
+}
+
+static void
+executor_drop_pad (InputContext *ctx, GstPad *pad)
+{
+  Executor *self = ctx->executor;
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *sinkpad;
+
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (self->pipeline), fakesink);
+  gst_element_sync_state_with_parent (fakesink);
+
+  g_mutex_lock (&self->lock);
+  g_ptr_array_add (ctx->dropped, fakesink);
+  g_mutex_unlock (&self->lock);
+
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+}
+
+static gboolean
+element_is_demuxer (GstElement *element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *klass = factory ? gst_element_factory_get_metadata (factory, GST_ELEMENT_METADATA_KLASS) : NULL;
+
+  return klass && strstr (klass, "Demux");
+}
+
+/* Stops parsebin from plugging anything after the demuxer pads of streams
+ * nothing is mapped to, which then only carry events */
+static gboolean
+parsed_autoplug_continue_cb (GstElement *parsebin, GstPad *pad, GstCaps *caps, InputContext *ctx)
+{
+  GstPad *target = GST_IS_GHOST_PAD (pad) ? gst_ghost_pad_get_target (GST_GHOST_PAD (pad)) : gst_object_ref (pad);
+  GstElement *parent;
+  gchar *stream_id;
+  gboolean ret = TRUE;
+
+  if (!target)
+    return TRUE;
+
+  parent = gst_pad_get_parent_element (target);
+
+  if (parent && element_is_demuxer (parent) && (stream_id = gst_pad_get_stream_id (target))) {
+    ret = g_hash_table_contains (ctx->streams, stream_id);
+
+    if (!ret)
+      gst_pad_add_probe (target, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+          drop_data_probe, NULL, NULL);
+
+    g_free (stream_id);
+  }
+
+  if (parent)
+    gst_object_unref (parent);
+  gst_object_unref (target);
+
+  return ret;
+}
+
+static void
+parsed_pad_added_cb (GstElement *parsebin, GstPad *pad, InputContext *ctx)
+{
+  Executor *self = ctx->executor;
+  gchar *stream_id = gst_pad_get_stream_id (pad);
+  StreamBranch *branch = NULL;
+
+  if (stream_id) {
+    branch = g_hash_table_lookup (ctx->streams, stream_id);
+
+    g_mutex_lock (&self->lock);
+    g_hash_table_add (ctx->seen, g_strdup (stream_id));
+    g_mutex_unlock (&self->lock);
+  }
+
+  if (input_has_range (ctx->input)) {
+    BlockedPad *blocked = g_new0 (BlockedPad, 1);
+
+    blocked->pad = gst_object_ref (pad);
+    blocked->probe_id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+        (GstPadProbeCallback) block_probe, NULL, NULL);
+
+    g_mutex_lock (&self->lock);
+    g_ptr_array_add (ctx->blocked, blocked);
+    g_mutex_unlock (&self->lock);
+  }
+
+  if (branch) {
+    GstPad *sinkpad = gst_element_get_static_pad (branch->tee, "sink");
+
+    if (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)
+      executor_post_error (self, g_error_new (GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Could not link stream %s of %s", stream_id, ctx->input->uri));
+
+    gst_object_unref (sinkpad);
+  } else {
+    executor_drop_pad (ctx, pad);
+  }
+
+  g_free (stream_id);
+}
+
+/* Runs outside of the streaming threads, which are blocked until we're done */
+static void
+input_seek (GstElement *parsebin, InputContext *ctx)
+{
+  Executor *self = ctx->executor;
+  GstTranscodingInput *input = ctx->input;
+  GPtrArray *blocked;
+  GstEvent *seek;
+  guint i;
+
+  g_mutex_lock (&self->lock);
+  blocked = g_ptr_array_ref (ctx->blocked);
+  g_mutex_unlock (&self->lock);
+
+  seek = gst_event_new_seek (1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+      GST_SEEK_TYPE_SET, GST_CLOCK_TIME_IS_VALID (input->start) ? input->start : 0,
+      GST_CLOCK_TIME_IS_VALID (input->stop) ? GST_SEEK_TYPE_SET : GST_SEEK_TYPE_NONE, input->stop);
+
+  if (blocked->len &&
+      !gst_pad_send_event (((BlockedPad *) g_ptr_array_index (blocked, 0))->pad, seek)) {
+    executor_post_error (self, g_error_new (GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "Could not seek in %s", input->uri));
+  } else if (!blocked->len) {
+    gst_event_unref (seek);
+  }
+
+  for (i = 0; i < blocked->len; i++) {
+    BlockedPad *pad = g_ptr_array_index (blocked, i);
+
+    gst_pad_remove_probe (pad->pad, pad->probe_id);
+  }
+
+  g_ptr_array_unref (blocked);
+}
+
+static void
+parsed_no_more_pads_cb (GstElement *parsebin, InputContext *ctx)
+{
+  Executor *self = ctx->executor;
+  GHashTableIter iter;
+  const gchar *stream_id;
+
+  g_mutex_lock (&self->lock);
+  g_hash_table_iter_init (&iter, ctx->input->profiles);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &stream_id, NULL)) {
+    if (!g_hash_table_contains (ctx->seen, stream_id)) {
+      g_mutex_unlock (&self->lock);
+      executor_post_error (self, g_error_new (GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "No stream %s in %s", stream_id, ctx->input->uri));
+      return;
+    }
+  }
+  g_mutex_unlock (&self->lock);
+
+  if (input_has_range (ctx->input))
+    gst_element_call_async (parsebin, (GstElementCallAsyncFunc) input_seek, ctx, NULL);
+}
+
+static void
+source_pad_added_cb (GstElement *src, GstPad *pad, GstElement *parsebin)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (parsebin, "sink");
+
+  if (!gst_pad_is_linked (sinkpad))
+    gst_pad_link (pad, sinkpad);
+
+  gst_object_unref (sinkpad);
+}
+
+GstElement *
+_gst_transcoding_make_parsed_source (GstBin *bin, const gchar *uri, GstElement **source, GError **error)
+{
+  GstElement *src, *parsebin;
+
+  if (!(src = _gst_transcoding_make_element ("urisourcebin", error)))
+    return NULL;
+
+  if (!(parsebin = _gst_transcoding_make_element ("parsebin", error))) {
+    gst_object_unref (src);
+    return NULL;
+  }
+
+  g_object_set (src, "uri", uri, NULL);
+  gst_bin_add_many (bin, src, parsebin, NULL);
+  g_signal_connect (src, "pad-added", G_CALLBACK (source_pad_added_cb), parsebin);
+
+  if (source)
+    *source = src;
+
+  return parsebin;
+}
+
+static gboolean
+executor_add_input (Executor *self, GstTranscodingInput *input, GError **error)
+{
+  InputContext *ctx = g_new0 (InputContext, 1);
+  GstElement *parsebin;
+  GList *stream_ids, *tmp;
+  gboolean ret = TRUE;
+
+  ctx->executor = self;
+  ctx->input = input;
+  ctx->branches = g_ptr_array_new_with_free_func (g_free);
+  ctx->streams = g_hash_table_new (g_str_hash, g_str_equal);
+  ctx->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  ctx->blocked = g_ptr_array_new_with_free_func ((GDestroyNotify) blocked_pad_free);
+  ctx->dropped = g_ptr_array_new ();
+  g_ptr_array_add (self->inputs, ctx);
+
+  parsebin = _gst_transcoding_make_parsed_source (GST_BIN (self->pipeline), input->uri, &ctx->src, error);
+  if (!parsebin)
+    return FALSE;
+
+  g_signal_connect (parsebin, "no-more-pads", G_CALLBACK (parsed_no_more_pads_cb), ctx);
+  g_signal_connect (parsebin, "pad-added", G_CALLBACK (parsed_pad_added_cb), ctx);
+  g_signal_connect (parsebin, "autoplug-continue", G_CALLBACK (parsed_autoplug_continue_cb), ctx);
+
+  stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles);
+
+  /* Muxer pads first, all of them, then the branches feeding them */
+  for (tmp = stream_ids; tmp && ret; tmp = tmp->next) {
+    GPtrArray *profiles = g_hash_table_lookup (input->profiles, tmp->data);
+    guint i;
+
+    for (i = 0; i < profiles->len && ret; i++)
+      ret = executor_add_profile (self, g_ptr_array_index (profiles, i), error);
+  }
+
+  for (tmp = stream_ids; tmp && ret; tmp = tmp->next)
+    ret = executor_add_stream (self, ctx, tmp->data, g_hash_table_lookup (input->profiles, tmp->data), error);
+
+  g_list_free (stream_ids);
+
+  return ret;
+}
+
+static gboolean
+executor_prepare (Executor *self, GError **error)
+{
+  GList *uris, *tmp;
+  gboolean ret = TRUE;
+  guint i;
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (self->job->outputs);
+
+  for (tmp = uris; tmp && ret; tmp = tmp->next)
+    ret = executor_add_output (self, g_hash_table_lookup (self->job->outputs, tmp->data), error);
+
+  g_list_free (uris);
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (self->job->inputs);
+
+  for (tmp = uris; tmp && ret; tmp = tmp->next)
+    ret = executor_add_input (self, g_hash_table_lookup (self->job->inputs, tmp->data), error);
+
+  g_list_free (uris);
+
+  /* Outputs nothing was mapped to would never finish */
+  for (i = 0; i < self->outputs->len; i++) {
+    OutputBranch *branch = g_ptr_array_index (self->outputs, i);
+
+    if (branch->n_streams)
+      continue;
+
+    if (branch->muxer)
+      gst_bin_remove (GST_BIN (self->pipeline), branch->muxer);
+    if (branch->sink)
+      gst_bin_remove (GST_BIN (self->pipeline), branch->sink);
+    branch->muxer = branch->sink = NULL;
+  }
+
+  g_hash_table_remove_all (self->profile_pads);
+
+  return ret;
+}
+
+static void
+executor_propagate_message_error (GstMessage *msg, GError **error)
+{
+  GError *err = NULL;
+  gchar *debug = NULL;
+
+  gst_message_parse_error (msg, &err, &debug);
+
+  if (err->domain == GST_TRANSCODING_ERROR) {
+    g_propagate_error (error, err);
+  } else {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "%s (%s)", err->message, debug ? debug : "no details");
+    g_error_free (err);
+  }
+
+  g_free (debug);
+}
+
+gboolean
+_gst_transcoding_pipeline_run (GstElement *pipeline, GstState final_state, GCancellable *cancellable, GError **error)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstClockTime timeout = 100 * GST_MSECOND;
+  gboolean ret = FALSE;
+  gboolean done = FALSE;
+
+  /* On failure an error should be waiting for us on the bus */
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE)
+    timeout = 0;
+
+  while (!done) {
+    GstMessage *msg;
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+      break;
+
+    msg = gst_bus_timed_pop_filtered (bus, timeout, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+
+    if (!msg) {
+      if (timeout == 0) {
+        g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+            "Could not start the pipeline");
+        break;
+      }
+      continue;
+    }
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS)
+      ret = TRUE;
+    else
+      executor_propagate_message_error (msg, error);
+
+    done = TRUE;
+    gst_message_unref (msg);
+  }
+
+  gst_element_set_state (pipeline, final_state);
+  gst_object_unref (bus);
+
+  return ret;
+}
+
+static Executor *
+executor_new (GstTranscodingJob *job, gchar *topology)
+{
+  Executor *self = g_new0 (Executor, 1);
+
+  self->job = g_object_ref (job);
+  self->pipeline = gst_pipeline_new (NULL);
+  self->topology = topology;
+  self->outputs = g_ptr_array_new_with_free_func (g_free);
+  self->inputs = g_ptr_array_new_with_free_func ((GDestroyNotify) input_context_free);
+  self->profile_pads = g_hash_table_new_full (NULL, NULL, NULL, gst_object_unref);
+  g_mutex_init (&self->lock);
+
+  return self;
+}
+
+static void
+executor_free (Executor *self)
+{
+  gst_element_set_state (self->pipeline, GST_STATE_NULL);
+  g_hash_table_unref (self->profile_pads);
+  gst_object_unref (self->pipeline);
+  g_ptr_array_unref (self->inputs);
+  g_ptr_array_unref (self->outputs);
+  g_mutex_clear (&self->lock);
+  g_clear_object (&self->job);
+  g_free (self->topology);
+  g_free (self);
+}
+
+static void
+topology_append_uri (GString *topology, const gchar *uri)
+{
+  gchar *protocol = gst_uri_get_protocol (uri);
+
+  g_string_append_printf (topology, "%s;", protocol ? protocol : "");
+  g_free (protocol);
+}
+
+/* Jobs of the same topology build the same pipeline, but for the URIs and
+ * ranges of their inputs and outputs */
+static gchar *
+executor_get_topology (GstTranscodingJob *job)
+{
+  GString *topology = g_string_new (NULL);
+  GList *outputs, *inputs, *tmp;
+
+  g_string_append_printf (topology, "%u;%u;", job->encoder_threads, job->queue_max_bytes);
+
+  outputs = _gst_transcoding_hash_table_get_sorted_keys (job->outputs);
+
+  for (tmp = outputs; tmp; tmp = tmp->next) {
+    GstTranscodingOutput *output = g_hash_table_lookup (job->outputs, tmp->data);
+
+    topology_append_uri (topology, output->uri);
+    g_string_append_printf (topology, "%s;", g_quark_to_string (output->profile->format));
+  }
+
+  inputs = _gst_transcoding_hash_table_get_sorted_keys (job->inputs);
+
+  for (tmp = inputs; tmp; tmp = tmp->next) {
+    GstTranscodingInput *input = g_hash_table_lookup (job->inputs, tmp->data);
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *stmp;
+
+    g_string_append (topology, "|");
+    topology_append_uri (topology, input->uri);
+    g_string_append_printf (topology, "%d;", input_has_range (input));
+
+    for (stmp = stream_ids; stmp; stmp = stmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, stmp->data);
+      guint i;
+
+      g_string_append (topology, "/");
+
+      for (i = 0; i < profiles->len; i++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+        GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+        GVariant *settings = g_variant_ref_sink (_gst_transcoding_stream_profile_settings_to_variant (profile));
+        gchar *str = g_variant_print (settings, FALSE);
+
+        g_string_append_printf (topology, "%d,%d,%s;",
+            g_list_index (outputs, priv->output->uri),
+            _gst_transcoding_stream_profile_get_media_type (profile), str);
+
+        g_free (str);
+        g_variant_unref (settings);
+      }
+    }
+
+    g_list_free (stream_ids);
+  }
+
+  g_list_free (inputs);
+  g_list_free (outputs);
+
+  return g_string_free (topology, FALSE);
+}
+
+/* Points an idle executor of the same topology at @job */
+static gboolean
+executor_rebind (Executor *self, GstTranscodingJob *job)
+{
+  GList *uris, *tmp;
+  gboolean ret = TRUE;
+  guint i;
+
+  self->job = g_object_ref (job);
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs);
+
+  for (tmp = uris, i = 0; tmp && ret; tmp = tmp->next, i++) {
+    OutputBranch *branch = g_ptr_array_index (self->outputs, i);
+
+    branch->output = g_hash_table_lookup (job->outputs, tmp->data);
+
+    if (branch->sink)
+      ret = gst_uri_handler_set_uri (GST_URI_HANDLER (branch->sink), branch->output->uri, NULL);
+  }
+
+  g_list_free (uris);
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->inputs);
+
+  for (tmp = uris, i = 0; tmp && ret; tmp = tmp->next, i++) {
+    InputContext *ctx = g_ptr_array_index (self->inputs, i);
+    GList *stream_ids, *stmp;
+    guint j;
+
+    ctx->input = g_hash_table_lookup (job->inputs, tmp->data);
+    g_object_set (ctx->src, "uri", ctx->input->uri, NULL);
+
+    stream_ids = _gst_transcoding_hash_table_get_sorted_keys (ctx->input->profiles);
+
+    for (stmp = stream_ids, j = 0; stmp; stmp = stmp->next, j++)
+      g_hash_table_insert (ctx->streams, stmp->data, g_ptr_array_index (ctx->branches, j));
+
+    g_list_free (stream_ids);
+  }
+
+  g_list_free (uris);
+
+  return ret;
+}
+
+static void
+unlink_sink_pad (GstElement *element)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (element, "sink");
+  GstPad *peer = gst_pad_get_peer (sinkpad);
+
+  if (peer) {
+    gst_pad_unlink (peer, sinkpad);
+    gst_object_unref (peer);
+  }
+
+  gst_object_unref (sinkpad);
+}
+
+/* Undoes what running a job added to the pipeline, which must be in READY,
+ * leaving it as executor_prepare() did */
+static void
+executor_reset (Executor *self)
+{
+  guint i, j;
+
+  for (i = 0; i < self->inputs->len; i++) {
+    InputContext *ctx = g_ptr_array_index (self->inputs, i);
+
+    for (j = 0; j < ctx->dropped->len; j++) {
+      GstElement *fakesink = g_ptr_array_index (ctx->dropped, j);
+
+      gst_element_set_state (fakesink, GST_STATE_NULL);
+      gst_bin_remove (GST_BIN (self->pipeline), fakesink);
+    }
+
+    for (j = 0; j < ctx->branches->len; j++) {
+      StreamBranch *branch = g_ptr_array_index (ctx->branches, j);
+
+      unlink_sink_pad (branch->tee);
+      if (branch->decoded_tee)
+        unlink_sink_pad (branch->decoded_tee);
+    }
+
+    g_ptr_array_set_size (ctx->dropped, 0);
+    g_ptr_array_set_size (ctx->blocked, 0);
+    g_hash_table_remove_all (ctx->seen);
+    g_hash_table_remove_all (ctx->streams);
+    ctx->input = NULL;
+  }
+
+  for (i = 0; i < self->outputs->len; i++)
+    ((OutputBranch *) g_ptr_array_index (self->outputs, i))->output = NULL;
+
+  g_clear_object (&self->job);
+}
+
+static Executor *
+executor_pool_pop (const gchar *topology)
+{
+  Executor *ret = NULL;
+  GQueue *queue;
+
+  g_mutex_lock (&pool_lock);
+
+  if (pool && (queue = g_hash_table_lookup (pool, topology))) {
+    ret = g_queue_pop_head (queue);
+    pool_size--;
+
+    if (g_queue_is_empty (queue))
+      g_hash_table_remove (pool, topology);
+  }
+
+  g_mutex_unlock (&pool_lock);
+
+  return ret;
+}
+
+/* Keeps @self for a later job if there is room, frees it otherwise */
+static void
+executor_pool_push (Executor *self)
+{
+  GQueue *queue;
+
+  g_mutex_lock (&pool_lock);
+
+  if (pool_size < pool_max_size) {
+    if (!pool)
+      pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_queue_free);
+
+    if (!(queue = g_hash_table_lookup (pool, self->topology))) {
+      queue = g_queue_new ();
+      g_hash_table_insert (pool, g_strdup (self->topology), queue);
+    }
+
+    g_queue_push_tail (queue, self);
+    pool_size++;
+    self = NULL;
+  }
+
+  g_mutex_unlock (&pool_lock);
+
+  if (self)
+    executor_free (self);
+}
+
+void
+gst_transcoding_set_max_idle_pipelines (guint n_pipelines)
+{
+  GList *evicted = NULL;
+  GHashTableIter iter;
+  GQueue *queue;
+
+  g_mutex_lock (&pool_lock);
+
+  pool_max_size = n_pipelines;
+
+  if (pool) {
+    g_hash_table_iter_init (&iter, pool);
+    while (pool_size > pool_max_size && g_hash_table_iter_next (&iter, NULL, (gpointer *) &queue)) {
+      while (pool_size > pool_max_size && !g_queue_is_empty (queue)) {
+        evicted = g_list_prepend (evicted, g_queue_pop_head (queue));
+        pool_size--;
+      }
+
+      if (g_queue_is_empty (queue))
+        g_hash_table_iter_remove (&iter);
+    }
+  }
+
+  g_mutex_unlock (&pool_lock);
+
+  /* Outside of the lock, tearing pipelines down takes a while */
+  g_list_free_full (evicted, (GDestroyNotify) executor_free);
+}
+
+static guint
+count_conversions (GPtrArray *groups)
+{
+  guint i, ret = 0;
+
+  g_ptr_array_sort (groups, (GCompareFunc) group_compare_raw_format);
+
+  for (i = 0; i < groups->len; i++) {
+    const GstTranscodingStreamSettings *settings = group_get_settings (g_ptr_array_index (groups, i));
+
+    if (settings->format != GST_TRANSCODING_FORMAT_NONE && settings_is_converted (settings) &&
+        (i == 0 || group_compare_raw_format (&g_ptr_array_index (groups, i - 1), &g_ptr_array_index (groups, i))))
+      ret++;
+  }
+
+  return ret;
+}
+
+void
+_gst_transcoding_job_estimate_cost (GstTranscodingJob *job, guint *n_encoders, guint *n_queues)
+{
+  GHashTableIter iter, stream_iter;
+  GstTranscodingInput *input;
+  GPtrArray *profiles;
+  guint n_chunks = 1;
+
+  *n_encoders = 0;
+  *n_queues = 0;
+
+  g_hash_table_iter_init (&iter, job->inputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &input)) {
+    g_hash_table_iter_init (&stream_iter, input->profiles);
+    while (g_hash_table_iter_next (&stream_iter, NULL, (gpointer *) &profiles)) {
+      GPtrArray *groups = group_equal_profiles (profiles);
+      guint i;
+
+      for (i = 0; i < groups->len; i++) {
+        GPtrArray *group = g_ptr_array_index (groups, i);
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (group, 0);
+
+        if (gst_transcoding_stream_profile_get_format (profile) == GST_TRANSCODING_FORMAT_NONE) {
+          *n_queues += group->len;
+        } else {
+          *n_encoders += 1;
+          *n_queues += 1 + (group->len > 1 ? group->len : 0);
+        }
+      }
+
+      /* Queue in front of the decoder, and one per raw format converted to */
+      *n_queues += 1 + count_conversions (groups);
+      g_ptr_array_unref (groups);
+    }
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (job->segment_duration) && g_hash_table_size (job->inputs) == 1)
+    n_chunks = job->max_workers ? job->max_workers : g_get_num_processors ();
+
+  *n_encoders *= n_chunks;
+  *n_queues *= n_chunks;
+}
+
+gboolean
+_gst_transcoding_executor_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error)
+{
+  gchar *topology = executor_get_topology (job);
+  Executor *executor = executor_pool_pop (topology);
+  gboolean ret = TRUE;
+
+  if (executor && !executor_rebind (executor, job))
+    g_clear_pointer (&executor, executor_free);
+
+  if (executor) {
+    g_free (topology);
+  } else {
+    executor = executor_new (job, topology);
+    ret = executor_prepare (executor, error);
+  }
+
+  ret = ret && _gst_transcoding_pipeline_run (executor->pipeline, GST_STATE_READY, cancellable, error);
+
+  /* Pipelines that failed may be in any state, they're never reused */
+  if (ret) {
+    executor_reset (executor);
+    executor_pool_push (executor);
+  } else {
+    executor_free (executor);
+  }
+
+  return ret;
+}
+
+static gboolean
+job_has_sequences (GstTranscodingJob *job)
+{
+  GHashTableIter iter;
+  GstTranscodingOutput *output;
+
+  g_hash_table_iter_init (&iter, job->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &output)) {
+    if (output->sequence)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+gboolean
+gst_transcoding_job_run (GstTranscodingJob *self, GCancellable *cancellable, GError **error)
+{
+  if (self->output_cache)
+    return _gst_transcoding_output_cache_run_job (self, cancellable, error);
+
+  if (job_has_sequences (self))
+    return _gst_transcoding_concat_run_job (self, cancellable, error);
+
+  if ((GST_CLOCK_TIME_IS_VALID (self->segment_duration) || self->smart_render) && g_hash_table_size (self->inputs) == 1)
+    return _gst_transcoding_segment_run_job (self, cancellable, error);
+
+  return _gst_transcoding_executor_run_job (self, cancellable, error);
+}
+
+static void
+job_run_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+  GError *error = NULL;
+
+  if (gst_transcoding_job_run (source_object, cancellable, &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+void
+gst_transcoding_job_run_async (GstTranscodingJob *self,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+  GTask *task = g_task_new (self, cancellable, callback, user_data);
+
+  g_task_set_source_tag (task, gst_transcoding_job_run_async);
+  g_task_run_in_thread (task, job_run_thread);
+  g_object_unref (task);
+}
+
+gboolean
+gst_transcoding_job_run_finish (GstTranscodingJob *self, GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
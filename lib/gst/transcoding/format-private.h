@@ -0,0 +1,36 @@
+#pragma once
+
+#include <gst/gst.h>
+#include "job-private.h"
+
+G_BEGIN_DECLS
+
+/* Registry of the known formats: the caps they stand for, the extensions
+ * of the containers, and the elements producing them. Formats it doesn't
+ * know are taken as caps strings. Also knows how to configure the encoders
+ * it may pick. */
+
+/* Container format of files named like @uri, GST_TRANSCODING_FORMAT_NONE if
+ * the extension isn't known */
+G_GNUC_INTERNAL
+GstTranscodingFormat _gst_transcoding_format_from_extension (const gchar *uri);
+
+/* Picks the highest ranked factory of @type producing @format, resolved
+ * once per process. NULL if there is none. */
+G_GNUC_INTERNAL
+GstElementFactory * _gst_transcoding_find_factory_for_format (GstElementFactoryListType type,
+                                                              GstTranscodingFormat format);
+
+/* Whether streams of @caps are already in @format */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_format_matches_caps (GstTranscodingFormat format, const GstCaps *caps);
+
+/* Maps @settings onto the properties of @encoder, as far as it has
+ * equivalents. @default_threads is used when the settings don't specify a
+ * thread count, 0 leaves the encoder default. */
+G_GNUC_INTERNAL
+void _gst_transcoding_configure_encoder (GstElement *encoder,
+                                         const GstTranscodingStreamSettings *settings,
+                                         guint default_threads);
+
+G_END_DECLS
@@ -0,0 +1,299 @@
+#include <string.h>
+#include "format-private.h"
+
+/* Formats are identified by their quark, which is also what jobs are
+ * serialized with. The caps they stand for may be more precise, or differ
+ * altogether when the name predates the registry (AAC). */
+
+typedef struct
+{
+  const gchar *name;
+  const gchar *caps;
+  /* Lowercase, for containers only */
+  const gchar *extensions[4];
+} FormatInfo;
+
+static const FormatInfo formats[] = {
+  /* Containers */
+  { "video/x-matroska", "video/x-matroska", { "mkv", "mka", "mk3d", NULL } },
+  { "video/webm", "video/webm", { "webm", NULL } },
+  { "video/quicktime", "video/quicktime, variant=(string)iso", { "mp4", "m4v", "m4a", NULL } },
+  { "video/mpegts", "video/mpegts, systemstream=(boolean)true", { "ts", "m2ts", "mts", NULL } },
+  /* Video */
+  { "video/x-h264", "video/x-h264", { NULL } },
+  { "video/x-h265", "video/x-h265", { NULL } },
+  { "video/x-vp8", "video/x-vp8", { NULL } },
+  { "video/x-vp9", "video/x-vp9", { NULL } },
+  { "video/x-av1", "video/x-av1", { NULL } },
+  /* Audio */
+  { "audio/x-aac", "audio/mpeg, mpegversion=(int)4", { NULL } },
+  { "audio/mpeg", "audio/mpeg, mpegversion=(int)1, layer=(int)3", { NULL } },
+  { "audio/x-opus", "audio/x-opus", { NULL } },
+  { "audio/x-vorbis", "audio/x-vorbis", { NULL } },
+};
+
+/* How the settings of stream profiles map onto the properties of the
+ * encoders we know about. Values are given as gst_util_set_object_arg()
+ * takes them, NULL when the encoder has no equivalent. */
+typedef struct
+{
+  const gchar *factory;
+  const gchar *bitrate;
+  /* Units of the bitrate property, in bits per second */
+  guint bitrate_unit;
+  /* Property and value switching the encoder to bitrate targeting, when
+   * it isn't by default */
+  const gchar *bitrate_mode[2];
+  const gchar *rate_control;
+  /* Values for CBR, VBR, and VBR with a bitrate, which must still be
+   * targeted */
+  const gchar *rate_controls[3];
+  const gchar *speed_preset;
+  /* Values from fastest to slowest */
+  const gchar *speed_presets[5];
+  const gchar *tune;
+} EncoderInfo;
+
+static const EncoderInfo encoders[] = {
+  /* Constant quality ignores the bitrate, and average bitrate is only had
+   * from a first pass writing its stats to a file */
+  { "x264enc", "bitrate", 1000, { NULL }, "pass", { "cbr", "qual", "cbr" },
+    "speed-preset", { "ultrafast", "veryfast", "medium", "slow", "veryslow" }, "tune" },
+  { "x265enc", "bitrate", 1000, { NULL }, NULL, { NULL },
+    "speed-preset", { "ultrafast", "veryfast", "medium", "slow", "veryslow" }, "tune" },
+  { "openh264enc", "bitrate", 1, { "rate-control", "bitrate" }, NULL, { NULL },
+    "complexity", { "low", "low", "medium", "high", "high" }, NULL },
+  { "vp8enc", "target-bitrate", 1, { NULL }, "end-usage", { "cbr", "vbr", "vbr" },
+    "cpu-used", { "8", "5", "3", "1", "0" }, "tuning" },
+  { "vp9enc", "target-bitrate", 1, { NULL }, "end-usage", { "cbr", "vbr", "vbr" },
+    "cpu-used", { "8", "5", "3", "1", "0" }, "tuning" },
+  { "av1enc", "target-bitrate", 1000, { NULL }, "end-usage", { "cbr", "vbr", "vbr" },
+    "cpu-used", { "8", "6", "4", "2", "0" }, NULL },
+  { "svtav1enc", "target-bitrate", 1000, { NULL }, NULL, { NULL },
+    "preset", { "12", "10", "8", "4", "2" }, NULL },
+  { "avenc_aac", "bitrate", 1, { NULL }, NULL, { NULL }, NULL, { NULL }, NULL },
+  { "fdkaacenc", "bitrate", 1, { NULL }, NULL, { NULL }, NULL, { NULL }, NULL },
+  { "voaacenc", "bitrate", 1, { NULL }, NULL, { NULL }, NULL, { NULL }, NULL },
+  { "lamemp3enc", "bitrate", 1000, { "target", "bitrate" }, "cbr", { "true", "false", "false" },
+    "encoding-engine-quality", { "fast", "fast", "standard", "high", "high" }, NULL },
+  { "opusenc", "bitrate", 1, { NULL }, "bitrate-type", { "cbr", "vbr", "vbr" },
+    "complexity", { "0", "3", "6", "9", "10" }, NULL },
+  { "vorbisenc", "bitrate", 1, { NULL }, "managed", { "true", "false", "false" }, NULL, { NULL }, NULL },
+};
+
+typedef struct
+{
+  GstElementFactoryListType type;
+  GstTranscodingFormat format;
+} FactoryKey;
+
+/* FactoryKey -> GstElementFactory, NULL when there is none. Never freed. */
+static GMutex factories_lock;
+static GHashTable *factories;
+
+static const FormatInfo *
+format_lookup (GstTranscodingFormat format)
+{
+  const gchar *name = g_quark_to_string (format);
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    if (!strcmp (formats[i].name, name))
+      return &formats[i];
+  }
+
+  return NULL;
+}
+
+static GstCaps *
+format_get_caps (GstTranscodingFormat format)
+{
+  const FormatInfo *info = format_lookup (format);
+
+  return gst_caps_from_string (info ? info->caps : g_quark_to_string (format));
+}
+
+GstTranscodingFormat
+_gst_transcoding_format_from_extension (const gchar *uri)
+{
+  const gchar *dot = strrchr (uri, '.');
+  guint i, j;
+
+  if (!dot || strchr (dot, '/'))
+    return GST_TRANSCODING_FORMAT_NONE;
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    for (j = 0; formats[i].extensions[j]; j++) {
+      if (!g_ascii_strcasecmp (dot + 1, formats[i].extensions[j]))
+        return g_quark_from_static_string (formats[i].name);
+    }
+  }
+
+  return GST_TRANSCODING_FORMAT_NONE;
+}
+
+gboolean
+_gst_transcoding_format_matches_caps (GstTranscodingFormat format, const GstCaps *caps)
+{
+  GstCaps *format_caps = format_get_caps (format);
+  gboolean ret;
+
+  if (!format_caps)
+    return FALSE;
+
+  ret = gst_caps_can_intersect (format_caps, caps);
+  gst_caps_unref (format_caps);
+
+  return ret;
+}
+
+static guint
+factory_key_hash (const FactoryKey *key)
+{
+  return g_int64_hash (&key->type) ^ g_direct_hash (GUINT_TO_POINTER (key->format));
+}
+
+static gboolean
+factory_key_equal (const FactoryKey *a, const FactoryKey *b)
+{
+  return a->type == b->type && a->format == b->format;
+}
+
+static GstElementFactory *
+resolve_factory (GstElementFactoryListType type, GstTranscodingFormat format)
+{
+  GstCaps *caps = format_get_caps (format);
+  GstElementFactory *ret = NULL;
+  GList *all, *filtered;
+
+  if (!caps)
+    return NULL;
+
+  all = gst_element_factory_list_get_elements (type, GST_RANK_MARGINAL);
+  filtered = gst_element_factory_list_filter (all, caps, GST_PAD_SRC, FALSE);
+
+  /* Parsers must also take the format, not just produce it */
+  if (type & GST_ELEMENT_FACTORY_TYPE_PARSER) {
+    GList *parsers = gst_element_factory_list_filter (filtered, caps, GST_PAD_SINK, FALSE);
+
+    gst_plugin_feature_list_free (filtered);
+    filtered = parsers;
+  }
+
+  filtered = g_list_sort (filtered, gst_plugin_feature_rank_compare_func);
+
+  if (filtered)
+    ret = gst_object_ref (filtered->data);
+
+  gst_plugin_feature_list_free (filtered);
+  gst_plugin_feature_list_free (all);
+  gst_caps_unref (caps);
+
+  return ret;
+}
+
+/* Scanning the registry is slow, and the plugins don't change while we
+ * run: what was found, or not, is kept for good */
+GstElementFactory *
+_gst_transcoding_find_factory_for_format (GstElementFactoryListType type, GstTranscodingFormat format)
+{
+  FactoryKey key = { type, format };
+  GstElementFactory *ret;
+
+  g_mutex_lock (&factories_lock);
+
+  if (!factories)
+    factories = g_hash_table_new ((GHashFunc) factory_key_hash, (GEqualFunc) factory_key_equal);
+
+  if (!g_hash_table_lookup_extended (factories, &key, NULL, (gpointer *) &ret)) {
+    FactoryKey *copy = g_new (FactoryKey, 1);
+
+    *copy = key;
+    ret = resolve_factory (type, format);
+    g_hash_table_insert (factories, copy, ret);
+  }
+
+  if (ret)
+    gst_object_ref (ret);
+
+  g_mutex_unlock (&factories_lock);
+
+  return ret;
+}
+
+static const EncoderInfo *
+encoder_lookup (GstElement *encoder)
+{
+  GstElementFactory *factory = gst_element_get_factory (encoder);
+  const gchar *name = factory ? gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory)) : NULL;
+  guint i;
+
+  for (i = 0; name && i < G_N_ELEMENTS (encoders); i++) {
+    if (!strcmp (encoders[i].factory, name))
+      return &encoders[i];
+  }
+
+  return NULL;
+}
+
+static void
+encoder_set (GstElement *encoder, const gchar *property, const gchar *value)
+{
+  GParamSpec *pspec;
+  GValue v = G_VALUE_INIT;
+
+  if (!property || !value)
+    return;
+
+  if (!(pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (encoder), property))) {
+    GST_INFO_OBJECT (encoder, "No %s property, ignoring %s", property, value);
+    return;
+  }
+
+  /* Same as gst_util_set_object_arg(), which doesn't tell when it fails */
+  g_value_init (&v, pspec->value_type);
+  if (gst_value_deserialize (&v, value))
+    g_object_set_property (G_OBJECT (encoder), property, &v);
+  else
+    GST_WARNING_OBJECT (encoder, "Invalid %s \"%s\", ignored", property, value);
+  g_value_unset (&v);
+}
+
+void
+_gst_transcoding_configure_encoder (GstElement *encoder,
+                                    const GstTranscodingStreamSettings *settings,
+                                    guint default_threads)
+{
+  const EncoderInfo *info = encoder_lookup (encoder);
+  guint threads = settings->threads ? settings->threads : default_threads;
+  gchar *value;
+
+  if (threads) {
+    value = g_strdup_printf ("%u", threads);
+    encoder_set (encoder, "threads", value);
+    g_free (value);
+  }
+
+  if (!info) {
+    if (settings->bitrate || settings->rate_control || settings->speed_preset || settings->tune)
+      GST_INFO_OBJECT (encoder, "Unknown encoder, only its thread count is set");
+    return;
+  }
+
+  if (settings->bitrate) {
+    value = g_strdup_printf ("%u", MAX (settings->bitrate / info->bitrate_unit, 1));
+    encoder_set (encoder, info->bitrate_mode[0], info->bitrate_mode[1]);
+    encoder_set (encoder, info->bitrate, value);
+    g_free (value);
+  }
+
+  if (settings->rate_control == GST_TRANSCODING_RATE_CONTROL_VBR && settings->bitrate)
+    encoder_set (encoder, info->rate_control, info->rate_controls[2]);
+  else if (settings->rate_control)
+    encoder_set (encoder, info->rate_control, info->rate_controls[settings->rate_control - 1]);
+
+  if (settings->speed_preset)
+    encoder_set (encoder, info->speed_preset, info->speed_presets[settings->speed_preset - 1]);
+
+  encoder_set (encoder, info->tune, settings->tune);
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "job.h"
+
+G_BEGIN_DECLS
+
+/* Internal structures, shared between the job model and the code that
+ * executes it. Nothing in here is part of the public API. */
+
+typedef enum
+{
+  AUDIO,
+  VIDEO,
+} MediaType;
+
+/* Encoding settings of a stream profile. Immutable once shared: profiles
+ * mapped from a meta profile share its settings until either is modified,
+ * see _gst_transcoding_stream_profile_edit_settings() */
+typedef struct
+{
+  gatomicrefcount ref_count;
+  GstTranscodingFormat format;
+  guint bitrate;
+  GstTranscodingRateControl rate_control;
+  GstTranscodingSpeedPreset speed_preset;
+  /* Interned, so that settings can be copied and compared as is */
+  const gchar *tune;
+  guint threads;
+  /* Video only, 0 to keep the source dimension */
+  guint width;
+  guint height;
+  /* Audio only, 0 or NULL to keep that of the source. The sample format
+   * is interned too. */
+  guint rate;
+  guint channels;
+  const gchar *sample_format;
+} GstTranscodingStreamSettings;
+
+typedef struct
+{
+  GstTranscodingInput *input;
+  GstTranscodingOutput *output;
+  GstTranscodingStreamSettings *settings;
+} GstTranscodingStreamProfilePrivate;
+
+struct _GstTranscodingVideoProfile
+{
+  GstTranscodingStreamProfile parent;
+};
+
+struct _GstTranscodingAudioProfile
+{
+  GstTranscodingStreamProfile parent;
+};
+
+struct _GstTranscodingContainerProfile
+{
+  GObject parent;
+  GstTranscodingAudioProfile *meta_audio_profile;
+  GstTranscodingVideoProfile *meta_video_profile;
+  GstTranscodingFormat format;
+};
+
+/* URIs and stream-ids are interned GRefStrings, shared with the keys of
+ * the tables of the job */
+struct _GstTranscodingInput
+{
+  GObject parent;
+  gchar *uri;
+  /* Protects profiles while the job is being built */
+  GMutex lock;
+  GHashTable *profiles;
+  gboolean auto_link;
+  /* Only this range gets transcoded, GST_CLOCK_TIME_NONE for unbounded */
+  GstClockTime start;
+  GstClockTime stop;
+};
+
+struct _GstTranscodingOutput
+{
+  GObject parent;
+  gchar *uri;
+  gboolean auto_link;
+  GstTranscodingContainerProfile *profile;
+  GstTranscodingCacheStatus cache_status;
+  /* URIs of the inputs played one after the other, NULL when they are
+   * played together */
+  gchar **sequence;
+};
+
+struct _GstTranscodingJob
+{
+  GObject parent;
+
+  /* Protects inputs and outputs while the job is being built */
+  GMutex lock;
+  GHashTable *inputs;
+  GHashTable *outputs;
+
+  GstClockTime segment_duration;
+  gboolean smart_render;
+  guint max_workers;
+  gchar *worker_executable;
+  /* Directory of the discovery cache, NULL if disabled */
+  gchar *discovery_cache;
+  /* Directory of the output cache, NULL if disabled */
+  gchar *output_cache;
+
+  /* Resource limits, set by the scheduler, 0 for the element defaults */
+  guint encoder_threads;
+  guint queue_max_bytes;
+};
+
+G_GNUC_INTERNAL
+GstTranscodingStreamProfilePrivate * _gst_transcoding_stream_profile_get_private (GstTranscodingStreamProfile *self);
+
+G_GNUC_INTERNAL
+MediaType _gst_transcoding_stream_profile_get_media_type (GstTranscodingStreamProfile *self);
+
+G_GNUC_INTERNAL
+const GstTranscodingStreamSettings * _gst_transcoding_stream_profile_get_settings (GstTranscodingStreamProfile *self);
+
+/* Settings of @self that can be modified, copied first if shared */
+G_GNUC_INTERNAL
+GstTranscodingStreamSettings * _gst_transcoding_stream_profile_edit_settings (GstTranscodingStreamProfile *self);
+
+/* Gives @self a copy of @settings, whose reference count is ignored */
+G_GNUC_INTERNAL
+void _gst_transcoding_stream_profile_set_settings (GstTranscodingStreamProfile *self,
+                                                   const GstTranscodingStreamSettings *settings);
+
+/* Default settings, for settings being read */
+G_GNUC_INTERNAL
+void _gst_transcoding_stream_settings_init (GstTranscodingStreamSettings *settings);
+
+/* Whether a stream already in the format of @settings can be copied rather
+ * than re-encoded: copying ignores the raw format they ask for */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_stream_settings_allow_copy (const GstTranscodingStreamSettings *settings);
+
+/* Names of the settings enums in serialized jobs */
+G_GNUC_INTERNAL
+const gchar * _gst_transcoding_rate_control_to_string (GstTranscodingRateControl rate_control);
+
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_rate_control_from_string (const gchar *str, GstTranscodingRateControl *rate_control);
+
+G_GNUC_INTERNAL
+const gchar * _gst_transcoding_speed_preset_to_string (GstTranscodingSpeedPreset speed_preset);
+
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_speed_preset_from_string (const gchar *str, GstTranscodingSpeedPreset *speed_preset);
+
+/* Gives @dst the encoding settings of @src, which must be of the same type */
+G_GNUC_INTERNAL
+void _gst_transcoding_stream_profile_copy_into (GstTranscodingStreamProfile *src, GstTranscodingStreamProfile *dst);
+
+/* Encoding settings as a vardict, format and all, without input / output */
+G_GNUC_INTERNAL
+GVariant * _gst_transcoding_stream_profile_settings_to_variant (GstTranscodingStreamProfile *self);
+
+G_GNUC_INTERNAL
+void _gst_transcoding_stream_profile_settings_from_variant (GstTranscodingStreamProfile *self, GVariant *settings);
+
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_stream_profile_equal (GstTranscodingStreamProfile *a, GstTranscodingStreamProfile *b);
+
+G_END_DECLS
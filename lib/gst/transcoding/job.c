@@ -1,91 +1,140 @@
-#include <json-glib/json-glib.h>
-#include "job.h"
+#include <string.h>
+#include "format-private.h"
 
 G_DEFINE_QUARK (application/unknown, gst_transcoding_format_none)
 
 G_DEFINE_QUARK (video/x-matroska, gst_transcoding_format_matroska)
 
+G_DEFINE_QUARK (video/quicktime, gst_transcoding_format_mp4)
+
+G_DEFINE_QUARK (video/webm, gst_transcoding_format_webm)
+
+G_DEFINE_QUARK (video/mpegts, gst_transcoding_format_mpegts)
+
 G_DEFINE_QUARK (video/x-h264, gst_transcoding_format_h264)
 
+G_DEFINE_QUARK (video/x-h265, gst_transcoding_format_h265)
+
+G_DEFINE_QUARK (video/x-vp8, gst_transcoding_format_vp8)
+
+G_DEFINE_QUARK (video/x-vp9, gst_transcoding_format_vp9)
+
+G_DEFINE_QUARK (video/x-av1, gst_transcoding_format_av1)
+
 G_DEFINE_QUARK (audio/x-aac, gst_transcoding_format_aac)
 
-typedef enum
-{
-  AUDIO,
-  VIDEO,
-} MediaType;
+G_DEFINE_QUARK (audio/mpeg, gst_transcoding_format_mp3)
 
-typedef struct
-{
-  GstTranscodingInput *input;
-  GstTranscodingOutput *output;
-  GstTranscodingFormat format;
-} GstTranscodingStreamProfilePrivate;
+G_DEFINE_QUARK (audio/x-opus, gst_transcoding_format_opus)
 
-G_DEFINE_TYPE_WITH_PRIVATE (GstTranscodingStreamProfile, gst_transcoding_stream_profile, G_TYPE_OBJECT)
+G_DEFINE_QUARK (audio/x-vorbis, gst_transcoding_format_vorbis)
 
-struct _GstTranscodingVideoProfile
-{
-  GstTranscodingStreamProfile parent;
-};
+G_DEFINE_QUARK (gst-transcoding-error-quark, gst_transcoding_error)
+
+G_DEFINE_TYPE_WITH_PRIVATE (GstTranscodingStreamProfile, gst_transcoding_stream_profile, G_TYPE_OBJECT)
 
 G_DEFINE_TYPE (GstTranscodingVideoProfile, gst_transcoding_video_profile, GST_TRANSCODING_TYPE_STREAM_PROFILE)
 
-struct _GstTranscodingAudioProfile
+G_DEFINE_TYPE (GstTranscodingAudioProfile, gst_transcoding_audio_profile, GST_TRANSCODING_TYPE_STREAM_PROFILE)
+
+G_DEFINE_TYPE (GstTranscodingContainerProfile, gst_transcoding_container_profile, G_TYPE_OBJECT)
+
+G_DEFINE_TYPE (GstTranscodingInput, gst_transcoding_input, G_TYPE_OBJECT)
+
+G_DEFINE_TYPE (GstTranscodingOutput, gst_transcoding_output, G_TYPE_OBJECT)
+
+G_DEFINE_TYPE (GstTranscodingJob, gst_transcoding_job, G_TYPE_OBJECT)
+
+static GstTranscodingStreamSettings *
+stream_settings_ref (GstTranscodingStreamSettings *settings)
 {
-  GstTranscodingStreamProfile parent;
-};
+  g_atomic_ref_count_inc (&settings->ref_count);
 
-G_DEFINE_TYPE (GstTranscodingAudioProfile, gst_transcoding_audio_profile, GST_TRANSCODING_TYPE_STREAM_PROFILE)
+  return settings;
+}
 
-struct _GstTranscodingContainerProfile
+static void
+stream_settings_unref (GstTranscodingStreamSettings *settings)
 {
-  GObject parent;
-  GstTranscodingAudioProfile *meta_audio_profile;
-  GstTranscodingVideoProfile *meta_video_profile;
-  GstTranscodingFormat format;
-};
+  if (g_atomic_ref_count_dec (&settings->ref_count))
+    g_free (settings);
+}
 
-G_DEFINE_TYPE (GstTranscodingContainerProfile, gst_transcoding_container_profile, G_TYPE_OBJECT)
+static GstTranscodingStreamSettings *
+stream_settings_copy (const GstTranscodingStreamSettings *settings)
+{
+  GstTranscodingStreamSettings *ret = g_new (GstTranscodingStreamSettings, 1);
+
+  *ret = *settings;
+  g_atomic_ref_count_init (&ret->ref_count);
 
-struct _GstTranscodingInput
+  return ret;
+}
+
+static gboolean
+stream_settings_equal (const GstTranscodingStreamSettings *a, const GstTranscodingStreamSettings *b)
 {
-  GObject parent;
-  gchar *uri;
-  GHashTable *profiles;
-  gboolean auto_link;
-};
+  return a->format == b->format && a->bitrate == b->bitrate && a->rate_control == b->rate_control &&
+    a->speed_preset == b->speed_preset && a->tune == b->tune && a->threads == b->threads &&
+    a->width == b->width && a->height == b->height && a->rate == b->rate && a->channels == b->channels &&
+    a->sample_format == b->sample_format;
+}
 
-G_DEFINE_TYPE (GstTranscodingInput, gst_transcoding_input, G_TYPE_OBJECT)
+void
+_gst_transcoding_stream_settings_init (GstTranscodingStreamSettings *settings)
+{
+  memset (settings, 0, sizeof (*settings));
+  g_atomic_ref_count_init (&settings->ref_count);
+  settings->format = GST_TRANSCODING_FORMAT_NONE;
+}
 
-struct _GstTranscodingOutput
+gboolean
+_gst_transcoding_stream_settings_allow_copy (const GstTranscodingStreamSettings *settings)
 {
-  GObject parent;
-  gchar *uri;
-  gboolean auto_link;
-  GstTranscodingContainerProfile *profile;
-};
+  return !settings->width && !settings->height && !settings->rate && !settings->channels && !settings->sample_format;
+}
 
-G_DEFINE_TYPE (GstTranscodingOutput, gst_transcoding_output, G_TYPE_OBJECT)
+/* Settings of new profiles, never modified as we always hold a reference */
+static GstTranscodingStreamSettings *
+stream_settings_get_default (void)
+{
+  static GstTranscodingStreamSettings *settings = NULL;
+
+  if (g_once_init_enter (&settings)) {
+    GstTranscodingStreamSettings *tmp = g_new (GstTranscodingStreamSettings, 1);
 
-struct _GstTranscodingJob
+    _gst_transcoding_stream_settings_init (tmp);
+    g_once_init_leave (&settings, tmp);
+  }
+
+  return stream_settings_ref (settings);
+}
+
+static void
+stream_profile_finalize (GObject *object)
 {
-  GObject parent;
+  GstTranscodingStreamProfilePrivate *priv =
+    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) object);
 
-  GHashTable *inputs;
-  GHashTable *outputs;
-};
+  stream_settings_unref (priv->settings);
 
-G_DEFINE_TYPE (GstTranscodingJob, gst_transcoding_job, G_TYPE_OBJECT)
+  G_OBJECT_CLASS (gst_transcoding_stream_profile_parent_class)->finalize (object);
+}
 
 static void
 gst_transcoding_stream_profile_class_init (GstTranscodingStreamProfileClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = stream_profile_finalize;
 }
 
 static void
 gst_transcoding_stream_profile_init (GstTranscodingStreamProfile *self)
 {
+  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
+
+  priv->settings = stream_settings_get_default ();
 }
 
 static void
@@ -108,9 +157,23 @@ gst_transcoding_audio_profile_init (GstTranscodingAudioProfile *self)
 {
 }
 
+static void
+container_profile_finalize (GObject *object)
+{
+  GstTranscodingContainerProfile *self = GST_TRANSCODING_CONTAINER_PROFILE (object);
+
+  g_object_unref (self->meta_audio_profile);
+  g_object_unref (self->meta_video_profile);
+
+  G_OBJECT_CLASS (gst_transcoding_container_profile_parent_class)->finalize (object);
+}
+
 static void
 gst_transcoding_container_profile_class_init (GstTranscodingContainerProfileClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = container_profile_finalize;
 }
 
 static void
@@ -118,19 +181,50 @@ gst_transcoding_container_profile_init (GstTranscodingContainerProfile *self)
 {
 }
 
+static void
+input_finalize (GObject *object)
+{
+  GstTranscodingInput *self = GST_TRANSCODING_INPUT (object);
+
+  g_ref_string_release (self->uri);
+  g_hash_table_unref (self->profiles);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (gst_transcoding_input_parent_class)->finalize (object);
+}
+
 static void
 gst_transcoding_input_class_init (GstTranscodingInputClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = input_finalize;
 }
 
 static void
 gst_transcoding_input_init (GstTranscodingInput *self)
 {
+  g_mutex_init (&self->lock);
+}
+
+static void
+output_finalize (GObject *object)
+{
+  GstTranscodingOutput *self = GST_TRANSCODING_OUTPUT (object);
+
+  g_ref_string_release (self->uri);
+  g_object_unref (self->profile);
+  g_strfreev (self->sequence);
+
+  G_OBJECT_CLASS (gst_transcoding_output_parent_class)->finalize (object);
 }
 
 static void
 gst_transcoding_output_class_init (GstTranscodingOutputClass *klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = output_finalize;
 }
 
 static void
@@ -145,6 +239,10 @@ job_finalize (GObject *object)
 
   g_hash_table_unref (self->inputs);
   g_hash_table_unref (self->outputs);
+  g_free (self->worker_executable);
+  g_free (self->discovery_cache);
+  g_free (self->output_cache);
+  g_mutex_clear (&self->lock);
 
   G_OBJECT_CLASS (gst_transcoding_job_parent_class)->finalize (object);
 }
@@ -160,8 +258,11 @@ gst_transcoding_job_class_init (GstTranscodingJobClass *klass)
 static void
 gst_transcoding_job_init (GstTranscodingJob *self)
 {
-  self->inputs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
-  self->outputs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  g_mutex_init (&self->lock);
+  self->inputs = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) g_ref_string_release, g_object_unref);
+  self->outputs = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) g_ref_string_release, g_object_unref);
+  self->segment_duration = GST_CLOCK_TIME_NONE;
+  self->max_workers = 0;
 }
 
 GstTranscodingJob *
@@ -170,17 +271,22 @@ gst_transcoding_job_new (void)
   return g_object_new (GST_TRANSCODING_TYPE_JOB, NULL);
 }
 
+/* Must be called with the job lock held, the returned reference is the
+ * caller's */
 static GstTranscodingInput *
 job_create_input (GstTranscodingJob *self, const gchar *uri)
 {
   GstTranscodingInput *ret = g_object_new(GST_TRANSCODING_TYPE_INPUT, NULL);
 
-  ret->uri = g_strdup (uri);
-  ret->profiles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  ret->uri = g_ref_string_new_intern (uri);
+  ret->profiles = g_hash_table_new_full (g_str_hash, g_str_equal, (GDestroyNotify) g_ref_string_release,
+      (GDestroyNotify) g_ptr_array_unref);
 
-  g_hash_table_insert (self->inputs, (gpointer) g_strdup (uri), g_object_ref (ret));
+  g_hash_table_insert (self->inputs, g_ref_string_acquire (ret->uri), g_object_ref (ret));
 
   ret->auto_link = FALSE;
+  ret->start = GST_CLOCK_TIME_NONE;
+  ret->stop = GST_CLOCK_TIME_NONE;
 
   return ret;
 }
@@ -188,10 +294,18 @@ job_create_input (GstTranscodingJob *self, const gchar *uri)
 static GstTranscodingInput *
 job_get_input (GstTranscodingJob *self, const gchar *uri, gboolean create)
 {
-  GstTranscodingInput *ret = g_hash_table_lookup (self->inputs, uri);
+  GstTranscodingInput *ret;
 
-  if (!ret && create)
+  g_mutex_lock (&self->lock);
+
+  ret = g_hash_table_lookup (self->inputs, uri);
+  if (!ret && create) {
     ret = job_create_input (self, uri);
+    /* Inputs are never removed, the reference of the job is enough */
+    g_object_unref (ret);
+  }
+
+  g_mutex_unlock (&self->lock);
 
   return ret;
 }
@@ -201,29 +315,26 @@ job_create_container_profile_from_extension (const gchar *uri)
 {
   GstTranscodingContainerProfile *ret = gst_transcoding_container_profile_new (NULL, NULL);
 
-  /* TODO: add some more :) */
-  if (g_str_has_suffix(uri, ".mkv")) {
-    ret->format = GST_TRANSCODING_FORMAT_MATROSKA;
-  } else {
-    ret->format = GST_TRANSCODING_FORMAT_NONE;
-  }
+  ret->format = _gst_transcoding_format_from_extension (uri);
 
   return ret;
 }
 
+/* Must be called with the job lock held, the returned reference is the
+ * caller's */
 static GstTranscodingOutput *
 job_create_output (GstTranscodingJob *self, GstTranscodingContainerProfile *profile, const gchar *uri)
 {
   GstTranscodingOutput *ret = g_object_new(GST_TRANSCODING_TYPE_OUTPUT, NULL);
 
-  ret->uri = g_strdup (uri);
+  ret->uri = g_ref_string_new_intern (uri);
 
   if (profile)
     ret->profile = profile;
   else
     ret->profile = job_create_container_profile_from_extension (uri);
 
-  g_hash_table_insert (self->outputs, (gpointer) g_strdup (uri), g_object_ref (ret));
+  g_hash_table_insert (self->outputs, g_ref_string_acquire (ret->uri), g_object_ref (ret));
 
   ret->auto_link = FALSE;
 
@@ -233,46 +344,25 @@ job_create_output (GstTranscodingJob *self, GstTranscodingContainerProfile *prof
 static GstTranscodingOutput *
 job_get_output (GstTranscodingJob *self, GstTranscodingContainerProfile *profile, const gchar *uri, gboolean create)
 {
-  GstTranscodingOutput *ret = g_hash_table_lookup (self->outputs, uri);
-
-  if (!ret && create)
-    ret = job_create_output (self, profile, uri);
-
-  return ret;
-}
-
-static void
-video_profile_copy_into (GstTranscodingVideoProfile *src, GstTranscodingVideoProfile *dst)
-{
-  GstTranscodingStreamProfilePrivate *srcpriv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) src);
-  GstTranscodingStreamProfilePrivate *dstpriv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) dst);
-
-  dstpriv->format = srcpriv->format;
+  GstTranscodingOutput *ret;
 
-  /* TODO: copy video-specific attributes */
-}
+  g_mutex_lock (&self->lock);
 
-static void
-audio_profile_copy_into (GstTranscodingAudioProfile *src, GstTranscodingAudioProfile *dst)
-{
-  GstTranscodingStreamProfilePrivate *srcpriv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) src);
-  GstTranscodingStreamProfilePrivate *dstpriv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) dst);
+  ret = g_hash_table_lookup (self->outputs, uri);
+  if (!ret && create) {
+    ret = job_create_output (self, profile, uri);
+    /* Outputs are never removed, the reference of the job is enough */
+    g_object_unref (ret);
+  }
 
-  dstpriv->format = srcpriv->format;
+  g_mutex_unlock (&self->lock);
 
-  /* TODO: copy audio-specific attributes */
+  return ret;
 }
 
 static GstTranscodingStreamProfile *
-job_map_stream(GstTranscodingJob *self,
-    const gchar *in_uri, const gchar *stream_id, MediaType media_type, const gchar *out_uri)
+input_map_stream (GstTranscodingInput *input, const gchar *stream_id, MediaType media_type, GstTranscodingOutput *output)
 {
-  GstTranscodingInput *input = job_get_input (self, in_uri, TRUE);
-  GstTranscodingOutput *output = job_get_output (self, NULL, out_uri, TRUE);
   GstTranscodingStreamProfile *ret;
   GstTranscodingStreamProfilePrivate *priv;
   GPtrArray *profiles;
@@ -288,19 +378,22 @@ job_map_stream(GstTranscodingJob *self,
   priv->output = output;
 
   if (media_type == VIDEO) {
-    video_profile_copy_into (output->profile->meta_video_profile, (GstTranscodingVideoProfile *) ret);
+    _gst_transcoding_stream_profile_copy_into ((GstTranscodingStreamProfile *) output->profile->meta_video_profile, ret);
   } else {
-    audio_profile_copy_into (output->profile->meta_audio_profile, (GstTranscodingAudioProfile *) ret);
+    _gst_transcoding_stream_profile_copy_into ((GstTranscodingStreamProfile *) output->profile->meta_audio_profile, ret);
   }
 
-  if (!g_hash_table_contains (input->profiles, stream_id)) {
-    profiles = g_ptr_array_new_with_free_func(g_object_unref);
+  g_mutex_lock (&input->lock);
+
+  profiles = g_hash_table_lookup (input->profiles, stream_id);
+
+  if (!profiles) {
+    profiles = g_ptr_array_new_full (1, g_object_unref);
     g_ptr_array_add (profiles, g_object_ref (ret));
-    g_hash_table_insert (input->profiles, g_strdup (stream_id), profiles);
+    g_hash_table_insert (input->profiles, g_ref_string_new_intern (stream_id), profiles);
   } else {
     GstTranscodingStreamProfile *prior_profile;
 
-    profiles = g_hash_table_lookup (input->profiles, stream_id);
     prior_profile = (GstTranscodingStreamProfile *) g_ptr_array_index (profiles, 0);
 
     /* Detect impossible situation */
@@ -312,9 +405,21 @@ job_map_stream(GstTranscodingJob *self,
     }
   }
 
+  g_mutex_unlock (&input->lock);
+
   return ret;
 }
 
+static GstTranscodingStreamProfile *
+job_map_stream(GstTranscodingJob *self,
+    const gchar *in_uri, const gchar *stream_id, MediaType media_type, const gchar *out_uri)
+{
+  GstTranscodingInput *input = job_get_input (self, in_uri, TRUE);
+  GstTranscodingOutput *output = job_get_output (self, NULL, out_uri, TRUE);
+
+  return input_map_stream (input, stream_id, media_type, output);
+}
+
 GstTranscodingVideoProfile *
 gst_transcoding_job_map_video_stream (GstTranscodingJob *self, const gchar *in_uri, const gchar *stream_id, const gchar *out_uri)
 {
@@ -327,17 +432,157 @@ gst_transcoding_job_map_audio_stream (GstTranscodingJob *self, const gchar *in_u
   return (GstTranscodingAudioProfile *) job_map_stream (self, in_uri, stream_id, AUDIO, out_uri);
 }
 
+static MediaType
+media_type_from_public (GstTranscodingMediaType media_type)
+{
+  return media_type == GST_TRANSCODING_MEDIA_TYPE_VIDEO ? VIDEO : AUDIO;
+}
+
+/* Checks that no stream ends up mapped as both audio and video, neither
+ * against the job nor within the batch */
+static gboolean
+job_validate_mappings (GstTranscodingJob *self, const GstTranscodingStreamMapping *mappings, guint n_mappings,
+    GError **error)
+{
+  /* in_uri -> stream_id -> MediaType + 1, for streams new to the job */
+  GHashTable *batch_types = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_hash_table_unref);
+  GstTranscodingInput *input = NULL;
+  GHashTable *stream_types = NULL;
+  const gchar *in_uri = NULL;
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < n_mappings && ret; i++) {
+    const GstTranscodingStreamMapping *mapping = &mappings[i];
+    MediaType media_type = media_type_from_public (mapping->media_type);
+    GPtrArray *profiles = NULL;
+
+    if (!in_uri || strcmp (in_uri, mapping->in_uri)) {
+      in_uri = mapping->in_uri;
+      input = job_get_input (self, in_uri, FALSE);
+      stream_types = g_hash_table_lookup (batch_types, in_uri);
+      if (!stream_types) {
+        stream_types = g_hash_table_new (g_str_hash, g_str_equal);
+        g_hash_table_insert (batch_types, (gpointer) in_uri, stream_types);
+      }
+    }
+
+    if (input) {
+      g_mutex_lock (&input->lock);
+      profiles = g_hash_table_lookup (input->profiles, mapping->stream_id);
+      if (profiles)
+        ret = _gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (profiles, 0)) == media_type;
+      g_mutex_unlock (&input->lock);
+    }
+
+    if (!profiles) {
+      gpointer prior = g_hash_table_lookup (stream_types, mapping->stream_id);
+
+      if (prior)
+        ret = GPOINTER_TO_INT (prior) - 1 == media_type;
+      else
+        g_hash_table_insert (stream_types, (gpointer) mapping->stream_id, GINT_TO_POINTER (media_type + 1));
+    }
+
+    if (!ret)
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+          "Stream %s of %s can't be mapped as both audio and video", mapping->stream_id, in_uri);
+  }
+
+  g_hash_table_unref (batch_types);
+
+  return ret;
+}
+
+static void
+profile_unref (GstTranscodingStreamProfile *profile)
+{
+  if (profile)
+    g_object_unref (profile);
+}
+
+GPtrArray *
+gst_transcoding_job_map_streams (GstTranscodingJob *self,
+                                 const GstTranscodingStreamMapping *mappings,
+                                 guint n_mappings,
+                                 GError **error)
+{
+  GstTranscodingInput *input = NULL;
+  GstTranscodingOutput *output = NULL;
+  GPtrArray *ret;
+  guint i;
+
+  if (!job_validate_mappings (self, mappings, n_mappings, error))
+    return NULL;
+
+  ret = g_ptr_array_new_full (n_mappings, (GDestroyNotify) profile_unref);
+
+  /* Batches usually come sorted, consecutive mappings mostly share their
+   * input and output */
+  for (i = 0; i < n_mappings; i++) {
+    const GstTranscodingStreamMapping *mapping = &mappings[i];
+
+    if (!input || strcmp (input->uri, mapping->in_uri))
+      input = job_get_input (self, mapping->in_uri, TRUE);
+
+    if (!output || strcmp (output->uri, mapping->out_uri))
+      output = job_get_output (self, NULL, mapping->out_uri, TRUE);
+
+    g_ptr_array_add (ret, input_map_stream (input, mapping->stream_id, media_type_from_public (mapping->media_type), output));
+  }
+
+  return ret;
+}
+
+GPtrArray *
+gst_transcoding_job_map_video_ladder (GstTranscodingJob *self,
+                                      const gchar *in_uri,
+                                      const gchar *stream_id,
+                                      const GstTranscodingLadderRung *rungs,
+                                      guint n_rungs,
+                                      GError **error)
+{
+  GstTranscodingStreamMapping *mappings = g_new (GstTranscodingStreamMapping, n_rungs);
+  GPtrArray *ret;
+  guint i;
+
+  for (i = 0; i < n_rungs; i++) {
+    mappings[i].in_uri = in_uri;
+    mappings[i].stream_id = stream_id;
+    mappings[i].media_type = GST_TRANSCODING_MEDIA_TYPE_VIDEO;
+    mappings[i].out_uri = rungs[i].out_uri;
+  }
+
+  ret = gst_transcoding_job_map_streams (self, mappings, n_rungs, error);
+  g_free (mappings);
+
+  for (i = 0; ret && i < ret->len; i++) {
+    GstTranscodingStreamProfile *profile = g_ptr_array_index (ret, i);
+
+    if (!profile)
+      continue;
+
+    gst_transcoding_video_profile_set_size ((GstTranscodingVideoProfile *) profile, rungs[i].width, rungs[i].height);
+    if (rungs[i].bitrate)
+      gst_transcoding_stream_profile_set_bitrate (profile, rungs[i].bitrate);
+  }
+
+  return ret;
+}
+
 GstTranscodingInput * gst_transcoding_job_add_input (GstTranscodingJob *self,
                                                      const gchar *uri)
 {
-  GstTranscodingInput *ret;
+  GstTranscodingInput *ret = NULL;
 
-  if (job_get_input (self, uri, FALSE))
-    return NULL;
+  g_mutex_lock (&self->lock);
 
-  ret = job_create_input (self, uri);
+  if (!g_hash_table_contains (self->inputs, uri)) {
+    ret = job_create_input (self, uri);
+    ret->auto_link = TRUE;
+  }
 
-  ret->auto_link = TRUE;
+  g_mutex_unlock (&self->lock);
 
   return ret;
 }
@@ -346,143 +591,254 @@ GstTranscodingOutput * gst_transcoding_job_add_output (GstTranscodingJob *self,
                                                        const gchar *uri,
                                                        GstTranscodingContainerProfile *profile)
 {
-  GstTranscodingOutput *ret;
+  GstTranscodingOutput *ret = NULL;
 
-  if (job_get_output (self, NULL, uri, FALSE))
-    return NULL;
+  g_mutex_lock (&self->lock);
 
-  ret = job_create_output (self, profile, uri);
+  if (!g_hash_table_contains (self->outputs, uri)) {
+    ret = job_create_output (self, profile, uri);
+    ret->auto_link = TRUE;
+  }
 
-  ret->auto_link = TRUE;
+  g_mutex_unlock (&self->lock);
 
   return ret;
 }
 
-static void
-audio_profile_to_json (GstTranscodingAudioProfile *profile, JsonBuilder *builder)
+void
+gst_transcoding_job_set_segment_duration (GstTranscodingJob *self, GstClockTime duration)
 {
-  /* TODO: serialize audio-specific properties */
+  self->segment_duration = duration;
 }
 
-static void
-video_profile_to_json (GstTranscodingVideoProfile *profile, JsonBuilder *builder)
+void
+gst_transcoding_job_set_smart_render (GstTranscodingJob *self, gboolean smart_render)
 {
-  /* TODO: serialize video-specific properties */
+  self->smart_render = smart_render;
 }
 
-static void
-profile_to_json (GstTranscodingStreamProfile *profile, JsonBuilder *builder)
+void
+gst_transcoding_job_set_max_workers (GstTranscodingJob *self, guint max_workers)
 {
-  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (profile);
+  self->max_workers = max_workers;
+}
 
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "format");
-  json_builder_add_string_value (builder, g_quark_to_string (priv->format));
+void
+gst_transcoding_job_set_worker_executable (GstTranscodingJob *self, const gchar *path)
+{
+  g_free (self->worker_executable);
+  self->worker_executable = g_strdup (path);
+}
 
-  if (GST_TRANSCODING_IS_AUDIO_PROFILE (profile)) {
-    audio_profile_to_json ((GstTranscodingAudioProfile *) profile, builder);
-  } else {
-    video_profile_to_json ((GstTranscodingVideoProfile *) profile, builder);
-  }
+void
+gst_transcoding_job_set_discovery_cache (GstTranscodingJob *self, const gchar *dir)
+{
+  g_free (self->discovery_cache);
+  self->discovery_cache = g_strdup (dir);
+}
+
+void
+gst_transcoding_job_set_output_cache (GstTranscodingJob *self, const gchar *dir)
+{
+  g_free (self->output_cache);
+  self->output_cache = g_strdup (dir);
+}
 
-  if (priv->output) {
-    json_builder_set_member_name (builder, "output");
-    json_builder_add_string_value (builder, priv->output->uri);
+GstTranscodingStreamProfilePrivate *
+_gst_transcoding_stream_profile_get_private (GstTranscodingStreamProfile *self)
+{
+  return gst_transcoding_stream_profile_get_instance_private (self);
+}
+
+MediaType
+_gst_transcoding_stream_profile_get_media_type (GstTranscodingStreamProfile *self)
+{
+  return GST_TRANSCODING_IS_VIDEO_PROFILE (self) ? VIDEO : AUDIO;
+}
+
+const GstTranscodingStreamSettings *
+_gst_transcoding_stream_profile_get_settings (GstTranscodingStreamProfile *self)
+{
+  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
+
+  return priv->settings;
+}
+
+GstTranscodingStreamSettings *
+_gst_transcoding_stream_profile_edit_settings (GstTranscodingStreamProfile *self)
+{
+  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
+
+  if (!g_atomic_ref_count_compare (&priv->settings->ref_count, 1)) {
+    GstTranscodingStreamSettings *copy = stream_settings_copy (priv->settings);
+
+    stream_settings_unref (priv->settings);
+    priv->settings = copy;
   }
 
-  json_builder_end_object (builder);
+  return priv->settings;
 }
 
-static void
-container_profile_to_json (GstTranscodingContainerProfile *profile, JsonBuilder *builder)
+/* Only shares the settings, they get copied once either profile changes */
+void
+_gst_transcoding_stream_profile_copy_into (GstTranscodingStreamProfile *src, GstTranscodingStreamProfile *dst)
 {
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "format");
-  json_builder_add_string_value (builder, g_quark_to_string (profile->format));
-  json_builder_set_member_name (builder, "meta-audio-profile");
-  profile_to_json ((GstTranscodingStreamProfile *) profile->meta_audio_profile, builder);
-  json_builder_set_member_name (builder, "meta-video-profile");
-  profile_to_json ((GstTranscodingStreamProfile *) profile->meta_video_profile, builder);
-  json_builder_end_object (builder);
+  GstTranscodingStreamProfilePrivate *srcpriv = gst_transcoding_stream_profile_get_instance_private (src);
+  GstTranscodingStreamProfilePrivate *dstpriv = gst_transcoding_stream_profile_get_instance_private (dst);
+  GstTranscodingStreamSettings *old = dstpriv->settings;
+
+  dstpriv->settings = stream_settings_ref (srcpriv->settings);
+  stream_settings_unref (old);
 }
 
-static void
-output_to_json (gchar *uri, GstTranscodingOutput *output, JsonBuilder *builder)
+void
+_gst_transcoding_stream_profile_set_settings (GstTranscodingStreamProfile *self,
+                                              const GstTranscodingStreamSettings *settings)
+{
+  GstTranscodingStreamSettings *dst;
+  gatomicrefcount ref_count;
+
+  if (stream_settings_equal (_gst_transcoding_stream_profile_get_settings (self), settings))
+    return;
+
+  dst = _gst_transcoding_stream_profile_edit_settings (self);
+  ref_count = dst->ref_count;
+  *dst = *settings;
+  dst->ref_count = ref_count;
+}
+
+static const gchar *rate_control_names[] = { "default", "cbr", "vbr" };
+
+static const gchar *speed_preset_names[] = { "default", "fastest", "fast", "medium", "slow", "slowest" };
+
+static gint
+names_lookup (const gchar **names, guint n_names, const gchar *str)
 {
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "uri");
-  json_builder_add_string_value (builder, uri);
-  json_builder_set_member_name (builder, "autolink");
-  json_builder_add_boolean_value (builder, output->auto_link);
-  json_builder_set_member_name (builder, "container-profile");
-  container_profile_to_json (output->profile, builder);
-  json_builder_end_object (builder);
+  guint i;
+
+  for (i = 0; i < n_names; i++) {
+    if (!g_strcmp0 (names[i], str))
+      return i;
+  }
+
+  return -1;
 }
 
-static void
-streams_to_json (gchar *stream_id, GPtrArray *profiles, JsonBuilder *builder)
+const gchar *
+_gst_transcoding_rate_control_to_string (GstTranscodingRateControl rate_control)
 {
-  GstTranscodingStreamProfile *first_profile;
+  return rate_control_names[rate_control];
+}
 
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "stream-id");
-  json_builder_add_string_value (builder, stream_id);
-  first_profile = g_ptr_array_index (profiles, 0);
-  json_builder_set_member_name (builder, "media-type");
-  if (GST_TRANSCODING_IS_AUDIO_PROFILE (first_profile))
-    json_builder_add_string_value (builder, "audio");
-  else
-    json_builder_add_string_value (builder, "video");
-  json_builder_set_member_name (builder, "profiles");
-  json_builder_begin_array (builder);
-  g_ptr_array_foreach (profiles, (GFunc) profile_to_json, builder);
-  json_builder_end_array(builder);
-  json_builder_end_object (builder);
+gboolean
+_gst_transcoding_rate_control_from_string (const gchar *str, GstTranscodingRateControl *rate_control)
+{
+  gint ret = names_lookup (rate_control_names, G_N_ELEMENTS (rate_control_names), str);
+
+  if (ret >= 0)
+    *rate_control = ret;
+
+  return ret >= 0;
 }
 
-static void
-input_to_json (gchar *uri, GstTranscodingInput *input, JsonBuilder *builder)
+const gchar *
+_gst_transcoding_speed_preset_to_string (GstTranscodingSpeedPreset speed_preset)
 {
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "uri");
-  json_builder_add_string_value (builder, uri);
-  json_builder_set_member_name (builder, "autolink");
-  json_builder_add_boolean_value (builder, input->auto_link);
-  json_builder_set_member_name (builder, "streams");
-  json_builder_begin_array (builder);
-  g_hash_table_foreach (input->profiles, (GHFunc) streams_to_json, builder);
-  json_builder_end_array (builder);
-  json_builder_end_object (builder);
+  return speed_preset_names[speed_preset];
 }
 
-gchar *
-gst_transcoding_job_to_json (GstTranscodingJob *self, gboolean pretty)
+gboolean
+_gst_transcoding_speed_preset_from_string (const gchar *str, GstTranscodingSpeedPreset *speed_preset)
 {
-  gchar *ret;
-  JsonBuilder *builder = json_builder_new();
-  JsonNode *root;
+  gint ret = names_lookup (speed_preset_names, G_N_ELEMENTS (speed_preset_names), str);
+
+  if (ret >= 0)
+    *speed_preset = ret;
 
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "outputs");
+  return ret >= 0;
+}
 
-  json_builder_begin_array (builder);
-  g_hash_table_foreach (self->outputs, (GHFunc) output_to_json, builder);
-  json_builder_end_array (builder);
+/* Only the settings that aren't at their default are added */
+GVariant *
+_gst_transcoding_stream_profile_settings_to_variant (GstTranscodingStreamProfile *self)
+{
+  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
+  const GstTranscodingStreamSettings *settings = priv->settings;
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "format", g_variant_new_string (g_quark_to_string (settings->format)));
+
+  if (settings->bitrate)
+    g_variant_builder_add (&builder, "{sv}", "bitrate", g_variant_new_uint32 (settings->bitrate));
+  if (settings->rate_control)
+    g_variant_builder_add (&builder, "{sv}", "rate-control",
+        g_variant_new_string (_gst_transcoding_rate_control_to_string (settings->rate_control)));
+  if (settings->speed_preset)
+    g_variant_builder_add (&builder, "{sv}", "speed-preset",
+        g_variant_new_string (_gst_transcoding_speed_preset_to_string (settings->speed_preset)));
+  if (settings->tune)
+    g_variant_builder_add (&builder, "{sv}", "tune", g_variant_new_string (settings->tune));
+  if (settings->threads)
+    g_variant_builder_add (&builder, "{sv}", "threads", g_variant_new_uint32 (settings->threads));
+  if (settings->width)
+    g_variant_builder_add (&builder, "{sv}", "width", g_variant_new_uint32 (settings->width));
+  if (settings->height)
+    g_variant_builder_add (&builder, "{sv}", "height", g_variant_new_uint32 (settings->height));
+  if (settings->rate)
+    g_variant_builder_add (&builder, "{sv}", "rate", g_variant_new_uint32 (settings->rate));
+  if (settings->channels)
+    g_variant_builder_add (&builder, "{sv}", "channels", g_variant_new_uint32 (settings->channels));
+  if (settings->sample_format)
+    g_variant_builder_add (&builder, "{sv}", "sample-format", g_variant_new_string (settings->sample_format));
+
+  return g_variant_builder_end (&builder);
+}
 
-  json_builder_set_member_name (builder, "inputs");
-  json_builder_begin_array (builder);
-  g_hash_table_foreach (self->inputs, (GHFunc) input_to_json, builder);
-  json_builder_end_array (builder);
+/* Unknown or invalid settings are ignored, as in JSON */
+void
+_gst_transcoding_stream_profile_settings_from_variant (GstTranscodingStreamProfile *self, GVariant *variant)
+{
+  GstTranscodingStreamSettings settings;
+  const gchar *str;
+
+  _gst_transcoding_stream_settings_init (&settings);
+
+  if (g_variant_lookup (variant, "format", "&s", &str))
+    settings.format = g_quark_from_string (str);
+  g_variant_lookup (variant, "bitrate", "u", &settings.bitrate);
+  if (g_variant_lookup (variant, "rate-control", "&s", &str))
+    _gst_transcoding_rate_control_from_string (str, &settings.rate_control);
+  if (g_variant_lookup (variant, "speed-preset", "&s", &str))
+    _gst_transcoding_speed_preset_from_string (str, &settings.speed_preset);
+  if (g_variant_lookup (variant, "tune", "&s", &str))
+    settings.tune = g_intern_string (str);
+  g_variant_lookup (variant, "threads", "u", &settings.threads);
+  g_variant_lookup (variant, "width", "u", &settings.width);
+  g_variant_lookup (variant, "height", "u", &settings.height);
+  g_variant_lookup (variant, "rate", "u", &settings.rate);
+  g_variant_lookup (variant, "channels", "u", &settings.channels);
+  if (g_variant_lookup (variant, "sample-format", "&s", &str))
+    settings.sample_format = g_intern_string (str);
+
+  _gst_transcoding_stream_profile_set_settings (self, &settings);
+}
 
-  json_builder_end_object (builder);
+/* Whether @a and @b produce the same encoded stream, regardless of their
+ * input and output */
+gboolean
+_gst_transcoding_stream_profile_equal (GstTranscodingStreamProfile *a, GstTranscodingStreamProfile *b)
+{
+  GstTranscodingStreamProfilePrivate *apriv = gst_transcoding_stream_profile_get_instance_private (a);
+  GstTranscodingStreamProfilePrivate *bpriv = gst_transcoding_stream_profile_get_instance_private (b);
 
-  root = json_builder_get_root (builder);
-  ret = json_to_string (root, TRUE);
+  if (G_OBJECT_TYPE (a) != G_OBJECT_TYPE (b))
+    return FALSE;
 
-  json_node_unref (root);
-  g_object_unref (builder);
+  if (apriv->settings == bpriv->settings)
+    return TRUE;
 
-  return ret;
+  return stream_settings_equal (apriv->settings, bpriv->settings);
 }
 
 GstTranscodingInput *
@@ -506,37 +862,172 @@ gst_transcoding_stream_profile_get_format (GstTranscodingStreamProfile *self)
 {
   GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
 
-  return priv->format;
+  return priv->settings->format;
 }
 
 void
 gst_transcoding_stream_profile_set_format (GstTranscodingStreamProfile *self, GstTranscodingFormat format)
 {
-  GstTranscodingStreamProfilePrivate *priv = gst_transcoding_stream_profile_get_instance_private (self);
+  if (_gst_transcoding_stream_profile_get_settings (self)->format != format)
+    _gst_transcoding_stream_profile_edit_settings (self)->format = format;
+}
+
+guint
+gst_transcoding_stream_profile_get_bitrate (GstTranscodingStreamProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings (self)->bitrate;
+}
+
+void
+gst_transcoding_stream_profile_set_bitrate (GstTranscodingStreamProfile *self, guint bitrate)
+{
+  if (_gst_transcoding_stream_profile_get_settings (self)->bitrate != bitrate)
+    _gst_transcoding_stream_profile_edit_settings (self)->bitrate = bitrate;
+}
+
+GstTranscodingRateControl
+gst_transcoding_stream_profile_get_rate_control (GstTranscodingStreamProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings (self)->rate_control;
+}
+
+void
+gst_transcoding_stream_profile_set_rate_control (GstTranscodingStreamProfile *self,
+                                                 GstTranscodingRateControl rate_control)
+{
+  g_return_if_fail (rate_control <= GST_TRANSCODING_RATE_CONTROL_VBR);
 
-  priv->format = format;
+  if (_gst_transcoding_stream_profile_get_settings (self)->rate_control != rate_control)
+    _gst_transcoding_stream_profile_edit_settings (self)->rate_control = rate_control;
+}
+
+GstTranscodingSpeedPreset
+gst_transcoding_stream_profile_get_speed_preset (GstTranscodingStreamProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings (self)->speed_preset;
+}
+
+void
+gst_transcoding_stream_profile_set_speed_preset (GstTranscodingStreamProfile *self,
+                                                 GstTranscodingSpeedPreset speed_preset)
+{
+  g_return_if_fail (speed_preset <= GST_TRANSCODING_SPEED_PRESET_SLOWEST);
+
+  if (_gst_transcoding_stream_profile_get_settings (self)->speed_preset != speed_preset)
+    _gst_transcoding_stream_profile_edit_settings (self)->speed_preset = speed_preset;
+}
+
+const gchar *
+gst_transcoding_stream_profile_get_tune (GstTranscodingStreamProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings (self)->tune;
+}
+
+void
+gst_transcoding_stream_profile_set_tune (GstTranscodingStreamProfile *self, const gchar *tune)
+{
+  tune = g_intern_string (tune);
+
+  if (_gst_transcoding_stream_profile_get_settings (self)->tune != tune)
+    _gst_transcoding_stream_profile_edit_settings (self)->tune = tune;
+}
+
+guint
+gst_transcoding_stream_profile_get_threads (GstTranscodingStreamProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings (self)->threads;
+}
+
+void
+gst_transcoding_stream_profile_set_threads (GstTranscodingStreamProfile *self, guint n_threads)
+{
+  if (_gst_transcoding_stream_profile_get_settings (self)->threads != n_threads)
+    _gst_transcoding_stream_profile_edit_settings (self)->threads = n_threads;
 }
 
 GstTranscodingVideoProfile *
 gst_transcoding_video_profile_new (void)
 {
-  GstTranscodingVideoProfile *ret = g_object_new (GST_TRANSCODING_TYPE_VIDEO_PROFILE, NULL);
-  GstTranscodingStreamProfilePrivate *priv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) ret);
-
-  priv->format = GST_TRANSCODING_FORMAT_NONE;
-  return ret;
+  return g_object_new (GST_TRANSCODING_TYPE_VIDEO_PROFILE, NULL);
 }
 
 GstTranscodingAudioProfile *
 gst_transcoding_audio_profile_new (void)
 {
-  GstTranscodingAudioProfile *ret = g_object_new (GST_TRANSCODING_TYPE_AUDIO_PROFILE, NULL);
-  GstTranscodingStreamProfilePrivate *priv =
-    gst_transcoding_stream_profile_get_instance_private ((GstTranscodingStreamProfile *) ret);
+  return g_object_new (GST_TRANSCODING_TYPE_AUDIO_PROFILE, NULL);
+}
 
-  priv->format = GST_TRANSCODING_FORMAT_NONE;
-  return ret;
+void
+gst_transcoding_video_profile_set_size (GstTranscodingVideoProfile *self, guint width, guint height)
+{
+  GstTranscodingStreamProfile *profile = (GstTranscodingStreamProfile *) self;
+  const GstTranscodingStreamSettings *settings = _gst_transcoding_stream_profile_get_settings (profile);
+
+  if (settings->width != width || settings->height != height) {
+    GstTranscodingStreamSettings *edited = _gst_transcoding_stream_profile_edit_settings (profile);
+
+    edited->width = width;
+    edited->height = height;
+  }
+}
+
+void
+gst_transcoding_video_profile_get_size (GstTranscodingVideoProfile *self, guint *width, guint *height)
+{
+  const GstTranscodingStreamSettings *settings =
+    _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) self);
+
+  if (width)
+    *width = settings->width;
+  if (height)
+    *height = settings->height;
+}
+
+void
+gst_transcoding_audio_profile_set_rate (GstTranscodingAudioProfile *self, guint rate)
+{
+  GstTranscodingStreamProfile *profile = (GstTranscodingStreamProfile *) self;
+
+  if (_gst_transcoding_stream_profile_get_settings (profile)->rate != rate)
+    _gst_transcoding_stream_profile_edit_settings (profile)->rate = rate;
+}
+
+guint
+gst_transcoding_audio_profile_get_rate (GstTranscodingAudioProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) self)->rate;
+}
+
+void
+gst_transcoding_audio_profile_set_channels (GstTranscodingAudioProfile *self, guint channels)
+{
+  GstTranscodingStreamProfile *profile = (GstTranscodingStreamProfile *) self;
+
+  if (_gst_transcoding_stream_profile_get_settings (profile)->channels != channels)
+    _gst_transcoding_stream_profile_edit_settings (profile)->channels = channels;
+}
+
+guint
+gst_transcoding_audio_profile_get_channels (GstTranscodingAudioProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) self)->channels;
+}
+
+void
+gst_transcoding_audio_profile_set_sample_format (GstTranscodingAudioProfile *self, const gchar *sample_format)
+{
+  GstTranscodingStreamProfile *profile = (GstTranscodingStreamProfile *) self;
+
+  sample_format = g_intern_string (sample_format);
+
+  if (_gst_transcoding_stream_profile_get_settings (profile)->sample_format != sample_format)
+    _gst_transcoding_stream_profile_edit_settings (profile)->sample_format = sample_format;
+}
+
+const gchar *
+gst_transcoding_audio_profile_get_sample_format (GstTranscodingAudioProfile *self)
+{
+  return _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) self)->sample_format;
 }
 
 GstTranscodingFormat
@@ -580,6 +1071,24 @@ gst_transcoding_input_get_uri (GstTranscodingInput *self)
   return g_strdup (self->uri);
 }
 
+void
+gst_transcoding_input_set_range (GstTranscodingInput *self, GstClockTime start, GstClockTime stop)
+{
+  g_return_if_fail (!GST_CLOCK_TIME_IS_VALID (start) || !GST_CLOCK_TIME_IS_VALID (stop) || start < stop);
+
+  self->start = start;
+  self->stop = stop;
+}
+
+void
+gst_transcoding_input_get_range (GstTranscodingInput *self, GstClockTime *start, GstClockTime *stop)
+{
+  if (start)
+    *start = self->start;
+  if (stop)
+    *stop = self->stop;
+}
+
 gchar *
 gst_transcoding_output_get_uri (GstTranscodingOutput *self)
 {
@@ -591,3 +1100,23 @@ gst_transcoding_output_get_profile (GstTranscodingOutput *self)
 {
   return g_object_ref (self->profile);
 }
+
+void
+gst_transcoding_output_set_sequence (GstTranscodingOutput *self, const gchar * const *in_uris)
+{
+  g_strfreev (self->sequence);
+  /* Empty sequences play nothing in sequence */
+  self->sequence = in_uris && in_uris[0] ? g_strdupv ((gchar **) in_uris) : NULL;
+}
+
+gchar **
+gst_transcoding_output_get_sequence (GstTranscodingOutput *self)
+{
+  return g_strdupv (self->sequence);
+}
+
+GstTranscodingCacheStatus
+gst_transcoding_output_get_cache_status (GstTranscodingOutput *self)
+{
+  return self->cache_status;
+}
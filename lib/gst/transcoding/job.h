@@ -1,6 +1,8 @@
 #pragma once
 
 #include <glib-object.h>
+#include <gio/gio.h>
+#include <gst/gst.h>
 
 G_BEGIN_DECLS
 
@@ -14,12 +16,59 @@ GstTranscodingFormat gst_transcoding_format_none_quark (void);
 #define GST_TRANSCODING_FORMAT_MATROSKA (gst_transcoding_format_matroska_quark())
 GstTranscodingFormat gst_transcoding_format_matroska_quark (void);
 
+/* MP4 (ISO base media) */
+#define GST_TRANSCODING_FORMAT_MP4 (gst_transcoding_format_mp4_quark())
+GstTranscodingFormat gst_transcoding_format_mp4_quark (void);
+
+#define GST_TRANSCODING_FORMAT_WEBM (gst_transcoding_format_webm_quark())
+GstTranscodingFormat gst_transcoding_format_webm_quark (void);
+
+/* MPEG transport stream */
+#define GST_TRANSCODING_FORMAT_MPEGTS (gst_transcoding_format_mpegts_quark())
+GstTranscodingFormat gst_transcoding_format_mpegts_quark (void);
+
 #define GST_TRANSCODING_FORMAT_H264 (gst_transcoding_format_h264_quark())
 GstTranscodingFormat gst_transcoding_format_h264_quark (void);
 
+#define GST_TRANSCODING_FORMAT_H265 (gst_transcoding_format_h265_quark())
+GstTranscodingFormat gst_transcoding_format_h265_quark (void);
+
+#define GST_TRANSCODING_FORMAT_VP8 (gst_transcoding_format_vp8_quark())
+GstTranscodingFormat gst_transcoding_format_vp8_quark (void);
+
+#define GST_TRANSCODING_FORMAT_VP9 (gst_transcoding_format_vp9_quark())
+GstTranscodingFormat gst_transcoding_format_vp9_quark (void);
+
+#define GST_TRANSCODING_FORMAT_AV1 (gst_transcoding_format_av1_quark())
+GstTranscodingFormat gst_transcoding_format_av1_quark (void);
+
 #define GST_TRANSCODING_FORMAT_AAC (gst_transcoding_format_aac_quark())
 GstTranscodingFormat gst_transcoding_format_aac_quark (void);
 
+/* MPEG-1 layer 3 */
+#define GST_TRANSCODING_FORMAT_MP3 (gst_transcoding_format_mp3_quark())
+GstTranscodingFormat gst_transcoding_format_mp3_quark (void);
+
+#define GST_TRANSCODING_FORMAT_OPUS (gst_transcoding_format_opus_quark())
+GstTranscodingFormat gst_transcoding_format_opus_quark (void);
+
+#define GST_TRANSCODING_FORMAT_VORBIS (gst_transcoding_format_vorbis_quark())
+GstTranscodingFormat gst_transcoding_format_vorbis_quark (void);
+
+#define GST_TRANSCODING_ERROR (gst_transcoding_error_quark())
+GQuark gst_transcoding_error_quark (void);
+
+typedef enum
+{
+  GST_TRANSCODING_ERROR_FAILED,
+  /* No element could be found to handle a format */
+  GST_TRANSCODING_ERROR_MISSING_ELEMENT,
+  /* The job describes something that can't be executed */
+  GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+  /* A serialized job is malformed */
+  GST_TRANSCODING_ERROR_PARSE,
+} GstTranscodingError;
+
 #define GST_TRANSCODING_TYPE_JOB gst_transcoding_job_get_type ()
 G_DECLARE_FINAL_TYPE(GstTranscodingJob, gst_transcoding_job, GST_TRANSCODING, JOB, GObject)
 
@@ -46,6 +95,9 @@ G_DECLARE_FINAL_TYPE(GstTranscodingInput, gst_transcoding_input, GST_TRANSCODING
 #define GST_TRANSCODING_TYPE_OUTPUT gst_transcoding_output_get_type ()
 G_DECLARE_FINAL_TYPE(GstTranscodingOutput, gst_transcoding_output, GST_TRANSCODING, OUTPUT, GObject)
 
+/* Inputs, outputs and stream mappings can be added to a job from several
+ * threads at once. Anything else, including running or serializing the job
+ * and modifying its profiles, must not happen at the same time. */
 GstTranscodingJob *gst_transcoding_job_new();
 
 GstTranscodingVideoProfile * gst_transcoding_job_map_video_stream (GstTranscodingJob *self,
@@ -58,6 +110,53 @@ GstTranscodingAudioProfile * gst_transcoding_job_map_audio_stream (GstTranscodin
                                                                    const gchar *stream_id,
                                                                    const gchar *out_uri);
 
+typedef enum
+{
+  GST_TRANSCODING_MEDIA_TYPE_AUDIO,
+  GST_TRANSCODING_MEDIA_TYPE_VIDEO,
+} GstTranscodingMediaType;
+
+typedef struct
+{
+  const gchar *in_uri;
+  const gchar *stream_id;
+  GstTranscodingMediaType media_type;
+  const gchar *out_uri;
+} GstTranscodingStreamMapping;
+
+/* Maps all of @mappings at once, as gst_transcoding_job_map_video_stream()
+ * and gst_transcoding_job_map_audio_stream() would, returning the profiles
+ * in the same order. Nothing is mapped if any stream would end up mapped as
+ * both audio and video, unless another thread maps it at the same time, in
+ * which case its profile is NULL. */
+GPtrArray * gst_transcoding_job_map_streams (GstTranscodingJob *self,
+                                             const GstTranscodingStreamMapping *mappings,
+                                             guint n_mappings,
+                                             GError **error);
+
+typedef struct
+{
+  const gchar *out_uri;
+  /* As gst_transcoding_video_profile_set_size() takes them */
+  guint width;
+  guint height;
+  /* Bits per second, 0 for the encoder default */
+  guint bitrate;
+} GstTranscodingLadderRung;
+
+/* Maps the video stream @stream_id of @in_uri to the output of each rung,
+ * scaled to the size of the rung, returning the profiles in the order of
+ * @rungs. Their other settings come from the meta video profiles of the
+ * outputs. The stream is decoded once, and each rung is scaled from the
+ * next larger one rather than from the source, except for a rung with a
+ * single dimension, its other one following the aspect ratio of the source. */
+GPtrArray * gst_transcoding_job_map_video_ladder (GstTranscodingJob *self,
+                                                  const gchar *in_uri,
+                                                  const gchar *stream_id,
+                                                  const GstTranscodingLadderRung *rungs,
+                                                  guint n_rungs,
+                                                  GError **error);
+
 GstTranscodingInput * gst_transcoding_job_add_input (GstTranscodingJob *self,
                                                      const gchar *uri);
 
@@ -73,6 +172,55 @@ GstTranscodingFormat gst_transcoding_stream_profile_get_format (GstTranscodingSt
 
 void gst_transcoding_stream_profile_set_format (GstTranscodingStreamProfile *self, GstTranscodingFormat format);
 
+/* Encoder settings of stream profiles. Each is mapped onto the properties
+ * of the encoders that have an equivalent, and ignored by the others. The
+ * defaults leave the encoder defaults alone. */
+
+typedef enum
+{
+  GST_TRANSCODING_RATE_CONTROL_DEFAULT,
+  GST_TRANSCODING_RATE_CONTROL_CBR,
+  GST_TRANSCODING_RATE_CONTROL_VBR,
+} GstTranscodingRateControl;
+
+/* Trades compression efficiency for encoding speed */
+typedef enum
+{
+  GST_TRANSCODING_SPEED_PRESET_DEFAULT,
+  GST_TRANSCODING_SPEED_PRESET_FASTEST,
+  GST_TRANSCODING_SPEED_PRESET_FAST,
+  GST_TRANSCODING_SPEED_PRESET_MEDIUM,
+  GST_TRANSCODING_SPEED_PRESET_SLOW,
+  GST_TRANSCODING_SPEED_PRESET_SLOWEST,
+} GstTranscodingSpeedPreset;
+
+/* In bits per second, 0 for the encoder default */
+guint gst_transcoding_stream_profile_get_bitrate (GstTranscodingStreamProfile *self);
+
+void gst_transcoding_stream_profile_set_bitrate (GstTranscodingStreamProfile *self, guint bitrate);
+
+GstTranscodingRateControl gst_transcoding_stream_profile_get_rate_control (GstTranscodingStreamProfile *self);
+
+void gst_transcoding_stream_profile_set_rate_control (GstTranscodingStreamProfile *self,
+                                                      GstTranscodingRateControl rate_control);
+
+GstTranscodingSpeedPreset gst_transcoding_stream_profile_get_speed_preset (GstTranscodingStreamProfile *self);
+
+void gst_transcoding_stream_profile_set_speed_preset (GstTranscodingStreamProfile *self,
+                                                      GstTranscodingSpeedPreset speed_preset);
+
+/* Encoder specific, "zerolatency" or "fastdecode+zerolatency" for x264enc,
+ * "ssim" for vp8enc for instance. NULL (the default) for none. */
+const gchar * gst_transcoding_stream_profile_get_tune (GstTranscodingStreamProfile *self);
+
+void gst_transcoding_stream_profile_set_tune (GstTranscodingStreamProfile *self, const gchar *tune);
+
+/* Encoder threads, 0 (the default) for what the scheduler picked for the
+ * job, or the encoder default outside of a scheduler */
+guint gst_transcoding_stream_profile_get_threads (GstTranscodingStreamProfile *self);
+
+void gst_transcoding_stream_profile_set_threads (GstTranscodingStreamProfile *self, guint n_threads);
+
 GstTranscodingFormat gst_transcoding_container_profile_get_format (GstTranscodingContainerProfile *self);
 
 void gst_transcoding_container_profile_set_format (GstTranscodingContainerProfile *self, GstTranscodingFormat format);
@@ -86,14 +234,177 @@ GstTranscodingContainerProfile * gst_transcoding_container_profile_new (GstTrans
 
 gchar * gst_transcoding_input_get_uri (GstTranscodingInput *self);
 
+/* Only transcodes the input from @start to @stop, GST_CLOCK_TIME_NONE
+ * leaving that end unbounded. The input is seeked to the keyframe before
+ * @start, decoded streams are then trimmed to the exact range, while
+ * passthrough streams start on that keyframe. */
+void gst_transcoding_input_set_range (GstTranscodingInput *self, GstClockTime start, GstClockTime stop);
+
+void gst_transcoding_input_get_range (GstTranscodingInput *self, GstClockTime *start, GstClockTime *stop);
+
 gchar * gst_transcoding_output_get_uri (GstTranscodingOutput *self);
 
 GstTranscodingContainerProfile * gst_transcoding_output_get_profile (GstTranscodingOutput *self);
 
+/* Plays the inputs @in_uris one after the other in @self, in that order,
+ * rather than together. They must all map the same audio and video
+ * streams, in number and kind, to @self. Streams already in the format of
+ * their profile, with the same parameters in all the inputs, are copied,
+ * the others are re-encoded. NULL (the default) plays the inputs
+ * together. */
+void gst_transcoding_output_set_sequence (GstTranscodingOutput *self, const gchar * const *in_uris);
+
+gchar ** gst_transcoding_output_get_sequence (GstTranscodingOutput *self);
+
+typedef enum
+{
+  /* The output cache wasn't consulted for this output, because it is
+   * disabled, or the output can't be cached */
+  GST_TRANSCODING_CACHE_STATUS_NONE,
+  /* The output was transcoded, then added to the cache */
+  GST_TRANSCODING_CACHE_STATUS_MISS,
+  /* The output was copied from the cache */
+  GST_TRANSCODING_CACHE_STATUS_HIT,
+} GstTranscodingCacheStatus;
+
+/* How the output cache served @self during the last run of its job */
+GstTranscodingCacheStatus gst_transcoding_output_get_cache_status (GstTranscodingOutput *self);
+
 GstTranscodingVideoProfile * gst_transcoding_video_profile_new (void);
 
 GstTranscodingAudioProfile * gst_transcoding_audio_profile_new (void);
 
+/* Size the stream is scaled to. With a dimension at 0, it follows the
+ * other one so that the display aspect ratio is kept. Both at 0 (the
+ * default) keeps the size of the source. */
+void gst_transcoding_video_profile_set_size (GstTranscodingVideoProfile *self, guint width, guint height);
+
+void gst_transcoding_video_profile_get_size (GstTranscodingVideoProfile *self, guint *width, guint *height);
+
+/* Raw format the stream is converted to before encoding, 0 or NULL (the
+ * default) keeping that of the source. The sample format is named as in
+ * audio/x-raw caps, "S16LE" for instance. */
+void gst_transcoding_audio_profile_set_rate (GstTranscodingAudioProfile *self, guint rate);
+
+guint gst_transcoding_audio_profile_get_rate (GstTranscodingAudioProfile *self);
+
+void gst_transcoding_audio_profile_set_channels (GstTranscodingAudioProfile *self, guint channels);
+
+guint gst_transcoding_audio_profile_get_channels (GstTranscodingAudioProfile *self);
+
+void gst_transcoding_audio_profile_set_sample_format (GstTranscodingAudioProfile *self, const gchar *sample_format);
+
+const gchar * gst_transcoding_audio_profile_get_sample_format (GstTranscodingAudioProfile *self);
+
 gchar *gst_transcoding_job_to_json (GstTranscodingJob *self, gboolean pretty);
 
+/* Serializes the job to @stream as it walks it, without building the whole
+ * document in memory first */
+gboolean gst_transcoding_job_write_json (GstTranscodingJob *self,
+                                         GOutputStream *stream,
+                                         gboolean pretty,
+                                         GCancellable *cancellable,
+                                         GError **error);
+
+/* Parses a job as serialized by gst_transcoding_job_to_json(), building it
+ * while reading. Within each input and stream, the uri, stream-id and
+ * media-type members must come before the streams and profiles, as they do
+ * in serialized jobs. */
+GstTranscodingJob * gst_transcoding_job_from_json (const gchar *json, GError **error);
+
+/* Same as gst_transcoding_job_from_json(), reading @stream a chunk at a
+ * time */
+GstTranscodingJob * gst_transcoding_job_from_json_stream (GInputStream *stream,
+                                                          GCancellable *cancellable,
+                                                          GError **error);
+
+/* Serializes the job in a versioned binary format, faster to load than JSON
+ * and holding the same information */
+GBytes * gst_transcoding_job_to_bytes (GstTranscodingJob *self);
+
+/* Rebuilds a job from the output of gst_transcoding_job_to_bytes(), reading
+ * strings in place */
+GstTranscodingJob * gst_transcoding_job_from_bytes (GBytes *bytes, GError **error);
+
+/* Same as gst_transcoding_job_from_bytes(), mapping the file at @path
+ * instead of reading it */
+GstTranscodingJob * gst_transcoding_job_from_file (const gchar *path, GError **error);
+
+/* Maps each audio and video stream of the auto-link inputs of the job to
+ * every auto-link output, with a copy of the output's meta profile. Inputs
+ * are probed concurrently, at most @max_probes (0 for one per processor) at
+ * a time, and only parsed, never decoded. Streams already mapped to an
+ * output are left alone. gst_init() must have been called. */
+gboolean gst_transcoding_job_auto_link (GstTranscodingJob *self,
+                                        guint max_probes,
+                                        GCancellable *cancellable,
+                                        GError **error);
+
+/* Splits the input of the job in keyframe-aligned chunks of at least
+ * @duration, transcodes them concurrently and stitches the results back
+ * together in each output. Encoded audio isn't split, it is transcoded in
+ * one go along the chunks. Only honoured for jobs with a single input,
+ * GST_CLOCK_TIME_NONE (the default) disables it. */
+void gst_transcoding_job_set_segment_duration (GstTranscodingJob *self, GstClockTime duration);
+
+/* Only re-encodes the GOPs of the first mapped video stream containing the
+ * start and the stop of the range of the input, copying the video of the
+ * GOPs in between, which are then concatenated in each output. The video
+ * profiles must produce streams the copied ones can follow: same codec,
+ * size and parameters as the source, in closed GOPs. Only honoured for jobs
+ * with a single input, takes precedence over segment-parallel transcoding.
+ * Disabled by default. */
+void gst_transcoding_job_set_smart_render (GstTranscodingJob *self, gboolean smart_render);
+
+/* Maximum number of chunks transcoded at the same time, 0 (the default)
+ * means one per processor */
+void gst_transcoding_job_set_max_workers (GstTranscodingJob *self, guint max_workers);
+
+/* Transcodes the chunks of segment-parallel jobs in separate processes
+ * running @path, which must call gst_transcoding_worker_main(), instead of
+ * in threads. A chunk whose worker crashes is retried in a new worker.
+ * NULL (the default) disables it. */
+void gst_transcoding_job_set_worker_executable (GstTranscodingJob *self, const gchar *path);
+
+/* Keeps what probing and scanning inputs found out about them in @dir,
+ * created if needed, to skip doing it again as long as their size and
+ * modification time don't change. Only inputs GIO can query (local files)
+ * are cached. NULL (the default) disables it. */
+void gst_transcoding_job_set_discovery_cache (GstTranscodingJob *self, const gchar *dir);
+
+/* Keeps the outputs of the job in @dir, created if needed, under a checksum
+ * of the content of the inputs and of the settings they were made with.
+ * Outputs found in it aren't transcoded again but copied from it. Only
+ * whole outputs to local files are cached. NULL (the default) disables
+ * it. */
+void gst_transcoding_job_set_output_cache (GstTranscodingJob *self, const gchar *dir);
+
+/* Serves chunk tasks from a coordinator over the Unix domain socket @fd,
+ * until the coordinator closes it */
+gboolean gst_transcoding_worker_main (gint fd, GError **error);
+
+/* Keeps the pipelines of up to @n_pipelines finished jobs, in READY, to run
+ * later jobs with the same topology (URI schemes, container and stream
+ * formats, streams mapped) without building a pipeline again. Their
+ * elements aren't released until they are reused or evicted by lowering
+ * the limit. Process-wide, 0 (the default) disables it. */
+void gst_transcoding_set_max_idle_pipelines (guint n_pipelines);
+
+/* Builds a single pipeline for the job, in which each mapped input stream
+ * is demuxed and decoded once, then teed to all of its profiles. Streams
+ * whose profiles are all passthrough are not decoded at all.
+ * gst_init() must have been called. */
+gboolean gst_transcoding_job_run (GstTranscodingJob *self,
+                                  GCancellable *cancellable,
+                                  GError **error);
+
+void gst_transcoding_job_run_async (GstTranscodingJob *self,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+
+gboolean gst_transcoding_job_run_finish (GstTranscodingJob *self,
+                                         GAsyncResult *result,
+                                         GError **error);
+
 G_END_DECLS
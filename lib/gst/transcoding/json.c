@@ -0,0 +1,1156 @@
+#include <string.h>
+#include "job-private.h"
+
+/* Size above which the serialized JSON is handed to the output stream */
+#define WRITER_FLUSH_SIZE (64 * 1024)
+
+/* Writes JSON as the job is walked, only ever holding a chunk of it in
+ * memory. The layout matches the one of json-glib's generator. */
+typedef struct
+{
+  GOutputStream *stream;
+  GCancellable *cancellable;
+  GString *buffer;
+  gboolean pretty;
+  guint depth;
+  /* Nothing was written yet in the current object or array */
+  gboolean first;
+  /* A member name was written, its value is next */
+  gboolean in_member;
+  GError *error;
+} JsonWriter;
+
+static void
+writer_flush (JsonWriter *w)
+{
+  if (!w->error && w->buffer->len)
+    g_output_stream_write_all (w->stream, w->buffer->str, w->buffer->len, NULL, w->cancellable, &w->error);
+
+  g_string_truncate (w->buffer, 0);
+}
+
+static void
+writer_prepare_value (JsonWriter *w)
+{
+  if (w->in_member) {
+    w->in_member = FALSE;
+    return;
+  }
+
+  if (w->depth > 0) {
+    if (!w->first)
+      g_string_append_c (w->buffer, ',');
+
+    if (w->pretty) {
+      g_string_append_c (w->buffer, '\n');
+      g_string_append_printf (w->buffer, "%*s", w->depth * 2, "");
+    }
+  }
+
+  w->first = FALSE;
+}
+
+static void
+writer_append_escaped (JsonWriter *w, const gchar *str)
+{
+  const gchar *p;
+
+  g_string_append_c (w->buffer, '"');
+
+  for (p = str; *p; p++) {
+    switch (*p) {
+      case '"':
+        g_string_append (w->buffer, "\\\"");
+        break;
+      case '\\':
+        g_string_append (w->buffer, "\\\\");
+        break;
+      case '\b':
+        g_string_append (w->buffer, "\\b");
+        break;
+      case '\f':
+        g_string_append (w->buffer, "\\f");
+        break;
+      case '\n':
+        g_string_append (w->buffer, "\\n");
+        break;
+      case '\r':
+        g_string_append (w->buffer, "\\r");
+        break;
+      case '\t':
+        g_string_append (w->buffer, "\\t");
+        break;
+      default:
+        if ((guchar) *p < 0x20)
+          g_string_append_printf (w->buffer, "\\u%04x", (guchar) *p);
+        else
+          g_string_append_c (w->buffer, *p);
+        break;
+    }
+  }
+
+  g_string_append_c (w->buffer, '"');
+}
+
+static void
+writer_begin (JsonWriter *w, gchar c)
+{
+  writer_prepare_value (w);
+  g_string_append_c (w->buffer, c);
+  w->depth++;
+  w->first = TRUE;
+}
+
+static void
+writer_end (JsonWriter *w, gchar c)
+{
+  w->depth--;
+
+  if (w->pretty) {
+    g_string_append_c (w->buffer, '\n');
+    g_string_append_printf (w->buffer, "%*s", w->depth * 2, "");
+  }
+
+  g_string_append_c (w->buffer, c);
+  w->first = FALSE;
+
+  if (w->buffer->len >= WRITER_FLUSH_SIZE)
+    writer_flush (w);
+}
+
+static void
+writer_member (JsonWriter *w, const gchar *name)
+{
+  writer_prepare_value (w);
+  writer_append_escaped (w, name);
+  g_string_append (w->buffer, w->pretty ? " : " : ":");
+  w->in_member = TRUE;
+}
+
+static void
+writer_string (JsonWriter *w, const gchar *value)
+{
+  writer_prepare_value (w);
+  writer_append_escaped (w, value);
+}
+
+static void
+writer_boolean (JsonWriter *w, gboolean value)
+{
+  writer_prepare_value (w);
+  g_string_append (w->buffer, value ? "true" : "false");
+}
+
+static void
+writer_uint (JsonWriter *w, guint64 value)
+{
+  writer_prepare_value (w);
+  g_string_append_printf (w->buffer, "%" G_GUINT64_FORMAT, value);
+}
+
+static void
+audio_profile_to_json (GstTranscodingAudioProfile *profile, JsonWriter *w)
+{
+  const GstTranscodingStreamSettings *settings =
+    _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) profile);
+
+  if (settings->rate) {
+    writer_member (w, "rate");
+    writer_uint (w, settings->rate);
+  }
+
+  if (settings->channels) {
+    writer_member (w, "channels");
+    writer_uint (w, settings->channels);
+  }
+
+  if (settings->sample_format) {
+    writer_member (w, "sample-format");
+    writer_string (w, settings->sample_format);
+  }
+}
+
+static void
+video_profile_to_json (GstTranscodingVideoProfile *profile, JsonWriter *w)
+{
+  const GstTranscodingStreamSettings *settings =
+    _gst_transcoding_stream_profile_get_settings ((GstTranscodingStreamProfile *) profile);
+
+  if (settings->width) {
+    writer_member (w, "width");
+    writer_uint (w, settings->width);
+  }
+
+  if (settings->height) {
+    writer_member (w, "height");
+    writer_uint (w, settings->height);
+  }
+}
+
+static void
+profile_to_json (GstTranscodingStreamProfile *profile, JsonWriter *w)
+{
+  GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+  const GstTranscodingStreamSettings *settings = priv->settings;
+
+  writer_begin (w, '{');
+  writer_member (w, "format");
+  writer_string (w, g_quark_to_string (settings->format));
+
+  /* Settings left at their default are omitted */
+  if (settings->bitrate) {
+    writer_member (w, "bitrate");
+    writer_uint (w, settings->bitrate);
+  }
+
+  if (settings->rate_control) {
+    writer_member (w, "rate-control");
+    writer_string (w, _gst_transcoding_rate_control_to_string (settings->rate_control));
+  }
+
+  if (settings->speed_preset) {
+    writer_member (w, "speed-preset");
+    writer_string (w, _gst_transcoding_speed_preset_to_string (settings->speed_preset));
+  }
+
+  if (settings->tune) {
+    writer_member (w, "tune");
+    writer_string (w, settings->tune);
+  }
+
+  if (settings->threads) {
+    writer_member (w, "threads");
+    writer_uint (w, settings->threads);
+  }
+
+  if (GST_TRANSCODING_IS_AUDIO_PROFILE (profile)) {
+    audio_profile_to_json ((GstTranscodingAudioProfile *) profile, w);
+  } else {
+    video_profile_to_json ((GstTranscodingVideoProfile *) profile, w);
+  }
+
+  if (priv->output) {
+    writer_member (w, "output");
+    writer_string (w, priv->output->uri);
+  }
+
+  writer_end (w, '}');
+}
+
+static void
+container_profile_to_json (GstTranscodingContainerProfile *profile, JsonWriter *w)
+{
+  writer_begin (w, '{');
+  writer_member (w, "format");
+  writer_string (w, g_quark_to_string (profile->format));
+  writer_member (w, "meta-audio-profile");
+  profile_to_json ((GstTranscodingStreamProfile *) profile->meta_audio_profile, w);
+  writer_member (w, "meta-video-profile");
+  profile_to_json ((GstTranscodingStreamProfile *) profile->meta_video_profile, w);
+  writer_end (w, '}');
+}
+
+static void
+output_to_json (gchar *uri, GstTranscodingOutput *output, JsonWriter *w)
+{
+  writer_begin (w, '{');
+  writer_member (w, "uri");
+  writer_string (w, uri);
+  writer_member (w, "autolink");
+  writer_boolean (w, output->auto_link);
+  writer_member (w, "container-profile");
+  container_profile_to_json (output->profile, w);
+
+  if (output->sequence) {
+    guint i;
+
+    writer_member (w, "sequence");
+    writer_begin (w, '[');
+    for (i = 0; output->sequence[i]; i++)
+      writer_string (w, output->sequence[i]);
+    writer_end (w, ']');
+  }
+
+  writer_end (w, '}');
+}
+
+static void
+streams_to_json (gchar *stream_id, GPtrArray *profiles, JsonWriter *w)
+{
+  GstTranscodingStreamProfile *first_profile;
+
+  writer_begin (w, '{');
+  writer_member (w, "stream-id");
+  writer_string (w, stream_id);
+  first_profile = g_ptr_array_index (profiles, 0);
+  writer_member (w, "media-type");
+  if (GST_TRANSCODING_IS_AUDIO_PROFILE (first_profile))
+    writer_string (w, "audio");
+  else
+    writer_string (w, "video");
+  writer_member (w, "profiles");
+  writer_begin (w, '[');
+  g_ptr_array_foreach (profiles, (GFunc) profile_to_json, w);
+  writer_end (w, ']');
+  writer_end (w, '}');
+}
+
+static void
+input_to_json (gchar *uri, GstTranscodingInput *input, JsonWriter *w)
+{
+  writer_begin (w, '{');
+  writer_member (w, "uri");
+  writer_string (w, uri);
+  writer_member (w, "autolink");
+  writer_boolean (w, input->auto_link);
+
+  if (GST_CLOCK_TIME_IS_VALID (input->start)) {
+    writer_member (w, "start");
+    writer_uint (w, input->start);
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (input->stop)) {
+    writer_member (w, "stop");
+    writer_uint (w, input->stop);
+  }
+
+  writer_member (w, "streams");
+  writer_begin (w, '[');
+  g_hash_table_foreach (input->profiles, (GHFunc) streams_to_json, w);
+  writer_end (w, ']');
+  writer_end (w, '}');
+}
+
+gboolean
+gst_transcoding_job_write_json (GstTranscodingJob *self,
+                                GOutputStream *stream,
+                                gboolean pretty,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+  JsonWriter w = { 0, };
+
+  w.stream = stream;
+  w.cancellable = cancellable;
+  w.buffer = g_string_sized_new (WRITER_FLUSH_SIZE);
+  w.pretty = pretty;
+
+  writer_begin (&w, '{');
+
+  writer_member (&w, "outputs");
+  writer_begin (&w, '[');
+  g_hash_table_foreach (self->outputs, (GHFunc) output_to_json, &w);
+  writer_end (&w, ']');
+
+  writer_member (&w, "inputs");
+  writer_begin (&w, '[');
+  g_hash_table_foreach (self->inputs, (GHFunc) input_to_json, &w);
+  writer_end (&w, ']');
+
+  writer_end (&w, '}');
+  writer_flush (&w);
+
+  g_string_free (w.buffer, TRUE);
+
+  if (w.error) {
+    g_propagate_error (error, w.error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+gchar *
+gst_transcoding_job_to_json (GstTranscodingJob *self, gboolean pretty)
+{
+  GOutputStream *stream = g_memory_output_stream_new_resizable ();
+  gchar *ret = NULL;
+
+  if (gst_transcoding_job_write_json (self, stream, pretty, NULL, NULL) &&
+      g_output_stream_write_all (stream, "", 1, NULL, NULL, NULL) &&
+      g_output_stream_close (stream, NULL, NULL))
+    ret = g_memory_output_stream_steal_data (G_MEMORY_OUTPUT_STREAM (stream));
+
+  g_object_unref (stream);
+
+  return ret;
+}
+
+/* Size of the chunks read from input streams */
+#define READER_CHUNK_SIZE (64 * 1024)
+/* Unknown values nested deeper than this are rejected rather than skipped,
+ * skipping recurses */
+#define READER_MAX_DEPTH 64
+
+/* Pull parser building the job as it goes, without a document tree. Parses
+ * strings in place, and input streams a chunk at a time. */
+typedef struct
+{
+  GInputStream *stream;
+  GCancellable *cancellable;
+  const gchar *data;
+  gsize pos;
+  gsize len;
+  gchar *chunk;
+  /* Last string read, valid until the next one is */
+  GString *string;
+  guint line;
+  /* Nesting of the unknown value being skipped */
+  guint depth;
+  GError *error;
+} JsonReader;
+
+static void reader_fail (JsonReader *r, const gchar *format, ...) G_GNUC_PRINTF (2, 3);
+
+static void
+reader_fail (JsonReader *r, const gchar *format, ...)
+{
+  va_list args;
+  gchar *message;
+
+  if (r->error)
+    return;
+
+  va_start (args, format);
+  message = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  g_set_error (&r->error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE, "Line %u: %s", r->line, message);
+  g_free (message);
+}
+
+static gboolean
+reader_fill (JsonReader *r)
+{
+  gssize n;
+
+  /* Stop parsing at the first error */
+  if (r->error)
+    return FALSE;
+
+  if (r->pos < r->len)
+    return TRUE;
+
+  if (!r->stream)
+    return FALSE;
+
+  n = g_input_stream_read (r->stream, r->chunk, READER_CHUNK_SIZE, r->cancellable, &r->error);
+  if (n <= 0)
+    return FALSE;
+
+  r->data = r->chunk;
+  r->pos = 0;
+  r->len = n;
+
+  return TRUE;
+}
+
+/* Skips whitespace, returns the next character without consuming it, or -1
+ * at the end of the data */
+static gint
+reader_peek (JsonReader *r)
+{
+  while (reader_fill (r)) {
+    gchar c = r->data[r->pos];
+
+    if (c == '\n')
+      r->line++;
+    else if (c != ' ' && c != '\t' && c != '\r')
+      return (guchar) c;
+
+    r->pos++;
+  }
+
+  return -1;
+}
+
+static gboolean
+reader_expect (JsonReader *r, gchar c)
+{
+  if (reader_peek (r) != c) {
+    reader_fail (r, "Expected '%c'", c);
+    return FALSE;
+  }
+
+  r->pos++;
+
+  return TRUE;
+}
+
+static gboolean
+reader_literal (JsonReader *r, const gchar *literal)
+{
+  const gchar *p;
+
+  for (p = literal; *p; p++) {
+    if (!reader_fill (r) || r->data[r->pos] != *p) {
+      reader_fail (r, "Expected '%s'", literal);
+      return FALSE;
+    }
+
+    r->pos++;
+  }
+
+  return TRUE;
+}
+
+static gint
+reader_hex4 (JsonReader *r)
+{
+  gint ret = 0;
+  guint i;
+
+  for (i = 0; i < 4; i++) {
+    gint digit;
+
+    if (!reader_fill (r) || (digit = g_ascii_xdigit_value (r->data[r->pos])) < 0) {
+      reader_fail (r, "Invalid unicode escape");
+      return -1;
+    }
+
+    ret = (ret << 4) | digit;
+    r->pos++;
+  }
+
+  return ret;
+}
+
+static gboolean
+reader_unicode_escape (JsonReader *r)
+{
+  gint c = reader_hex4 (r);
+
+  if (c < 0)
+    return FALSE;
+
+  if (c >= 0xd800 && c < 0xdc00) {
+    gint low;
+
+    if (!reader_literal (r, "\\u") || (low = reader_hex4 (r)) < 0)
+      return FALSE;
+
+    if (low < 0xdc00 || low >= 0xe000) {
+      reader_fail (r, "Invalid surrogate pair");
+      return FALSE;
+    }
+
+    c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+  } else if (c >= 0xdc00 && c < 0xe000) {
+    reader_fail (r, "Unpaired low surrogate");
+    return FALSE;
+  }
+
+  g_string_append_unichar (r->string, c);
+
+  return TRUE;
+}
+
+static const gchar *
+reader_string (JsonReader *r)
+{
+  if (!reader_expect (r, '"'))
+    return NULL;
+
+  g_string_truncate (r->string, 0);
+
+  while (reader_fill (r)) {
+    const gchar *start = r->data + r->pos;
+    const gchar *end = r->data + r->len;
+    const gchar *p = start;
+    gchar c;
+
+    while (p < end && *p != '"' && *p != '\\' && (guchar) *p >= 0x20)
+      p++;
+
+    g_string_append_len (r->string, start, p - start);
+    r->pos += p - start;
+
+    if (p == end)
+      continue;
+
+    c = *p;
+    r->pos++;
+
+    if (c == '"')
+      return r->string->str;
+
+    if (c != '\\') {
+      reader_fail (r, "Control character in string");
+      return NULL;
+    }
+
+    if (!reader_fill (r))
+      break;
+
+    c = r->data[r->pos++];
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        g_string_append_c (r->string, c);
+        break;
+      case 'b':
+        g_string_append_c (r->string, '\b');
+        break;
+      case 'f':
+        g_string_append_c (r->string, '\f');
+        break;
+      case 'n':
+        g_string_append_c (r->string, '\n');
+        break;
+      case 'r':
+        g_string_append_c (r->string, '\r');
+        break;
+      case 't':
+        g_string_append_c (r->string, '\t');
+        break;
+      case 'u':
+        if (!reader_unicode_escape (r))
+          return NULL;
+        break;
+      default:
+        reader_fail (r, "Invalid escape '\\%c'", c);
+        return NULL;
+    }
+  }
+
+  reader_fail (r, "Unterminated string");
+
+  return NULL;
+}
+
+static gboolean
+reader_boolean (JsonReader *r, gboolean *value)
+{
+  switch (reader_peek (r)) {
+    case 't':
+      *value = TRUE;
+      return reader_literal (r, "true");
+    case 'f':
+      *value = FALSE;
+      return reader_literal (r, "false");
+    default:
+      reader_fail (r, "Expected a boolean");
+      return FALSE;
+  }
+}
+
+static gboolean
+reader_uint (JsonReader *r, guint64 max, guint64 *value)
+{
+  gboolean any = FALSE;
+
+  *value = 0;
+
+  if (reader_peek (r) < 0) {
+    reader_fail (r, "Expected a number");
+    return FALSE;
+  }
+
+  while (reader_fill (r) && g_ascii_isdigit (r->data[r->pos])) {
+    guint digit = r->data[r->pos] - '0';
+
+    if (*value > (max - digit) / 10) {
+      reader_fail (r, "Number out of range");
+      return FALSE;
+    }
+
+    *value = *value * 10 + digit;
+    any = TRUE;
+    r->pos++;
+  }
+
+  if (!any)
+    reader_fail (r, "Expected a positive integer");
+
+  return r->error == NULL;
+}
+
+/* Returns the name of the next member of the current object, or NULL once
+ * it is closed or on error */
+static const gchar *
+reader_object_next (JsonReader *r, gboolean *first)
+{
+  const gchar *name;
+
+  if (reader_peek (r) == '}') {
+    r->pos++;
+    return NULL;
+  }
+
+  if (!*first && !reader_expect (r, ','))
+    return NULL;
+
+  *first = FALSE;
+
+  name = reader_string (r);
+  if (!name || !reader_expect (r, ':'))
+    return NULL;
+
+  return name;
+}
+
+/* Returns whether the current array has another element */
+static gboolean
+reader_array_next (JsonReader *r, gboolean *first)
+{
+  if (reader_peek (r) == ']') {
+    r->pos++;
+    return FALSE;
+  }
+
+  if (!*first && !reader_expect (r, ','))
+    return FALSE;
+
+  *first = FALSE;
+
+  return TRUE;
+}
+
+/* Skips members we don't know about, for forward compatibility */
+static gboolean
+reader_skip_value (JsonReader *r)
+{
+  gboolean first = TRUE;
+  gint c = reader_peek (r);
+
+  if ((c == '{' || c == '[') && r->depth == READER_MAX_DEPTH) {
+    reader_fail (r, "Values nested too deeply");
+    return FALSE;
+  }
+
+  switch (c) {
+    case '{':
+      r->pos++;
+      r->depth++;
+      while (reader_object_next (r, &first))
+        reader_skip_value (r);
+      r->depth--;
+      break;
+    case '[':
+      r->pos++;
+      r->depth++;
+      while (reader_array_next (r, &first))
+        reader_skip_value (r);
+      r->depth--;
+      break;
+    case '"':
+      reader_string (r);
+      break;
+    case 't':
+      reader_literal (r, "true");
+      break;
+    case 'f':
+      reader_literal (r, "false");
+      break;
+    case 'n':
+      reader_literal (r, "null");
+      break;
+    default:
+      if (c != '-' && !g_ascii_isdigit (c)) {
+        reader_fail (r, "Unexpected character");
+        break;
+      }
+
+      while (reader_fill (r) && r->data[r->pos] && strchr ("0123456789+-.eE", r->data[r->pos]))
+        r->pos++;
+      break;
+  }
+
+  return r->error == NULL;
+}
+
+/* Reads a stream profile, @output may be NULL for meta profiles */
+static gboolean
+reader_profile (JsonReader *r, GstTranscodingStreamSettings *settings, gchar **output)
+{
+  gboolean first = TRUE;
+  const gchar *name;
+  guint64 value;
+
+  _gst_transcoding_stream_settings_init (settings);
+
+  if (!reader_expect (r, '{'))
+    return FALSE;
+
+  while ((name = reader_object_next (r, &first))) {
+    if (!strcmp (name, "format")) {
+      const gchar *str = reader_string (r);
+
+      if (str)
+        settings->format = g_quark_from_string (str);
+    } else if (!strcmp (name, "bitrate")) {
+      if (reader_uint (r, G_MAXUINT, &value))
+        settings->bitrate = value;
+    } else if (!strcmp (name, "rate-control")) {
+      const gchar *str = reader_string (r);
+
+      if (str && !_gst_transcoding_rate_control_from_string (str, &settings->rate_control))
+        reader_fail (r, "Unknown rate control %s", str);
+    } else if (!strcmp (name, "speed-preset")) {
+      const gchar *str = reader_string (r);
+
+      if (str && !_gst_transcoding_speed_preset_from_string (str, &settings->speed_preset))
+        reader_fail (r, "Unknown speed preset %s", str);
+    } else if (!strcmp (name, "tune")) {
+      const gchar *str = reader_string (r);
+
+      if (str)
+        settings->tune = g_intern_string (str);
+    } else if (!strcmp (name, "threads")) {
+      if (reader_uint (r, G_MAXUINT, &value))
+        settings->threads = value;
+    } else if (!strcmp (name, "width")) {
+      if (reader_uint (r, G_MAXINT, &value))
+        settings->width = value;
+    } else if (!strcmp (name, "height")) {
+      if (reader_uint (r, G_MAXINT, &value))
+        settings->height = value;
+    } else if (!strcmp (name, "rate")) {
+      if (reader_uint (r, G_MAXINT, &value))
+        settings->rate = value;
+    } else if (!strcmp (name, "channels")) {
+      if (reader_uint (r, G_MAXINT, &value))
+        settings->channels = value;
+    } else if (!strcmp (name, "sample-format")) {
+      const gchar *str = reader_string (r);
+
+      if (str)
+        settings->sample_format = g_intern_string (str);
+    } else if (output && !strcmp (name, "output")) {
+      const gchar *str = reader_string (r);
+
+      g_free (*output);
+      *output = g_strdup (str);
+    } else {
+      reader_skip_value (r);
+    }
+  }
+
+  return r->error == NULL;
+}
+
+static GstTranscodingContainerProfile *
+reader_container_profile (JsonReader *r)
+{
+  GstTranscodingContainerProfile *ret = gst_transcoding_container_profile_new (NULL, NULL);
+  gboolean first = TRUE;
+  const gchar *name;
+
+  if (reader_expect (r, '{')) {
+    while ((name = reader_object_next (r, &first))) {
+      GstTranscodingStreamSettings settings;
+
+      if (!strcmp (name, "format")) {
+        const gchar *value = reader_string (r);
+
+        if (value)
+          ret->format = g_quark_from_string (value);
+      } else if (!strcmp (name, "meta-audio-profile")) {
+        if (reader_profile (r, &settings, NULL))
+          _gst_transcoding_stream_profile_set_settings ((GstTranscodingStreamProfile *) ret->meta_audio_profile, &settings);
+      } else if (!strcmp (name, "meta-video-profile")) {
+        if (reader_profile (r, &settings, NULL))
+          _gst_transcoding_stream_profile_set_settings ((GstTranscodingStreamProfile *) ret->meta_video_profile, &settings);
+      } else {
+        reader_skip_value (r);
+      }
+    }
+  }
+
+  if (r->error)
+    g_clear_object (&ret);
+
+  return ret;
+}
+
+static void
+reader_output (JsonReader *r, GstTranscodingJob *job)
+{
+  GstTranscodingContainerProfile *profile = NULL;
+  GstTranscodingOutput *output;
+  GPtrArray *sequence = NULL;
+  gboolean auto_link = FALSE;
+  gboolean first = TRUE;
+  gchar *uri = NULL;
+  const gchar *name;
+
+  if (!reader_expect (r, '{'))
+    return;
+
+  while ((name = reader_object_next (r, &first))) {
+    if (!strcmp (name, "uri")) {
+      const gchar *value = reader_string (r);
+
+      g_free (uri);
+      uri = g_strdup (value);
+    } else if (!strcmp (name, "autolink")) {
+      reader_boolean (r, &auto_link);
+    } else if (!strcmp (name, "container-profile")) {
+      g_clear_object (&profile);
+      profile = reader_container_profile (r);
+    } else if (!strcmp (name, "sequence") && reader_expect (r, '[')) {
+      gboolean first_uri = TRUE;
+      const gchar *value;
+
+      if (sequence)
+        g_ptr_array_unref (sequence);
+      sequence = g_ptr_array_new_with_free_func (g_free);
+
+      while (reader_array_next (r, &first_uri) && (value = reader_string (r)))
+        g_ptr_array_add (sequence, g_strdup (value));
+    } else {
+      reader_skip_value (r);
+    }
+  }
+
+  if (r->error)
+    goto done;
+
+  if (!uri) {
+    reader_fail (r, "Output without a uri");
+    goto done;
+  }
+
+  /* Takes ownership of the profile */
+  output = gst_transcoding_job_add_output (job, uri, profile);
+  if (!output) {
+    reader_fail (r, "Duplicate output %s", uri);
+    goto done;
+  }
+
+  profile = NULL;
+  output->auto_link = auto_link;
+
+  if (sequence) {
+    g_ptr_array_add (sequence, NULL);
+    gst_transcoding_output_set_sequence (output, (const gchar * const *) sequence->pdata);
+  }
+
+  g_object_unref (output);
+
+done:
+  if (sequence)
+    g_ptr_array_unref (sequence);
+  g_clear_object (&profile);
+  g_free (uri);
+}
+
+static void
+reader_stream (JsonReader *r, GstTranscodingJob *job, const gchar *in_uri)
+{
+  MediaType media_type = VIDEO;
+  gboolean has_media_type = FALSE;
+  gboolean first = TRUE;
+  gchar *stream_id = NULL;
+  const gchar *name;
+
+  if (!reader_expect (r, '{'))
+    return;
+
+  while ((name = reader_object_next (r, &first))) {
+    if (!strcmp (name, "stream-id")) {
+      const gchar *value = reader_string (r);
+
+      g_free (stream_id);
+      stream_id = g_strdup (value);
+    } else if (!strcmp (name, "media-type")) {
+      const gchar *value = reader_string (r);
+
+      if (!g_strcmp0 (value, "video")) {
+        media_type = VIDEO;
+      } else if (!g_strcmp0 (value, "audio")) {
+        media_type = AUDIO;
+      } else {
+        reader_fail (r, "Unknown media type %s", value);
+        break;
+      }
+
+      has_media_type = TRUE;
+    } else if (!strcmp (name, "profiles")) {
+      gboolean first_profile = TRUE;
+
+      /* Profiles are mapped as they are read */
+      if (!stream_id || !has_media_type) {
+        reader_fail (r, "Stream profiles must come after the stream-id and media-type");
+        break;
+      }
+
+      if (!reader_expect (r, '['))
+        break;
+
+      while (reader_array_next (r, &first_profile)) {
+        GstTranscodingStreamProfile *profile;
+        GstTranscodingStreamSettings settings;
+        gchar *output = NULL;
+
+        if (!reader_profile (r, &settings, &output))
+          break;
+
+        if (!output) {
+          reader_fail (r, "Stream profile without an output");
+          break;
+        }
+
+        if (media_type == VIDEO)
+          profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, in_uri, stream_id, output);
+        else
+          profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, in_uri, stream_id, output);
+        g_free (output);
+
+        if (!profile) {
+          reader_fail (r, "Stream %s is mapped as both audio and video", stream_id);
+          break;
+        }
+
+        _gst_transcoding_stream_profile_set_settings (profile, &settings);
+        g_object_unref (profile);
+      }
+    } else {
+      reader_skip_value (r);
+    }
+  }
+
+  g_free (stream_id);
+}
+
+static void
+reader_input (JsonReader *r, GstTranscodingJob *job)
+{
+  GstTranscodingInput *input = NULL;
+  GstClockTime start = GST_CLOCK_TIME_NONE, stop = GST_CLOCK_TIME_NONE;
+  gboolean auto_link = FALSE;
+  gboolean first = TRUE;
+  gchar *uri = NULL;
+  const gchar *name;
+
+  if (!reader_expect (r, '{'))
+    return;
+
+  while ((name = reader_object_next (r, &first))) {
+    if (!strcmp (name, "uri")) {
+      const gchar *value = reader_string (r);
+
+      g_free (uri);
+      uri = g_strdup (value);
+    } else if (!strcmp (name, "autolink")) {
+      reader_boolean (r, &auto_link);
+    } else if (!strcmp (name, "start")) {
+      reader_uint (r, GST_CLOCK_TIME_NONE - 1, &start);
+    } else if (!strcmp (name, "stop")) {
+      reader_uint (r, GST_CLOCK_TIME_NONE - 1, &stop);
+    } else if (!strcmp (name, "streams")) {
+      gboolean first_stream = TRUE;
+
+      if (!uri) {
+        reader_fail (r, "Input streams must come after the uri");
+        break;
+      }
+
+      if (!input && !(input = gst_transcoding_job_add_input (job, uri))) {
+        reader_fail (r, "Duplicate input %s", uri);
+        break;
+      }
+
+      if (!reader_expect (r, '['))
+        break;
+
+      while (reader_array_next (r, &first_stream))
+        reader_stream (r, job, uri);
+    } else {
+      reader_skip_value (r);
+    }
+  }
+
+  if (!r->error && !uri)
+    reader_fail (r, "Input without a uri");
+
+  if (!r->error && GST_CLOCK_TIME_IS_VALID (start) && GST_CLOCK_TIME_IS_VALID (stop) && start >= stop)
+    reader_fail (r, "Empty range for input %s", uri);
+
+  if (!r->error && !input && !(input = gst_transcoding_job_add_input (job, uri)))
+    reader_fail (r, "Duplicate input %s", uri);
+
+  if (input) {
+    input->auto_link = auto_link;
+    input->start = start;
+    input->stop = stop;
+    g_object_unref (input);
+  }
+
+  g_free (uri);
+}
+
+static GstTranscodingJob *
+reader_job (JsonReader *r)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  gboolean first = TRUE;
+  const gchar *name;
+
+  r->string = g_string_new (NULL);
+  r->line = 1;
+
+  if (reader_expect (r, '{')) {
+    while ((name = reader_object_next (r, &first))) {
+      gboolean first_element = TRUE;
+
+      if (!strcmp (name, "outputs")) {
+        if (reader_expect (r, '['))
+          while (reader_array_next (r, &first_element))
+            reader_output (r, job);
+      } else if (!strcmp (name, "inputs")) {
+        if (reader_expect (r, '['))
+          while (reader_array_next (r, &first_element))
+            reader_input (r, job);
+      } else {
+        reader_skip_value (r);
+      }
+    }
+  }
+
+  if (!r->error && reader_peek (r) != -1)
+    reader_fail (r, "Trailing data after the job");
+
+  g_string_free (r->string, TRUE);
+
+  if (r->error)
+    g_clear_object (&job);
+
+  return job;
+}
+
+GstTranscodingJob *
+gst_transcoding_job_from_json (const gchar *json, GError **error)
+{
+  JsonReader r = { 0, };
+  GstTranscodingJob *ret;
+
+  r.data = json;
+  r.len = strlen (json);
+
+  ret = reader_job (&r);
+  if (!ret)
+    g_propagate_error (error, r.error);
+
+  return ret;
+}
+
+GstTranscodingJob *
+gst_transcoding_job_from_json_stream (GInputStream *stream, GCancellable *cancellable, GError **error)
+{
+  JsonReader r = { 0, };
+  GstTranscodingJob *ret;
+
+  r.stream = stream;
+  r.cancellable = cancellable;
+  r.chunk = g_malloc (READER_CHUNK_SIZE);
+
+  ret = reader_job (&r);
+  if (!ret)
+    g_propagate_error (error, r.error);
+
+  g_free (r.chunk);
+
+  return ret;
+}
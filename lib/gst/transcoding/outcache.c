@@ -0,0 +1,359 @@
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "executor-private.h"
+#include "cache-private.h"
+
+/* Output cache: outputs are kept in the cache directory, named after a
+ * checksum of everything they are made of: the content of the inputs
+ * feeding them, the range and streams taken from those, and the resolved
+ * settings of each profile and of the container. Outputs found in the cache
+ * are copied from it, the others are transcoded by a job restricted to
+ * them, then added to it.
+ *
+ * Only whole outputs to local files are cached: an output missing from the
+ * cache is transcoded entirely, even if some of its streams were already
+ * encoded for another output. Hashing the content of an input means
+ * reading all of it, with a discovery cache that is only done once for as
+ * long as the input doesn't change.
+ */
+
+#define HASH_CHUNK_SIZE (64 * 1024)
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  GCancellable *cancellable;
+  /* GstTranscodingInput -> checksum of its content, NULL if it can't be
+   * read */
+  GHashTable *content_hashes;
+} OutputCache;
+
+static gchar *
+hash_file (const gchar *uri, GCancellable *cancellable)
+{
+  GFile *file = g_file_new_for_uri (uri);
+  GInputStream *stream = G_INPUT_STREAM (g_file_read (file, cancellable, NULL));
+  GChecksum *checksum;
+  guint8 *buf;
+  gssize n_read = 0;
+  gchar *ret = NULL;
+
+  g_object_unref (file);
+
+  if (!stream)
+    return NULL;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  buf = g_malloc (HASH_CHUNK_SIZE);
+
+  while ((n_read = g_input_stream_read (stream, buf, HASH_CHUNK_SIZE, cancellable, NULL)) > 0)
+    g_checksum_update (checksum, buf, n_read);
+
+  if (n_read == 0)
+    ret = g_strdup (g_checksum_get_string (checksum));
+
+  g_free (buf);
+  g_checksum_free (checksum);
+  g_object_unref (stream);
+
+  return ret;
+}
+
+static const gchar *
+output_cache_get_content_hash (OutputCache *self, GstTranscodingInput *input)
+{
+  const gchar *cache = self->job->discovery_cache;
+  GstTranscodingMediaInfo *info = NULL;
+  gchar *hash;
+
+  if (g_hash_table_lookup_extended (self->content_hashes, input, NULL, (gpointer *) &hash))
+    return hash;
+
+  if (cache)
+    info = _gst_transcoding_cache_lookup (cache, input->uri);
+
+  if (info && info->content_hash) {
+    hash = g_strdup (info->content_hash);
+  } else if ((hash = hash_file (input->uri, self->cancellable)) && cache) {
+    if (!info)
+      info = _gst_transcoding_media_info_new ();
+    info->content_hash = g_strdup (hash);
+    _gst_transcoding_cache_store (cache, input->uri, info);
+  }
+
+  if (info)
+    _gst_transcoding_media_info_free (info);
+
+  g_hash_table_insert (self->content_hashes, input, hash);
+
+  return hash;
+}
+
+static void
+checksum_add_string (GChecksum *checksum, const gchar *str)
+{
+  /* With the terminator, so that consecutive strings can't run together */
+  g_checksum_update (checksum, (const guchar *) str, strlen (str) + 1);
+}
+
+static void
+checksum_add_uint64 (GChecksum *checksum, guint64 value)
+{
+  value = GUINT64_TO_LE (value);
+  g_checksum_update (checksum, (const guchar *) &value, sizeof (value));
+}
+
+/* Returns NULL if @output can't be cached: nothing is mapped to it, or one
+ * of its inputs can't be read */
+static gchar *
+output_cache_compute_key (OutputCache *self, GstTranscodingOutput *output)
+{
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  GList *uris = _gst_transcoding_hash_table_get_sorted_keys (self->job->inputs), *tmp;
+  gboolean mapped = FALSE, ret = TRUE;
+  gchar *key = NULL;
+  guint i;
+
+  checksum_add_string (checksum, g_quark_to_string (output->profile->format));
+  /* Copied video differs from re-encoded video */
+  checksum_add_uint64 (checksum, self->job->smart_render);
+
+  /* So does the order the inputs are played in */
+  for (i = 0; output->sequence && output->sequence[i] && ret; i++) {
+    GstTranscodingInput *input = g_hash_table_lookup (self->job->inputs, output->sequence[i]);
+    const gchar *hash = input ? output_cache_get_content_hash (self, input) : NULL;
+
+    if (hash)
+      checksum_add_string (checksum, hash);
+    else
+      ret = FALSE;
+  }
+
+  for (tmp = uris; tmp && ret; tmp = tmp->next) {
+    GstTranscodingInput *input = g_hash_table_lookup (self->job->inputs, tmp->data);
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *stmp;
+
+    for (stmp = stream_ids; stmp && ret; stmp = stmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, stmp->data);
+      guint j;
+
+      for (j = 0; j < profiles->len && ret; j++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, j);
+        const gchar *hash;
+        GVariant *settings;
+        gchar *str;
+
+        if (_gst_transcoding_stream_profile_get_private (profile)->output != output)
+          continue;
+
+        if (!(hash = output_cache_get_content_hash (self, input))) {
+          ret = FALSE;
+          break;
+        }
+
+        settings = g_variant_ref_sink (_gst_transcoding_stream_profile_settings_to_variant (profile));
+        str = g_variant_print (settings, FALSE);
+
+        checksum_add_string (checksum, hash);
+        checksum_add_uint64 (checksum, input->start);
+        checksum_add_uint64 (checksum, input->stop);
+        checksum_add_string (checksum, stmp->data);
+        checksum_add_uint64 (checksum, _gst_transcoding_stream_profile_get_media_type (profile));
+        checksum_add_string (checksum, str);
+        mapped = TRUE;
+
+        g_free (str);
+        g_variant_unref (settings);
+      }
+    }
+
+    g_list_free (stream_ids);
+  }
+
+  g_list_free (uris);
+
+  if (ret && mapped)
+    key = g_strdup (g_checksum_get_string (checksum));
+
+  g_checksum_free (checksum);
+
+  return key;
+}
+
+/* Same job, restricted to the outputs of @outputs */
+static GstTranscodingJob *
+output_cache_create_job (OutputCache *self, GHashTable *outputs)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GHashTableIter iter;
+  GstTranscodingOutput *output, *added;
+  GstTranscodingInput *input;
+
+  job->segment_duration = self->job->segment_duration;
+  job->smart_render = self->job->smart_render;
+  job->max_workers = self->job->max_workers;
+  job->worker_executable = g_strdup (self->job->worker_executable);
+  job->discovery_cache = g_strdup (self->job->discovery_cache);
+  job->encoder_threads = self->job->encoder_threads;
+  job->queue_max_bytes = self->job->queue_max_bytes;
+
+  g_hash_table_iter_init (&iter, outputs);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &output, NULL)) {
+    GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+
+    gst_transcoding_container_profile_set_format (cprof, output->profile->format);
+    added = gst_transcoding_job_add_output (job, output->uri, cprof);
+    added->sequence = g_strdupv (output->sequence);
+    g_object_unref (added);
+  }
+
+  g_hash_table_iter_init (&iter, self->job->inputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &input)) {
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *tmp;
+    GstTranscodingInput *copy;
+
+    for (tmp = stream_ids; tmp; tmp = tmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, tmp->data);
+      guint j;
+
+      for (j = 0; j < profiles->len; j++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, j);
+        GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+        GstTranscodingStreamProfile *mapped;
+
+        if (!g_hash_table_contains (outputs, priv->output))
+          continue;
+
+        if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+          mapped = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, input->uri, tmp->data,
+              priv->output->uri);
+        else
+          mapped = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, input->uri, tmp->data,
+              priv->output->uri);
+
+        _gst_transcoding_stream_profile_copy_into (profile, mapped);
+        g_object_unref (mapped);
+      }
+    }
+
+    g_list_free (stream_ids);
+
+    /* Inputs that only feed cached outputs aren't read at all */
+    if ((copy = g_hash_table_lookup (job->inputs, input->uri))) {
+      copy->start = input->start;
+      copy->stop = input->stop;
+    }
+  }
+
+  return job;
+}
+
+static gboolean
+copy_file (const gchar *src, const gchar *dest)
+{
+  GFile *src_file = g_file_new_for_path (src);
+  GFile *dest_file = g_file_new_for_path (dest);
+  GError *error = NULL;
+  gboolean ret;
+
+  ret = g_file_copy (src_file, dest_file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error);
+  if (!ret) {
+    GST_WARNING ("Could not copy %s to %s: %s", src, dest, error->message);
+    g_error_free (error);
+  }
+
+  g_object_unref (dest_file);
+  g_object_unref (src_file);
+
+  return ret;
+}
+
+/* Copied next to the entry first, so that nobody ever sees it partially
+ * written */
+static void
+output_cache_store (OutputCache *self, const gchar *path, const gchar *key)
+{
+  gchar *entry = g_build_filename (self->job->output_cache, key, NULL);
+  gchar *tmp = g_strdup_printf ("%s.%08x", entry, g_random_int ());
+
+  if (g_mkdir_with_parents (self->job->output_cache, 0755) == 0 && copy_file (path, tmp) &&
+      g_rename (tmp, entry) < 0)
+    GST_WARNING ("Could not add %s to the output cache: %s", path, g_strerror (errno));
+
+  g_remove (tmp);
+  g_free (tmp);
+  g_free (entry);
+}
+
+gboolean
+_gst_transcoding_output_cache_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error)
+{
+  OutputCache self = { 0, };
+  /* GstTranscodingOutput -> its key if it can be cached, NULL otherwise */
+  GHashTable *to_run = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  GHashTableIter iter;
+  GstTranscodingOutput *output;
+  const gchar *key;
+  gboolean ret = TRUE;
+
+  self.job = job;
+  self.cancellable = cancellable;
+  self.content_hashes = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  g_hash_table_iter_init (&iter, job->outputs);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &output)) {
+    GFile *file = g_file_new_for_uri (output->uri);
+    gchar *path = g_file_get_path (file);
+    gchar *output_key = path ? output_cache_compute_key (&self, output) : NULL;
+
+    output->cache_status = GST_TRANSCODING_CACHE_STATUS_NONE;
+
+    if (output_key) {
+      gchar *entry = g_build_filename (job->output_cache, output_key, NULL);
+
+      if (g_file_test (entry, G_FILE_TEST_IS_REGULAR) && copy_file (entry, path)) {
+        output->cache_status = GST_TRANSCODING_CACHE_STATUS_HIT;
+        g_clear_pointer (&output_key, g_free);
+      } else {
+        output->cache_status = GST_TRANSCODING_CACHE_STATUS_MISS;
+      }
+
+      g_free (entry);
+    }
+
+    if (output->cache_status != GST_TRANSCODING_CACHE_STATUS_HIT)
+      g_hash_table_insert (to_run, output, output_key);
+
+    g_free (path);
+    g_object_unref (file);
+  }
+
+  g_hash_table_unref (self.content_hashes);
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+    ret = FALSE;
+  } else if (g_hash_table_size (to_run)) {
+    GstTranscodingJob *restricted = output_cache_create_job (&self, to_run);
+
+    ret = gst_transcoding_job_run (restricted, cancellable, error);
+    g_object_unref (restricted);
+  }
+
+  g_hash_table_iter_init (&iter, to_run);
+  while (ret && g_hash_table_iter_next (&iter, (gpointer *) &output, (gpointer *) &key)) {
+    if (key) {
+      GFile *file = g_file_new_for_uri (output->uri);
+      gchar *path = g_file_get_path (file);
+
+      output_cache_store (&self, path, key);
+
+      g_free (path);
+      g_object_unref (file);
+    }
+  }
+
+  g_hash_table_unref (to_run);
+
+  return ret;
+}
@@ -0,0 +1,275 @@
+#include "scheduler.h"
+#include "executor-private.h"
+
+struct _GstTranscodingScheduler
+{
+  GObject parent;
+
+  GThreadPool *pool;
+  guint max_jobs;
+  guint thread_budget;
+  guint64 memory_budget;
+
+  GMutex lock;
+  /* Submissions, highest priority first, in submission order otherwise */
+  GSequence *pending;
+  guint64 next_seq;
+  guint n_running;
+  guint threads_in_use;
+  guint64 bytes_in_use;
+};
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  gint priority;
+  guint64 seq;
+  guint n_encoders;
+  guint n_queues;
+  /* Given to the job once it is dispatched */
+  guint encoder_threads;
+  guint queue_max_bytes;
+  /* What the job holds from the budgets while it runs */
+  guint n_threads;
+  guint64 n_bytes;
+  gulong cancelled_id;
+} Submission;
+
+G_DEFINE_TYPE (GstTranscodingScheduler, gst_transcoding_scheduler, G_TYPE_OBJECT)
+
+static void
+submission_free (Submission *submission)
+{
+  g_object_unref (submission->job);
+  g_free (submission);
+}
+
+static gint
+submission_compare (GTask *a, GTask *b, gpointer user_data)
+{
+  Submission *sa = g_task_get_task_data (a);
+  Submission *sb = g_task_get_task_data (b);
+
+  if (sa->priority != sb->priority)
+    return sa->priority > sb->priority ? -1 : 1;
+
+  return sa->seq < sb->seq ? -1 : 1;
+}
+
+/* Splits the share of the budgets the job would get, among the jobs
+ * running or waiting, between its encoders and queues. A job alone gets
+ * the whole thread budget, never more than what the running jobs leave. */
+static void
+scheduler_size_submission (GstTranscodingScheduler *self, Submission *submission)
+{
+  guint n_jobs = MIN (self->max_jobs, self->n_running + g_sequence_get_length (self->pending));
+  guint thread_share = self->thread_budget / MAX (1, n_jobs);
+
+  if (self->n_running)
+    thread_share = MIN (thread_share, self->thread_budget - MIN (self->thread_budget, self->threads_in_use));
+
+  submission->encoder_threads = MAX (1, thread_share / MAX (1, submission->n_encoders));
+  submission->n_threads = MAX (1, submission->n_encoders) * submission->encoder_threads;
+
+  if (self->memory_budget) {
+    guint64 queue_bytes = self->memory_budget / self->max_jobs / MAX (1, submission->n_queues);
+
+    submission->queue_max_bytes = (guint) CLAMP (queue_bytes, 1, G_MAXUINT);
+    submission->n_bytes = (guint64) submission->queue_max_bytes * submission->n_queues;
+  } else {
+    submission->queue_max_bytes = 0;
+    submission->n_bytes = 0;
+  }
+}
+
+static gboolean
+scheduler_fits (GstTranscodingScheduler *self, Submission *submission)
+{
+  /* A job larger than the whole budget still has to run at some point */
+  if (self->n_running == 0)
+    return TRUE;
+
+  if (self->n_running >= self->max_jobs)
+    return FALSE;
+
+  if (self->threads_in_use + submission->n_threads > self->thread_budget)
+    return FALSE;
+
+  if (self->memory_budget && self->bytes_in_use + submission->n_bytes > self->memory_budget)
+    return FALSE;
+
+  return TRUE;
+}
+
+/* Starts pending jobs in order until the next one doesn't fit. Lower
+ * priority jobs never overtake it, so large jobs can't be starved.
+ * Cancelled jobs are handed to the pool right away, which completes them
+ * without running them or holding anything from the budgets. */
+static void
+scheduler_dispatch_unlocked (GstTranscodingScheduler *self)
+{
+  while (!g_sequence_is_empty (self->pending)) {
+    GSequenceIter *head = g_sequence_get_begin_iter (self->pending);
+    GTask *task = g_sequence_get (head);
+    Submission *submission = g_task_get_task_data (task);
+
+    if (g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+      submission->n_threads = 0;
+      submission->n_bytes = 0;
+    } else {
+      scheduler_size_submission (self, submission);
+      if (!scheduler_fits (self, submission))
+        break;
+
+      submission->job->encoder_threads = submission->encoder_threads;
+      submission->job->queue_max_bytes = submission->queue_max_bytes;
+    }
+
+    self->n_running++;
+    self->threads_in_use += submission->n_threads;
+    self->bytes_in_use += submission->n_bytes;
+
+    g_sequence_remove (head);
+    g_thread_pool_push (self->pool, task, NULL);
+  }
+}
+
+/* Lets the jobs queued behind a cancelled one go */
+static void
+scheduler_cancelled_cb (GCancellable *cancellable, GstTranscodingScheduler *self)
+{
+  g_mutex_lock (&self->lock);
+  scheduler_dispatch_unlocked (self);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+scheduler_run_func (GTask *task, GstTranscodingScheduler *self)
+{
+  Submission *submission = g_task_get_task_data (task);
+  GError *error = NULL;
+  gboolean cancelled, ret = FALSE;
+
+  /* Not under the lock, the handler may be running */
+  if (submission->cancelled_id)
+    g_cancellable_disconnect (g_task_get_cancellable (task), submission->cancelled_id);
+
+  /* Jobs cancelled while pending don't build any pipeline */
+  cancelled = g_task_return_error_if_cancelled (task);
+  if (!cancelled)
+    ret = gst_transcoding_job_run (submission->job, g_task_get_cancellable (task), &error);
+
+  g_mutex_lock (&self->lock);
+  self->n_running--;
+  self->threads_in_use -= submission->n_threads;
+  self->bytes_in_use -= submission->n_bytes;
+  scheduler_dispatch_unlocked (self);
+  g_mutex_unlock (&self->lock);
+
+  if (error)
+    g_task_return_error (task, error);
+  else if (!cancelled)
+    g_task_return_boolean (task, ret);
+
+  /* The task holds the last reference to the scheduler, which must not be
+   * used after this */
+  g_object_unref (task);
+}
+
+static void
+scheduler_finalize (GObject *object)
+{
+  GstTranscodingScheduler *self = GST_TRANSCODING_SCHEDULER (object);
+
+  /* Every submission holds a reference, so nothing is pending or running,
+   * but we may be finalized from a thread of the pool */
+  g_thread_pool_free (self->pool, FALSE, FALSE);
+  g_sequence_free (self->pending);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (gst_transcoding_scheduler_parent_class)->finalize (object);
+}
+
+static void
+gst_transcoding_scheduler_class_init (GstTranscodingSchedulerClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = scheduler_finalize;
+}
+
+static void
+gst_transcoding_scheduler_init (GstTranscodingScheduler *self)
+{
+  g_mutex_init (&self->lock);
+  self->pending = g_sequence_new (NULL);
+  self->thread_budget = g_get_num_processors ();
+}
+
+GstTranscodingScheduler *
+gst_transcoding_scheduler_new (guint max_jobs)
+{
+  GstTranscodingScheduler *self = g_object_new (GST_TRANSCODING_TYPE_SCHEDULER, NULL);
+
+  self->max_jobs = max_jobs ? max_jobs : g_get_num_processors ();
+  self->pool = g_thread_pool_new ((GFunc) scheduler_run_func, self, self->max_jobs, FALSE, NULL);
+
+  return self;
+}
+
+void
+gst_transcoding_scheduler_set_thread_budget (GstTranscodingScheduler *self, guint n_threads)
+{
+  g_mutex_lock (&self->lock);
+  self->thread_budget = n_threads ? n_threads : g_get_num_processors ();
+  scheduler_dispatch_unlocked (self);
+  g_mutex_unlock (&self->lock);
+}
+
+void
+gst_transcoding_scheduler_set_memory_budget (GstTranscodingScheduler *self, guint64 n_bytes)
+{
+  g_mutex_lock (&self->lock);
+  self->memory_budget = n_bytes;
+  scheduler_dispatch_unlocked (self);
+  g_mutex_unlock (&self->lock);
+}
+
+void
+gst_transcoding_scheduler_submit (GstTranscodingScheduler *self,
+                                  GstTranscodingJob *job,
+                                  gint priority,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+  GTask *task = g_task_new (self, cancellable, callback, user_data);
+  Submission *submission = g_new0 (Submission, 1);
+
+  submission->job = g_object_ref (job);
+  submission->priority = priority;
+  _gst_transcoding_job_estimate_cost (job, &submission->n_encoders, &submission->n_queues);
+
+  g_task_set_source_tag (task, gst_transcoding_scheduler_submit);
+  g_task_set_task_data (task, submission, (GDestroyNotify) submission_free);
+
+  /* Outside of the lock, as it runs right away if already cancelled. The
+   * task keeps us alive until the pool disconnects it. */
+  if (cancellable)
+    submission->cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (scheduler_cancelled_cb), self, NULL);
+
+  g_mutex_lock (&self->lock);
+  submission->seq = self->next_seq++;
+  /* The sequence owns the task until it is pushed to the pool */
+  g_sequence_insert_sorted (self->pending, task, (GCompareDataFunc) submission_compare, NULL);
+  scheduler_dispatch_unlocked (self);
+  g_mutex_unlock (&self->lock);
+}
+
+gboolean
+gst_transcoding_scheduler_submit_finish (GstTranscodingScheduler *self, GAsyncResult *result, GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "job.h"
+
+G_BEGIN_DECLS
+
+#define GST_TRANSCODING_TYPE_SCHEDULER gst_transcoding_scheduler_get_type ()
+G_DECLARE_FINAL_TYPE(GstTranscodingScheduler, gst_transcoding_scheduler, GST_TRANSCODING, SCHEDULER, GObject)
+
+/* Runs up to @max_jobs submitted jobs at the same time, 0 means one per
+ * processor */
+GstTranscodingScheduler * gst_transcoding_scheduler_new (guint max_jobs);
+
+/* Total number of encoder threads shared by the running jobs, 0 (the
+ * default) means one per processor. Each job gets an even share among the
+ * jobs running or waiting, the whole budget when it is alone, and only
+ * starts once its share fits in what the running jobs leave, unless
+ * nothing else is running. */
+void gst_transcoding_scheduler_set_thread_budget (GstTranscodingScheduler *self, guint n_threads);
+
+/* Total number of bytes the queues of the running jobs may buffer, 0 (the
+ * default) leaves the queues at their element defaults */
+void gst_transcoding_scheduler_set_memory_budget (GstTranscodingScheduler *self, guint64 n_bytes);
+
+/* Queues @job, which is run once the jobs submitted before it with the same
+ * or a higher @priority have started and the budgets allow it. The
+ * scheduler sets the encoder thread count and queue sizes of the job. */
+void gst_transcoding_scheduler_submit (GstTranscodingScheduler *self,
+                                       GstTranscodingJob *job,
+                                       gint priority,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+
+gboolean gst_transcoding_scheduler_submit_finish (GstTranscodingScheduler *self,
+                                                  GAsyncResult *result,
+                                                  GError **error);
+
+G_END_DECLS
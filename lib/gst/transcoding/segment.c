@@ -0,0 +1,1033 @@
+#include <string.h>
+#include <glib/gstdio.h>
+#include "worker-private.h"
+#include "cache-private.h"
+
+/* Segment-parallel transcoding of a job with a single input:
+ *
+ * - the input is scanned, without decoding, for the keyframes of its first
+ *   mapped video stream
+ * - the input is cut in chunks starting on those keyframes, each chunk is
+ *   transcoded by a sub-job into intermediate matroska files, one per
+ *   output, on a pool of worker threads
+ * - the intermediate files of each output are then concatenated, in order,
+ *   into the actual output, without re-encoding
+ *
+ * With a worker executable set, chunks are transcoded by worker processes
+ * instead, see worker.c. Idle workers are kept around for the next chunk,
+ * a worker that died is replaced and its chunk retried.
+ *
+ * With a discovery cache, the keyframes found by scanning the input are kept
+ * in it, and the scan is skipped next time.
+ *
+ * Smart rendering uses the same machinery with at most three chunks: the
+ * GOPs containing the start and the stop of the range are re-encoded, the
+ * keyframe-aligned chunk in between has its video copied as is. That is
+ * only done for the single video stream of an input, already in the format
+ * of its profiles, and only kept if the re-encoded chunks have the same
+ * caps as the copied one. Otherwise the range is transcoded as a whole.
+ *
+ * Encoded audio isn't cut in chunks: the priming and padding of the
+ * encoders would leave gaps at each join. It is transcoded in one more
+ * sub-job over the whole range, running along the chunks, whose file is
+ * stitched with them.
+ *
+ * Streams of a chunk file are demuxed by name ("video_0", "audio_1"...),
+ * which matches the order in which the executor requests its muxer pads.
+ */
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  GstTranscodingInput *input;
+  gchar *tmpdir;
+
+  /* GstTranscodingOutput, in a stable order */
+  GPtrArray *outputs;
+  /* GstClockTime, start of each chunk, the last chunk runs until stop */
+  GArray *bounds;
+  /* End of the range of the input, GST_CLOCK_TIME_NONE for its end */
+  GstClockTime stop;
+  /* Chunk whose video is copied rather than re-encoded, G_MAXUINT if none */
+  guint copy_chunk;
+
+  /* GstTranscodingWorker, waiting for a chunk */
+  GAsyncQueue *idle_workers;
+
+  /* Cancels the remaining chunks once one has failed */
+  GCancellable *cancellable;
+  GMutex lock;
+  GCond cond;
+  guint n_pending;
+  GError *error;
+} Segmenter;
+
+typedef struct
+{
+  const gchar *stream_id;
+  GMutex lock;
+  GArray *keyframes;
+  GstClockTime end;
+} ScanContext;
+
+static GstClockTime
+buffer_get_timestamp (GstBuffer *buf)
+{
+  return GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) : GST_BUFFER_DTS (buf);
+}
+
+static GstPadProbeReturn
+scan_probe (GstPad *pad, GstPadProbeInfo *info, ScanContext *ctx)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime ts = buffer_get_timestamp (buf);
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_PAD_PROBE_OK;
+
+  if (GST_BUFFER_DURATION_IS_VALID (buf))
+    ts += GST_BUFFER_DURATION (buf);
+
+  g_mutex_lock (&ctx->lock);
+  if (!GST_CLOCK_TIME_IS_VALID (ctx->end) || ts > ctx->end)
+    ctx->end = ts;
+  g_mutex_unlock (&ctx->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+keyframe_probe (GstPad *pad, GstPadProbeInfo *info, ScanContext *ctx)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime ts = buffer_get_timestamp (buf);
+
+  if (GST_CLOCK_TIME_IS_VALID (ts) && !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    g_mutex_lock (&ctx->lock);
+    g_array_append_val (ctx->keyframes, ts);
+    g_mutex_unlock (&ctx->lock);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+scan_pad_added_cb (GstElement *parsebin, GstPad *pad, ScanContext *ctx)
+{
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  gchar *stream_id = gst_pad_get_stream_id (pad);
+  GstPad *sinkpad;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) scan_probe, ctx, NULL);
+
+  if (ctx->stream_id && !g_strcmp0 (stream_id, ctx->stream_id))
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, (GstPadProbeCallback) keyframe_probe, ctx, NULL);
+
+  g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
+  gst_bin_add (GST_BIN (GST_ELEMENT_PARENT (parsebin)), fakesink);
+  gst_element_sync_state_with_parent (fakesink);
+
+  sinkpad = gst_element_get_static_pad (fakesink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+
+  g_free (stream_id);
+}
+
+static gint
+compare_clock_time (const GstClockTime *a, const GstClockTime *b)
+{
+  return *a < *b ? -1 : *a > *b ? 1 : 0;
+}
+
+/* Reads through the whole input, only parsing it, returns the sorted
+ * keyframe timestamps of @stream_id, or NULL if @stream_id is NULL */
+static GArray *
+segmenter_scan (Segmenter *self, const gchar *stream_id, GstClockTime *end, GError **error)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *parsebin;
+  ScanContext ctx = { 0, };
+  gboolean ret = FALSE;
+
+  ctx.stream_id = stream_id;
+  ctx.keyframes = stream_id ? g_array_new (FALSE, FALSE, sizeof (GstClockTime)) : NULL;
+  ctx.end = GST_CLOCK_TIME_NONE;
+  g_mutex_init (&ctx.lock);
+
+  parsebin = _gst_transcoding_make_parsed_source (GST_BIN (pipeline), self->input->uri, NULL, error);
+
+  if (parsebin) {
+    g_signal_connect (parsebin, "pad-added", G_CALLBACK (scan_pad_added_cb), &ctx);
+    ret = _gst_transcoding_pipeline_run (pipeline, GST_STATE_NULL, self->cancellable, error);
+  }
+
+  gst_object_unref (pipeline);
+  g_mutex_clear (&ctx.lock);
+
+  if (!ret) {
+    if (ctx.keyframes)
+      g_array_unref (ctx.keyframes);
+    return NULL;
+  }
+
+  if (ctx.keyframes)
+    g_array_sort (ctx.keyframes, (GCompareFunc) compare_clock_time);
+
+  *end = ctx.end;
+
+  return ctx.keyframes;
+}
+
+static const gchar *
+segmenter_find_video_stream (Segmenter *self)
+{
+  GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (self->input->profiles);
+  const gchar *ret = NULL;
+  GList *tmp;
+
+  for (tmp = stream_ids; tmp && !ret; tmp = tmp->next) {
+    GPtrArray *profiles = g_hash_table_lookup (self->input->profiles, tmp->data);
+
+    if (_gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (profiles, 0)) == VIDEO)
+      ret = tmp->data;
+  }
+
+  g_list_free (stream_ids);
+
+  return ret;
+}
+
+/* Same as segmenter_scan(), going through the discovery cache of the job */
+static GArray *
+segmenter_scan_cached (Segmenter *self, const gchar *stream_id, GstClockTime *end, GError **error)
+{
+  const gchar *cache = self->job->discovery_cache;
+  GstTranscodingMediaInfo *info = NULL;
+  GArray *keyframes = NULL;
+
+  if (cache)
+    info = _gst_transcoding_cache_lookup (cache, self->input->uri);
+
+  if (info && GST_CLOCK_TIME_IS_VALID (info->duration)) {
+    if (!stream_id) {
+      *end = info->duration;
+      _gst_transcoding_media_info_free (info);
+      return NULL;
+    }
+
+    if ((keyframes = g_hash_table_lookup (info->keyframes, stream_id))) {
+      *end = info->duration;
+      g_array_ref (keyframes);
+      _gst_transcoding_media_info_free (info);
+      return keyframes;
+    }
+  }
+
+  keyframes = segmenter_scan (self, stream_id, end, error);
+
+  if (cache && (keyframes || (!stream_id && GST_CLOCK_TIME_IS_VALID (*end)))) {
+    if (!info)
+      info = _gst_transcoding_media_info_new ();
+
+    /* Read through the whole input, more accurate than the headers */
+    info->duration = *end;
+    if (keyframes)
+      g_hash_table_insert (info->keyframes, g_strdup (stream_id), g_array_ref (keyframes));
+
+    _gst_transcoding_cache_store (cache, self->input->uri, info);
+  }
+
+  if (info)
+    _gst_transcoding_media_info_free (info);
+
+  return keyframes;
+}
+
+static gboolean
+profile_is_encoded_audio (GstTranscodingStreamProfile *profile)
+{
+  return _gst_transcoding_stream_profile_get_media_type (profile) == AUDIO &&
+    gst_transcoding_stream_profile_get_format (profile) != GST_TRANSCODING_FORMAT_NONE;
+}
+
+static gboolean
+segmenter_has_encoded_audio (Segmenter *self)
+{
+  GHashTableIter iter;
+  GPtrArray *profiles;
+  guint i;
+
+  g_hash_table_iter_init (&iter, self->input->profiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &profiles)) {
+    for (i = 0; i < profiles->len; i++) {
+      if (profile_is_encoded_audio (g_ptr_array_index (profiles, i)))
+        return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Whether encoded audio is transcoded apart from the chunks, as chunk
+ * number bounds->len */
+static gboolean
+segmenter_has_audio_pass (Segmenter *self)
+{
+  return self->bounds->len > 1 && segmenter_has_encoded_audio (self);
+}
+
+static gboolean
+before_stop (Segmenter *self, GstClockTime ts)
+{
+  return !GST_CLOCK_TIME_IS_VALID (self->stop) || ts < self->stop;
+}
+
+static gboolean
+segmenter_compute_bounds (Segmenter *self, GError **error)
+{
+  GstClockTime duration = self->job->segment_duration;
+  const gchar *stream_id = segmenter_find_video_stream (self);
+  GstClockTime start = GST_CLOCK_TIME_IS_VALID (self->input->start) ? self->input->start : 0;
+  GstClockTime last = start, end = GST_CLOCK_TIME_NONE;
+  GArray *keyframes;
+  guint i;
+
+  keyframes = segmenter_scan_cached (self, stream_id, &end, error);
+
+  if (stream_id && !keyframes)
+    return FALSE;
+
+  self->bounds = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  g_array_append_val (self->bounds, last);
+
+  if (keyframes) {
+    for (i = 0; i < keyframes->len; i++) {
+      GstClockTime keyframe = g_array_index (keyframes, GstClockTime, i);
+
+      if (keyframe >= last + duration && before_stop (self, keyframe)) {
+        g_array_append_val (self->bounds, keyframe);
+        last = keyframe;
+      }
+    }
+
+    g_array_unref (keyframes);
+  } else if (GST_CLOCK_TIME_IS_VALID (end) && !segmenter_has_encoded_audio (self)) {
+    /* Audio only and copied, any position is fine */
+    for (last = start + duration; last < end && before_stop (self, last); last += duration)
+      g_array_append_val (self->bounds, last);
+  }
+
+  return TRUE;
+}
+
+/* Whether the video of @stream_id can be copied as is to all its outputs.
+ * It can't if other video streams are mapped, their keyframes don't line
+ * up with those of the copied chunk. */
+static gboolean
+segmenter_can_copy_video (Segmenter *self, const gchar *stream_id, gboolean *can_copy, GError **error)
+{
+  GPtrArray *profiles = g_hash_table_lookup (self->input->profiles, stream_id), *other;
+  GstTranscodingMediaInfo *info;
+  GHashTableIter iter;
+  GstCaps *caps = NULL;
+  guint n_video = 0, i;
+
+  *can_copy = FALSE;
+
+  g_hash_table_iter_init (&iter, self->input->profiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &other)) {
+    if (_gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (other, 0)) == VIDEO)
+      n_video++;
+  }
+
+  if (n_video > 1)
+    return TRUE;
+
+  if (!(info = _gst_transcoding_probe_input (self->input, self->job->discovery_cache, self->cancellable, error)))
+    return FALSE;
+
+  for (i = 0; i < info->streams->len && !caps; i++) {
+    GstTranscodingStreamInfo *stream = g_ptr_array_index (info->streams, i);
+
+    if (!g_strcmp0 (stream->stream_id, stream_id))
+      caps = gst_caps_from_string (stream->caps);
+  }
+
+  _gst_transcoding_media_info_free (info);
+
+  /* Left for the chunks to report */
+  if (!caps)
+    return TRUE;
+
+  *can_copy = TRUE;
+
+  for (i = 0; i < profiles->len && *can_copy; i++) {
+    const GstTranscodingStreamSettings *settings =
+      _gst_transcoding_stream_profile_get_settings (g_ptr_array_index (profiles, i));
+
+    *can_copy = settings->format == GST_TRANSCODING_FORMAT_NONE ||
+      (_gst_transcoding_stream_settings_allow_copy (settings) &&
+       _gst_transcoding_format_matches_caps (settings->format, caps));
+  }
+
+  gst_caps_unref (caps);
+
+  return TRUE;
+}
+
+/* Re-encodes up to the first keyframe of the range, and from the last one,
+ * copying the video in between */
+static gboolean
+segmenter_compute_smart_bounds (Segmenter *self, GError **error)
+{
+  const gchar *stream_id = segmenter_find_video_stream (self);
+  GstClockTime start = GST_CLOCK_TIME_IS_VALID (self->input->start) ? self->input->start : 0;
+  GstClockTime first = GST_CLOCK_TIME_NONE, last = GST_CLOCK_TIME_NONE, end = GST_CLOCK_TIME_NONE;
+  GArray *keyframes;
+  gboolean can_copy;
+  guint i;
+
+  self->bounds = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  g_array_append_val (self->bounds, start);
+
+  /* Nothing to copy, the range is transcoded as a whole */
+  if (!stream_id)
+    return TRUE;
+
+  if (!segmenter_can_copy_video (self, stream_id, &can_copy, error))
+    return FALSE;
+
+  if (!can_copy)
+    return TRUE;
+
+  if (!(keyframes = segmenter_scan_cached (self, stream_id, &end, error)))
+    return FALSE;
+
+  for (i = 0; i < keyframes->len; i++) {
+    GstClockTime keyframe = g_array_index (keyframes, GstClockTime, i);
+
+    if (keyframe < start || (GST_CLOCK_TIME_IS_VALID (self->stop) && keyframe > self->stop))
+      continue;
+
+    if (!GST_CLOCK_TIME_IS_VALID (first))
+      first = keyframe;
+    last = keyframe;
+  }
+
+  g_array_unref (keyframes);
+
+  /* Without a whole GOP in the range, there is nothing to copy either. The
+   * last GOP is whole when the range runs until the end of the input. */
+  if (!GST_CLOCK_TIME_IS_VALID (first) || (first == last && GST_CLOCK_TIME_IS_VALID (self->stop)))
+    return TRUE;
+
+  if (first > start)
+    g_array_append_val (self->bounds, first);
+  self->copy_chunk = self->bounds->len - 1;
+
+  if (GST_CLOCK_TIME_IS_VALID (self->stop) && last < self->stop)
+    g_array_append_val (self->bounds, last);
+
+  return TRUE;
+}
+
+static guint
+segmenter_output_index (Segmenter *self, GstTranscodingOutput *output)
+{
+  guint i;
+
+  for (i = 0; i < self->outputs->len; i++) {
+    if (g_ptr_array_index (self->outputs, i) == output)
+      break;
+  }
+
+  return i;
+}
+
+static gchar *
+segmenter_chunk_path (Segmenter *self, guint chunk, guint output)
+{
+  gchar *filename = g_strdup_printf ("chunk-%05u-%03u.mkv", chunk, output);
+  gchar *ret = g_build_filename (self->tmpdir, filename, NULL);
+
+  g_free (filename);
+
+  return ret;
+}
+
+static gchar *
+segmenter_chunk_uri (Segmenter *self, guint chunk, guint output)
+{
+  gchar *path = segmenter_chunk_path (self, chunk, output);
+  gchar *ret = gst_filename_to_uri (path, NULL);
+
+  g_free (path);
+
+  return ret;
+}
+
+/* Same mappings as the job, restricted to the chunk and going to
+ * intermediate files. The audio pass has the encoded audio over the whole
+ * range, the chunks everything else. */
+static GstTranscodingJob *
+segmenter_create_chunk_job (Segmenter *self, guint chunk)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  gboolean audio_pass = segmenter_has_audio_pass (self);
+  GList *stream_ids, *tmp;
+  GstTranscodingInput *input;
+  guint i;
+
+  job->encoder_threads = self->job->encoder_threads;
+  job->queue_max_bytes = self->job->queue_max_bytes;
+
+  for (i = 0; i < self->outputs->len; i++) {
+    GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+    gchar *uri = segmenter_chunk_uri (self, chunk, i);
+
+    gst_transcoding_container_profile_set_format (cprof, GST_TRANSCODING_FORMAT_MATROSKA);
+    g_object_unref (gst_transcoding_job_add_output (job, uri, cprof));
+    g_free (uri);
+  }
+
+  stream_ids = _gst_transcoding_hash_table_get_sorted_keys (self->input->profiles);
+
+  for (tmp = stream_ids; tmp; tmp = tmp->next) {
+    GPtrArray *profiles = g_hash_table_lookup (self->input->profiles, tmp->data);
+
+    for (i = 0; i < profiles->len; i++) {
+      GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+      GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+      gchar *uri = segmenter_chunk_uri (self, chunk, segmenter_output_index (self, priv->output));
+      GstTranscodingStreamProfile *copy;
+
+      if (audio_pass && profile_is_encoded_audio (profile) != (chunk == self->bounds->len)) {
+        g_free (uri);
+        continue;
+      }
+
+      if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+        copy = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, self->input->uri, tmp->data, uri);
+      else
+        copy = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, self->input->uri, tmp->data, uri);
+
+      _gst_transcoding_stream_profile_copy_into (profile, copy);
+      if (chunk == self->copy_chunk && _gst_transcoding_stream_profile_get_media_type (profile) == VIDEO)
+        gst_transcoding_stream_profile_set_format (copy, GST_TRANSCODING_FORMAT_NONE);
+      g_object_unref (copy);
+      g_free (uri);
+    }
+  }
+
+  g_list_free (stream_ids);
+
+  input = g_hash_table_lookup (job->inputs, self->input->uri);
+  input->start = g_array_index (self->bounds, GstClockTime, chunk == self->bounds->len ? 0 : chunk);
+  if (chunk + 1 < self->bounds->len)
+    input->stop = g_array_index (self->bounds, GstClockTime, chunk + 1);
+  else
+    input->stop = self->stop;
+
+  return job;
+}
+
+#define MAX_WORKER_ATTEMPTS 3
+
+static gboolean
+segmenter_run_chunk_in_worker (Segmenter *self, GstTranscodingJob *job, GError **error)
+{
+  guint attempt;
+
+  for (attempt = 1; attempt <= MAX_WORKER_ATTEMPTS; attempt++) {
+    GstTranscodingWorker *worker = g_async_queue_try_pop (self->idle_workers);
+    GError *worker_error = NULL;
+
+    if (!worker && !(worker = _gst_transcoding_worker_spawn (self->job->worker_executable, error)))
+      return FALSE;
+
+    if (_gst_transcoding_worker_run_job (worker, job, self->cancellable, &worker_error)) {
+      g_async_queue_push (self->idle_workers, worker);
+      return TRUE;
+    }
+
+    /* The job failed, but the worker is fine */
+    if (worker_error->domain == GST_TRANSCODING_ERROR) {
+      g_async_queue_push (self->idle_workers, worker);
+      g_propagate_error (error, worker_error);
+      return FALSE;
+    }
+
+    _gst_transcoding_worker_free (worker);
+
+    if (attempt == MAX_WORKER_ATTEMPTS || g_cancellable_is_cancelled (self->cancellable)) {
+      g_propagate_error (error, worker_error);
+      return FALSE;
+    }
+
+    GST_WARNING ("Worker failed (%s), retrying", worker_error->message);
+    g_error_free (worker_error);
+  }
+
+  return FALSE;
+}
+
+static void
+segmenter_run_chunk (gpointer data, Segmenter *self)
+{
+  /* Chunk indices are offset by one, NULL can't be pushed to a pool */
+  guint chunk = GPOINTER_TO_UINT (data) - 1;
+  GstTranscodingJob *job = segmenter_create_chunk_job (self, chunk);
+  GError *error = NULL;
+  gboolean ret;
+
+  if (self->job->worker_executable)
+    ret = segmenter_run_chunk_in_worker (self, job, &error);
+  else
+    ret = _gst_transcoding_executor_run_job (job, self->cancellable, &error);
+
+  if (!ret) {
+    g_mutex_lock (&self->lock);
+    if (!self->error) {
+      self->error = error;
+      g_cancellable_cancel (self->cancellable);
+    } else {
+      g_error_free (error);
+    }
+    g_mutex_unlock (&self->lock);
+  }
+
+  g_object_unref (job);
+
+  g_mutex_lock (&self->lock);
+  self->n_pending--;
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
+
+static gboolean
+segmenter_run_chunks (Segmenter *self, GError **error)
+{
+  guint n_workers = self->job->max_workers ? self->job->max_workers : g_get_num_processors ();
+  GThreadPool *pool;
+  guint n_jobs, i;
+
+  pool = g_thread_pool_new ((GFunc) segmenter_run_chunk, self, n_workers, FALSE, error);
+  if (!pool)
+    return FALSE;
+
+  n_jobs = self->bounds->len + segmenter_has_audio_pass (self);
+  self->n_pending = n_jobs;
+
+  for (i = 0; i < n_jobs; i++)
+    g_thread_pool_push (pool, GUINT_TO_POINTER (i + 1), NULL);
+
+  g_mutex_lock (&self->lock);
+  while (self->n_pending)
+    g_cond_wait (&self->cond, &self->lock);
+  g_mutex_unlock (&self->lock);
+
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  if (self->error) {
+    g_propagate_error (error, self->error);
+    self->error = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gint
+compare_strings (const gchar **a, const gchar **b)
+{
+  return strcmp (*a, *b);
+}
+
+/* Parsed caps of the video streams of a chunk file, sorted */
+static GPtrArray *
+segmenter_probe_chunk (Segmenter *self, guint chunk, guint output, GError **error)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  gchar *uri = segmenter_chunk_uri (self, chunk, output);
+  GstTranscodingInput *input = gst_transcoding_job_add_input (job, uri);
+  GstTranscodingMediaInfo *info;
+  GPtrArray *ret = NULL;
+  guint i;
+
+  if ((info = _gst_transcoding_probe_input (input, NULL, self->cancellable, error))) {
+    ret = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < info->streams->len; i++) {
+      GstTranscodingStreamInfo *stream = g_ptr_array_index (info->streams, i);
+
+      if (stream->media_type == VIDEO)
+        g_ptr_array_add (ret, g_strdup (stream->caps));
+    }
+
+    g_ptr_array_sort (ret, (GCompareFunc) compare_strings);
+    _gst_transcoding_media_info_free (info);
+  }
+
+  g_object_unref (input);
+  g_object_unref (job);
+  g_free (uri);
+
+  return ret;
+}
+
+static gboolean
+caps_strings_equal (GPtrArray *a, GPtrArray *b)
+{
+  gboolean ret = a->len == b->len;
+  guint i;
+
+  for (i = 0; i < a->len && ret; i++) {
+    GstCaps *caps_a = gst_caps_from_string (g_ptr_array_index (a, i));
+    GstCaps *caps_b = gst_caps_from_string (g_ptr_array_index (b, i));
+
+    ret = caps_a && caps_b && gst_caps_is_equal (caps_a, caps_b);
+
+    if (caps_a)
+      gst_caps_unref (caps_a);
+    if (caps_b)
+      gst_caps_unref (caps_b);
+  }
+
+  return ret;
+}
+
+/* Whether the video of the re-encoded chunks has the same caps as the copied
+ * one, codec data included: once stitched, decoders only get the caps of the
+ * first chunk */
+static gboolean
+segmenter_check_copied_chunk (Segmenter *self, gboolean *match, GError **error)
+{
+  GPtrArray *profiles = g_hash_table_lookup (self->input->profiles, segmenter_find_video_stream (self));
+  guint chunk, i, j;
+
+  *match = TRUE;
+
+  for (i = 0; i < self->outputs->len && *match; i++) {
+    GstTranscodingOutput *output = g_ptr_array_index (self->outputs, i);
+    GPtrArray *copied;
+    gboolean mapped = FALSE;
+
+    for (j = 0; j < profiles->len && !mapped; j++)
+      mapped = _gst_transcoding_stream_profile_get_private (g_ptr_array_index (profiles, j))->output == output;
+
+    if (!mapped)
+      continue;
+
+    if (!(copied = segmenter_probe_chunk (self, self->copy_chunk, i, error)))
+      return FALSE;
+
+    for (chunk = 0; chunk < self->bounds->len && *match; chunk++) {
+      GPtrArray *encoded;
+
+      if (chunk == self->copy_chunk)
+        continue;
+
+      if (!(encoded = segmenter_probe_chunk (self, chunk, i, error))) {
+        g_ptr_array_unref (copied);
+        return FALSE;
+      }
+
+      *match = caps_strings_equal (copied, encoded);
+      g_ptr_array_unref (encoded);
+    }
+
+    g_ptr_array_unref (copied);
+  }
+
+  return TRUE;
+}
+
+static void
+stitch_pad_added_cb (GstElement *demux, GstPad *pad, GHashTable *concat_pads)
+{
+  GstPad *sinkpad = g_hash_table_lookup (concat_pads, GST_PAD_NAME (pad));
+
+  if (sinkpad)
+    gst_pad_link (pad, sinkpad);
+}
+
+gboolean
+_gst_transcoding_stitch (GstTranscodingJob *job,
+                         GstTranscodingInput *input,
+                         GstTranscodingOutput *output,
+                         gchar **paths,
+                         guint n_paths,
+                         const gchar *audio_path,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *sink, *muxer = NULL;
+  GPtrArray *chunk_pads = g_ptr_array_new_with_free_func ((GDestroyNotify) g_hash_table_unref);
+  GList *stream_ids, *tmp;
+  guint n_video = 0, n_audio = 0, n_whole = 0;
+  gboolean ret = TRUE;
+  guint i, chunk, first, last;
+
+  /* The pads of @audio_path come after those of the chunks */
+  for (chunk = 0; chunk <= n_paths; chunk++)
+    g_ptr_array_add (chunk_pads, g_hash_table_new_full (g_str_hash, g_str_equal, g_free, gst_object_unref));
+
+  if (!(sink = gst_element_make_from_uri (GST_URI_SINK, output->uri, NULL, error)))
+    goto fail;
+
+  gst_bin_add (GST_BIN (pipeline), sink);
+
+  if (output->profile->format != GST_TRANSCODING_FORMAT_NONE) {
+    muxer = _gst_transcoding_make_element_for_format (GST_ELEMENT_FACTORY_TYPE_MUXER, output->profile->format, error);
+    if (!muxer)
+      goto fail;
+
+    gst_bin_add (GST_BIN (pipeline), muxer);
+    if (!gst_element_link (muxer, sink))
+      goto link_fail;
+  }
+
+  /* One concat per stream of the output, in the order of the chunk muxers */
+  stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles);
+
+  for (tmp = stream_ids; tmp && ret; tmp = tmp->next) {
+    GPtrArray *profiles = g_hash_table_lookup (input->profiles, tmp->data);
+
+    for (i = 0; i < profiles->len && ret; i++) {
+      GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+      MediaType media_type = _gst_transcoding_stream_profile_get_media_type (profile);
+      gboolean whole = audio_path && profile_is_encoded_audio (profile);
+      GstElement *concat, *queue;
+      GstPad *srcpad, *sinkpad;
+      gchar *name;
+
+      if (_gst_transcoding_stream_profile_get_private (profile)->output != output)
+        continue;
+
+      if (whole)
+        name = g_strdup_printf ("audio_%u", n_whole++);
+      else if (media_type == VIDEO)
+        name = g_strdup_printf ("video_%u", n_video++);
+      else
+        name = g_strdup_printf ("audio_%u", n_audio++);
+
+      concat = gst_element_factory_make ("concat", NULL);
+      queue = gst_element_factory_make ("queue", NULL);
+      if (job->queue_max_bytes)
+        g_object_set (queue, "max-size-bytes", job->queue_max_bytes, NULL);
+      gst_bin_add_many (GST_BIN (pipeline), concat, queue, NULL);
+
+      if (muxer)
+        sinkpad = _gst_transcoding_element_request_pad_for_media_type (muxer, media_type);
+      else
+        sinkpad = gst_element_get_static_pad (sink, "sink");
+
+      srcpad = gst_element_get_static_pad (queue, "src");
+      ret = sinkpad && gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK && gst_element_link (concat, queue);
+      gst_object_unref (srcpad);
+      if (sinkpad)
+        gst_object_unref (sinkpad);
+
+      /* concat plays its sink pads in the order they were requested */
+      if (whole)
+        g_hash_table_insert (g_ptr_array_index (chunk_pads, n_paths), g_strdup (name),
+            gst_element_get_request_pad (concat, "sink_%u"));
+      for (chunk = 0; chunk < n_paths && ret && !whole; chunk++)
+        g_hash_table_insert (g_ptr_array_index (chunk_pads, chunk), g_strdup (name),
+            gst_element_get_request_pad (concat, "sink_%u"));
+
+      g_free (name);
+    }
+  }
+
+  g_list_free (stream_ids);
+
+  if (!ret)
+    goto link_fail;
+
+  /* Nothing was mapped to this output */
+  if (n_video + n_audio + n_whole == 0) {
+    g_ptr_array_unref (chunk_pads);
+    gst_object_unref (pipeline);
+    return TRUE;
+  }
+
+  /* Files that have none of the streams of this output weren't written */
+  first = n_video + n_audio ? 0 : n_paths;
+  last = n_whole ? n_paths + 1 : n_paths;
+
+  for (chunk = first; chunk < last; chunk++) {
+    GstElement *src = gst_element_factory_make ("filesrc", NULL);
+    GstElement *demux = gst_element_factory_make ("matroskademux", NULL);
+
+    if (!src || !demux) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_MISSING_ELEMENT,
+          "Missing element to read back chunks");
+      if (src)
+        gst_object_unref (src);
+      if (demux)
+        gst_object_unref (demux);
+      goto fail;
+    }
+
+    g_object_set (src, "location", chunk < n_paths ? paths[chunk] : audio_path, NULL);
+
+    gst_bin_add_many (GST_BIN (pipeline), src, demux, NULL);
+    g_signal_connect_data (demux, "pad-added", G_CALLBACK (stitch_pad_added_cb),
+        g_hash_table_ref (g_ptr_array_index (chunk_pads, chunk)), (GClosureNotify) g_hash_table_unref, 0);
+
+    if (!gst_element_link (src, demux))
+      goto link_fail;
+  }
+
+  ret = _gst_transcoding_pipeline_run (pipeline, GST_STATE_NULL, cancellable, error);
+
+  g_ptr_array_unref (chunk_pads);
+  gst_object_unref (pipeline);
+
+  return ret;
+
+link_fail:
+  g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+      "Could not build the pipeline stitching %s", output->uri);
+fail:
+  g_ptr_array_unref (chunk_pads);
+  gst_object_unref (pipeline);
+
+  return FALSE;
+}
+
+/* Concatenates the chunk files of @output, in order, into @output, along
+ * with its audio pass */
+static gboolean
+segmenter_stitch (Segmenter *self, guint index, GError **error)
+{
+  gchar **paths = g_new0 (gchar *, self->bounds->len + 1);
+  gchar *audio_path = NULL;
+  gboolean ret;
+  guint chunk;
+
+  for (chunk = 0; chunk < self->bounds->len; chunk++)
+    paths[chunk] = segmenter_chunk_path (self, chunk, index);
+
+  if (segmenter_has_audio_pass (self))
+    audio_path = segmenter_chunk_path (self, self->bounds->len, index);
+
+  ret = _gst_transcoding_stitch (self->job, self->input, g_ptr_array_index (self->outputs, index),
+      paths, self->bounds->len, audio_path, self->cancellable, error);
+
+  g_strfreev (paths);
+  g_free (audio_path);
+
+  return ret;
+}
+
+static void
+segmenter_remove_chunks (Segmenter *self)
+{
+  guint chunk, i;
+
+  /* Along with the audio pass */
+  if (self->bounds) {
+    for (chunk = 0; chunk <= self->bounds->len; chunk++) {
+      for (i = 0; i < self->outputs->len; i++) {
+        gchar *path = segmenter_chunk_path (self, chunk, i);
+
+        g_remove (path);
+        g_free (path);
+      }
+    }
+  }
+}
+
+static void
+segmenter_cleanup (Segmenter *self)
+{
+  segmenter_remove_chunks (self);
+  g_rmdir (self->tmpdir);
+}
+
+static void
+cancelled_cb (GCancellable *cancellable, GCancellable *ours)
+{
+  g_cancellable_cancel (ours);
+}
+
+gboolean
+_gst_transcoding_segment_run_job (GstTranscodingJob *job, GCancellable *cancellable, GError **error)
+{
+  Segmenter self = { 0, };
+  GHashTableIter iter;
+  GstTranscodingOutput *output;
+  GList *values;
+  gboolean ret = FALSE;
+  gulong cancelled_id = 0;
+  guint i;
+
+  self.tmpdir = g_dir_make_tmp ("gst-transcoding-XXXXXX", error);
+  if (!self.tmpdir)
+    return FALSE;
+
+  self.job = job;
+  g_hash_table_iter_init (&iter, job->inputs);
+  g_hash_table_iter_next (&iter, NULL, (gpointer *) &self.input);
+  self.stop = self.input->stop;
+  self.copy_chunk = G_MAXUINT;
+
+  self.outputs = g_ptr_array_new ();
+  values = g_hash_table_get_values (job->outputs);
+  for (; values; values = g_list_delete_link (values, values)) {
+    output = values->data;
+    g_ptr_array_add (self.outputs, output);
+  }
+
+  self.cancellable = g_cancellable_new ();
+  if (cancellable)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (cancelled_cb),
+        g_object_ref (self.cancellable), g_object_unref);
+  self.idle_workers = g_async_queue_new_full ((GDestroyNotify) _gst_transcoding_worker_free);
+  g_mutex_init (&self.lock);
+  g_cond_init (&self.cond);
+
+  if (job->smart_render)
+    ret = segmenter_compute_smart_bounds (&self, error);
+  else
+    ret = segmenter_compute_bounds (&self, error);
+
+  ret = ret && segmenter_run_chunks (&self, error);
+
+  /* The encoder didn't produce a stream the copied video can follow */
+  if (ret && self.copy_chunk != G_MAXUINT && self.bounds->len > 1) {
+    gboolean match;
+
+    ret = segmenter_check_copied_chunk (&self, &match, error);
+
+    if (ret && !match) {
+      segmenter_remove_chunks (&self);
+      g_array_set_size (self.bounds, 1);
+      self.copy_chunk = G_MAXUINT;
+      ret = segmenter_run_chunks (&self, error);
+    }
+  }
+
+  for (i = 0; ret && i < self.outputs->len; i++)
+    ret = segmenter_stitch (&self, i, error);
+
+  segmenter_cleanup (&self);
+
+  if (cancellable)
+    g_cancellable_disconnect (cancellable, cancelled_id);
+
+  g_async_queue_unref (self.idle_workers);
+  g_mutex_clear (&self.lock);
+  g_cond_clear (&self.cond);
+  g_object_unref (self.cancellable);
+  if (self.bounds)
+    g_array_unref (self.bounds);
+  g_ptr_array_unref (self.outputs);
+  g_free (self.tmpdir);
+
+  return ret;
+}
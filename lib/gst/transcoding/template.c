@@ -0,0 +1,442 @@
+#include <string.h>
+#include "template.h"
+#include "executor-private.h"
+
+/* A template is a flattened snapshot of a job: its inputs and outputs in
+ * arrays, and its mappings as indices into those, sorted by input then
+ * output so that instantiating maps them as one batch with hardly any
+ * lookup. The settings of the profiles of the template are shared, copy on
+ * write, with those of its instances. Everything that doesn't depend on the
+ * URIs is checked once, when creating the template. */
+
+typedef struct
+{
+  /* Actual URI, or name of a placeholder */
+  gchar *uri;
+  gboolean placeholder;
+  gboolean auto_link;
+  GstClockTime start;
+  GstClockTime stop;
+} TemplateInput;
+
+typedef struct
+{
+  gchar *uri;
+  gboolean placeholder;
+  gboolean auto_link;
+  GstTranscodingContainerProfile *profile;
+  /* Indices of the inputs it plays in sequence, NULL if it doesn't */
+  GArray *sequence;
+} TemplateOutput;
+
+typedef struct
+{
+  guint input;
+  guint output;
+  gchar *stream_id;
+  GstTranscodingMediaType media_type;
+  /* Holds the settings of the mapped profile */
+  GstTranscodingStreamProfile *profile;
+} TemplateMapping;
+
+struct _GstTranscodingJobTemplate
+{
+  GObject parent;
+
+  GArray *inputs;
+  GArray *outputs;
+  GArray *mappings;
+
+  GstClockTime segment_duration;
+  gboolean smart_render;
+  guint max_workers;
+  gchar *worker_executable;
+  gchar *discovery_cache;
+  gchar *output_cache;
+};
+
+G_DEFINE_TYPE (GstTranscodingJobTemplate, gst_transcoding_job_template, G_TYPE_OBJECT)
+
+static void
+template_input_clear (TemplateInput *input)
+{
+  g_free (input->uri);
+}
+
+static void
+template_output_clear (TemplateOutput *output)
+{
+  g_free (output->uri);
+  g_object_unref (output->profile);
+  if (output->sequence)
+    g_array_unref (output->sequence);
+}
+
+static void
+template_mapping_clear (TemplateMapping *mapping)
+{
+  g_ref_string_release (mapping->stream_id);
+  g_object_unref (mapping->profile);
+}
+
+static void
+job_template_finalize (GObject *object)
+{
+  GstTranscodingJobTemplate *self = GST_TRANSCODING_JOB_TEMPLATE (object);
+
+  g_array_unref (self->inputs);
+  g_array_unref (self->outputs);
+  g_array_unref (self->mappings);
+  g_free (self->worker_executable);
+  g_free (self->discovery_cache);
+  g_free (self->output_cache);
+
+  G_OBJECT_CLASS (gst_transcoding_job_template_parent_class)->finalize (object);
+}
+
+static void
+gst_transcoding_job_template_class_init (GstTranscodingJobTemplateClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = job_template_finalize;
+}
+
+static void
+gst_transcoding_job_template_init (GstTranscodingJobTemplate *self)
+{
+  self->inputs = g_array_new (FALSE, FALSE, sizeof (TemplateInput));
+  g_array_set_clear_func (self->inputs, (GDestroyNotify) template_input_clear);
+  self->outputs = g_array_new (FALSE, FALSE, sizeof (TemplateOutput));
+  g_array_set_clear_func (self->outputs, (GDestroyNotify) template_output_clear);
+  self->mappings = g_array_new (FALSE, FALSE, sizeof (TemplateMapping));
+  g_array_set_clear_func (self->mappings, (GDestroyNotify) template_mapping_clear);
+}
+
+/* Returns the name of the placeholder @uri is, NULL if it isn't one */
+static gchar *
+parse_placeholder (const gchar *uri)
+{
+  gsize len = strlen (uri);
+
+  if (len > 2 && uri[0] == '{' && uri[len - 1] == '}')
+    return g_strndup (uri + 1, len - 2);
+
+  return NULL;
+}
+
+static GstTranscodingContainerProfile *
+container_profile_copy (GstTranscodingContainerProfile *profile)
+{
+  GstTranscodingContainerProfile *ret = gst_transcoding_container_profile_new (NULL, NULL);
+
+  ret->format = profile->format;
+  _gst_transcoding_stream_profile_copy_into ((GstTranscodingStreamProfile *) profile->meta_audio_profile,
+      (GstTranscodingStreamProfile *) ret->meta_audio_profile);
+  _gst_transcoding_stream_profile_copy_into ((GstTranscodingStreamProfile *) profile->meta_video_profile,
+      (GstTranscodingStreamProfile *) ret->meta_video_profile);
+
+  return ret;
+}
+
+static gboolean
+template_check_format (GHashTable *checked, GstElementFactoryListType type, GstTranscodingFormat format,
+                       GError **error)
+{
+  GstElementFactory *factory;
+
+  if (format == GST_TRANSCODING_FORMAT_NONE || g_hash_table_contains (checked, GUINT_TO_POINTER (format)))
+    return TRUE;
+
+  if (!(factory = _gst_transcoding_find_factory_for_format (type, format))) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_MISSING_ELEMENT,
+        "No element available to produce %s", g_quark_to_string (format));
+    return FALSE;
+  }
+
+  gst_object_unref (factory);
+  g_hash_table_add (checked, GUINT_TO_POINTER (format));
+
+  return TRUE;
+}
+
+static gboolean
+template_validate (GstTranscodingJobTemplate *self, GError **error)
+{
+  GHashTable *muxers = g_hash_table_new (NULL, NULL);
+  GHashTable *encoders = g_hash_table_new (NULL, NULL);
+  guint *n_streams = g_new0 (guint, self->outputs->len);
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < self->outputs->len && ret; i++) {
+    TemplateOutput *output = &g_array_index (self->outputs, TemplateOutput, i);
+
+    ret = template_check_format (muxers, GST_ELEMENT_FACTORY_TYPE_MUXER, output->profile->format, error);
+  }
+
+  for (i = 0; i < self->mappings->len && ret; i++) {
+    TemplateMapping *mapping = &g_array_index (self->mappings, TemplateMapping, i);
+    TemplateOutput *output = &g_array_index (self->outputs, TemplateOutput, mapping->output);
+
+    ret = template_check_format (encoders, GST_ELEMENT_FACTORY_TYPE_ENCODER,
+        _gst_transcoding_stream_profile_get_settings (mapping->profile)->format, error);
+
+    if (ret && output->profile->format == GST_TRANSCODING_FORMAT_NONE && ++n_streams[mapping->output] > 1) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED,
+          "%s can't hold %u streams", output->uri, n_streams[mapping->output]);
+      ret = FALSE;
+    }
+  }
+
+  g_free (n_streams);
+  g_hash_table_unref (encoders);
+  g_hash_table_unref (muxers);
+
+  return ret;
+}
+
+GstTranscodingJobTemplate *
+gst_transcoding_job_template_new (GstTranscodingJob *job, GError **error)
+{
+  GstTranscodingJobTemplate *self = g_object_new (GST_TRANSCODING_TYPE_JOB_TEMPLATE, NULL);
+  GHashTable *output_indices = g_hash_table_new (NULL, NULL);
+  GHashTable *input_indices = g_hash_table_new (g_str_hash, g_str_equal);
+  GList *uris, *tmp;
+  gboolean ret = TRUE;
+  guint index;
+
+  self->segment_duration = job->segment_duration;
+  self->smart_render = job->smart_render;
+  self->max_workers = job->max_workers;
+  self->worker_executable = g_strdup (job->worker_executable);
+  self->discovery_cache = g_strdup (job->discovery_cache);
+  self->output_cache = g_strdup (job->output_cache);
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs);
+
+  for (tmp = uris; tmp; tmp = tmp->next) {
+    GstTranscodingOutput *output = g_hash_table_lookup (job->outputs, tmp->data);
+    TemplateOutput toutput = { 0, };
+
+    toutput.uri = parse_placeholder (output->uri);
+    toutput.placeholder = toutput.uri != NULL;
+    if (!toutput.placeholder)
+      toutput.uri = g_strdup (output->uri);
+    toutput.auto_link = output->auto_link;
+    toutput.profile = container_profile_copy (output->profile);
+
+    g_hash_table_insert (output_indices, output, GUINT_TO_POINTER (self->outputs->len));
+    g_array_append_val (self->outputs, toutput);
+  }
+
+  g_list_free (uris);
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->inputs);
+
+  for (tmp = uris; tmp; tmp = tmp->next) {
+    GstTranscodingInput *input = g_hash_table_lookup (job->inputs, tmp->data);
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *stmp;
+    TemplateInput tinput = { 0, };
+
+    tinput.uri = parse_placeholder (input->uri);
+    tinput.placeholder = tinput.uri != NULL;
+    if (!tinput.placeholder)
+      tinput.uri = g_strdup (input->uri);
+    tinput.auto_link = input->auto_link;
+    tinput.start = input->start;
+    tinput.stop = input->stop;
+
+    for (stmp = stream_ids; stmp; stmp = stmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, stmp->data);
+      guint i;
+
+      for (i = 0; i < profiles->len; i++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+        GstTranscodingStreamProfilePrivate *priv = _gst_transcoding_stream_profile_get_private (profile);
+        TemplateMapping mapping = { 0, };
+
+        mapping.input = self->inputs->len;
+        mapping.output = GPOINTER_TO_UINT (g_hash_table_lookup (output_indices, priv->output));
+        mapping.stream_id = g_ref_string_acquire (stmp->data);
+
+        if (_gst_transcoding_stream_profile_get_media_type (profile) == VIDEO) {
+          mapping.media_type = GST_TRANSCODING_MEDIA_TYPE_VIDEO;
+          mapping.profile = (GstTranscodingStreamProfile *) gst_transcoding_video_profile_new ();
+        } else {
+          mapping.media_type = GST_TRANSCODING_MEDIA_TYPE_AUDIO;
+          mapping.profile = (GstTranscodingStreamProfile *) gst_transcoding_audio_profile_new ();
+        }
+
+        _gst_transcoding_stream_profile_copy_into (profile, mapping.profile);
+        g_array_append_val (self->mappings, mapping);
+      }
+    }
+
+    g_list_free (stream_ids);
+    g_hash_table_insert (input_indices, input->uri, GUINT_TO_POINTER (self->inputs->len));
+    g_array_append_val (self->inputs, tinput);
+  }
+
+  g_list_free (uris);
+
+  /* Outputs are in the same order as when filling the array */
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs);
+
+  for (tmp = uris, index = 0; tmp && ret; tmp = tmp->next, index++) {
+    GstTranscodingOutput *output = g_hash_table_lookup (job->outputs, tmp->data);
+    TemplateOutput *toutput = &g_array_index (self->outputs, TemplateOutput, index);
+    guint i;
+
+    if (!output->sequence)
+      continue;
+
+    toutput->sequence = g_array_new (FALSE, FALSE, sizeof (guint));
+
+    for (i = 0; output->sequence[i] && ret; i++) {
+      gpointer value;
+
+      if (g_hash_table_lookup_extended (input_indices, output->sequence[i], NULL, &value)) {
+        guint input_index = GPOINTER_TO_UINT (value);
+
+        g_array_append_val (toutput->sequence, input_index);
+      } else {
+        g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+            "%s plays unknown input %s", output->uri, output->sequence[i]);
+        ret = FALSE;
+      }
+    }
+  }
+
+  g_list_free (uris);
+  g_hash_table_unref (input_indices);
+  g_hash_table_unref (output_indices);
+
+  if (!ret || !template_validate (self, error))
+    g_clear_object (&self);
+
+  return self;
+}
+
+static const gchar *
+template_resolve (const gchar *uri, gboolean placeholder, GHashTable *bindings, GError **error)
+{
+  const gchar *ret;
+
+  if (!placeholder)
+    return uri;
+
+  if (!bindings || !(ret = g_hash_table_lookup (bindings, uri))) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+        "No URI bound to placeholder {%s}", uri);
+    return NULL;
+  }
+
+  return ret;
+}
+
+GstTranscodingJob *
+gst_transcoding_job_template_instantiate (GstTranscodingJobTemplate *self, GHashTable *bindings, GError **error)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  const gchar **input_uris = g_new (const gchar *, self->inputs->len);
+  const gchar **output_uris = g_new (const gchar *, self->outputs->len);
+  GstTranscodingStreamMapping *mappings = NULL;
+  GPtrArray *profiles = NULL;
+  gboolean ret = TRUE;
+  guint i;
+
+  job->segment_duration = self->segment_duration;
+  job->smart_render = self->smart_render;
+  job->max_workers = self->max_workers;
+  job->worker_executable = g_strdup (self->worker_executable);
+  job->discovery_cache = g_strdup (self->discovery_cache);
+  job->output_cache = g_strdup (self->output_cache);
+
+  for (i = 0; i < self->outputs->len && ret; i++) {
+    TemplateOutput *toutput = &g_array_index (self->outputs, TemplateOutput, i);
+    GstTranscodingContainerProfile *profile;
+    GstTranscodingOutput *output;
+
+    if (!(output_uris[i] = template_resolve (toutput->uri, toutput->placeholder, bindings, error))) {
+      ret = FALSE;
+      continue;
+    }
+
+    /* Only owned by the job once added */
+    profile = container_profile_copy (toutput->profile);
+    if (!(output = gst_transcoding_job_add_output (job, output_uris[i], profile))) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Several outputs bound to %s", output_uris[i]);
+      g_object_unref (profile);
+      ret = FALSE;
+    } else {
+      output->auto_link = toutput->auto_link;
+      g_object_unref (output);
+    }
+  }
+
+  for (i = 0; i < self->inputs->len && ret; i++) {
+    TemplateInput *tinput = &g_array_index (self->inputs, TemplateInput, i);
+    GstTranscodingInput *input;
+
+    if (!(input_uris[i] = template_resolve (tinput->uri, tinput->placeholder, bindings, error))) {
+      ret = FALSE;
+    } else if (!(input = gst_transcoding_job_add_input (job, input_uris[i]))) {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Several inputs bound to %s", input_uris[i]);
+      ret = FALSE;
+    } else {
+      input->auto_link = tinput->auto_link;
+      input->start = tinput->start;
+      input->stop = tinput->stop;
+      g_object_unref (input);
+    }
+  }
+
+  for (i = 0; i < self->outputs->len && ret; i++) {
+    TemplateOutput *toutput = &g_array_index (self->outputs, TemplateOutput, i);
+    GstTranscodingOutput *output;
+    guint j;
+
+    if (!toutput->sequence)
+      continue;
+
+    output = g_hash_table_lookup (job->outputs, output_uris[i]);
+    output->sequence = g_new0 (gchar *, toutput->sequence->len + 1);
+
+    for (j = 0; j < toutput->sequence->len; j++)
+      output->sequence[j] = g_strdup (input_uris[g_array_index (toutput->sequence, guint, j)]);
+  }
+
+  if (ret && self->mappings->len) {
+    mappings = g_new (GstTranscodingStreamMapping, self->mappings->len);
+
+    for (i = 0; i < self->mappings->len; i++) {
+      TemplateMapping *tmapping = &g_array_index (self->mappings, TemplateMapping, i);
+
+      mappings[i].in_uri = input_uris[tmapping->input];
+      mappings[i].stream_id = tmapping->stream_id;
+      mappings[i].media_type = tmapping->media_type;
+      mappings[i].out_uri = output_uris[tmapping->output];
+    }
+
+    /* Can't conflict, the template was a valid job */
+    profiles = gst_transcoding_job_map_streams (job, mappings, self->mappings->len, error);
+    ret = profiles != NULL;
+
+    for (i = 0; ret && i < profiles->len; i++)
+      _gst_transcoding_stream_profile_copy_into (g_array_index (self->mappings, TemplateMapping, i).profile,
+          g_ptr_array_index (profiles, i));
+  }
+
+  if (profiles)
+    g_ptr_array_unref (profiles);
+  g_free (mappings);
+  g_free (output_uris);
+  g_free (input_uris);
+
+  if (!ret)
+    g_clear_object (&job);
+
+  return job;
+}
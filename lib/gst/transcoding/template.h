@@ -0,0 +1,25 @@
+#pragma once
+
+#include "job.h"
+
+G_BEGIN_DECLS
+
+#define GST_TRANSCODING_TYPE_JOB_TEMPLATE gst_transcoding_job_template_get_type ()
+G_DECLARE_FINAL_TYPE(GstTranscodingJobTemplate, gst_transcoding_job_template, GST_TRANSCODING, JOB_TEMPLATE, GObject)
+
+/* Captures the inputs, outputs, mappings, profiles and settings of @job,
+ * which isn't referenced and can be modified or dropped afterwards. Input
+ * and output URIs of the form "{name}" are placeholders, bound to actual
+ * URIs when instantiating the template. Fails if the job could never run,
+ * whatever the URIs: missing encoders or muxers, outputs without a
+ * container holding several streams. gst_init() must have been called. */
+GstTranscodingJobTemplate * gst_transcoding_job_template_new (GstTranscodingJob *job, GError **error);
+
+/* Creates a job of the shape of the template, @bindings mapping the name
+ * of each placeholder to its URI. Templates can be instantiated from
+ * several threads at once. */
+GstTranscodingJob * gst_transcoding_job_template_instantiate (GstTranscodingJobTemplate *self,
+                                                              GHashTable *bindings,
+                                                              GError **error);
+
+G_END_DECLS
@@ -0,0 +1,315 @@
+#include <string.h>
+#include "executor-private.h"
+
+/* Binary job format: the 4 bytes magic, the format version as a 32 bits
+ * little endian integer, then a little endian serialized GVariant of
+ * JOB_FORMAT, 8 bytes aligned so it can be used in place from a mapped
+ * file:
+ *
+ * - outputs: uri, autolink, container profile settings, meta audio and
+ *   meta video profile settings, the inputs it plays in sequence (empty
+ *   if it doesn't)
+ * - inputs: uri, autolink, start, stop, then for each stream its id, its
+ *   media type, and its profiles as the index of their output and their
+ *   settings
+ *
+ * Version 2 added the sequences of the outputs, version 1 jobs are rejected.
+ */
+
+#define JOB_MAGIC "GTJB"
+#define JOB_VERSION 2
+#define JOB_HEADER_SIZE 8
+#define JOB_FORMAT "(a(sba{sv}a{sv}a{sv}as)a(sbtta(sya(ua{sv}))))"
+
+static GVariant *
+container_profile_to_variant (GstTranscodingContainerProfile *profile)
+{
+  GVariantBuilder builder;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (&builder, "{sv}", "format", g_variant_new_string (g_quark_to_string (profile->format)));
+
+  return g_variant_builder_end (&builder);
+}
+
+static GVariant *
+job_to_variant (GstTranscodingJob *job)
+{
+  GList *uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs), *tmp;
+  GHashTable *output_indices = g_hash_table_new (NULL, NULL);
+  GVariantBuilder outputs_builder, inputs_builder;
+
+  g_variant_builder_init (&outputs_builder, G_VARIANT_TYPE ("a(sba{sv}a{sv}a{sv}as)"));
+  g_variant_builder_init (&inputs_builder, G_VARIANT_TYPE ("a(sbtta(sya(ua{sv})))"));
+
+  for (tmp = uris; tmp; tmp = tmp->next) {
+    GstTranscodingOutput *output = g_hash_table_lookup (job->outputs, tmp->data);
+    GstTranscodingContainerProfile *profile = output->profile;
+
+    g_hash_table_insert (output_indices, output, GUINT_TO_POINTER (g_hash_table_size (output_indices)));
+    g_variant_builder_add (&outputs_builder, "(sb@a{sv}@a{sv}@a{sv}@as)", output->uri, output->auto_link,
+        container_profile_to_variant (profile),
+        _gst_transcoding_stream_profile_settings_to_variant ((GstTranscodingStreamProfile *) profile->meta_audio_profile),
+        _gst_transcoding_stream_profile_settings_to_variant ((GstTranscodingStreamProfile *) profile->meta_video_profile),
+        g_variant_new_strv ((const gchar * const *) output->sequence, -1));
+  }
+
+  g_list_free (uris);
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->inputs);
+
+  for (tmp = uris; tmp; tmp = tmp->next) {
+    GstTranscodingInput *input = g_hash_table_lookup (job->inputs, tmp->data);
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *stmp;
+
+    g_variant_builder_open (&inputs_builder, G_VARIANT_TYPE ("(sbtta(sya(ua{sv})))"));
+    g_variant_builder_add (&inputs_builder, "s", input->uri);
+    g_variant_builder_add (&inputs_builder, "b", input->auto_link);
+    g_variant_builder_add (&inputs_builder, "t", input->start);
+    g_variant_builder_add (&inputs_builder, "t", input->stop);
+    g_variant_builder_open (&inputs_builder, G_VARIANT_TYPE ("a(sya(ua{sv}))"));
+
+    for (stmp = stream_ids; stmp; stmp = stmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, stmp->data);
+      guint i;
+
+      g_variant_builder_open (&inputs_builder, G_VARIANT_TYPE ("(sya(ua{sv}))"));
+      g_variant_builder_add (&inputs_builder, "s", stmp->data);
+      g_variant_builder_add (&inputs_builder, "y",
+          (guchar) _gst_transcoding_stream_profile_get_media_type (g_ptr_array_index (profiles, 0)));
+      g_variant_builder_open (&inputs_builder, G_VARIANT_TYPE ("a(ua{sv})"));
+
+      for (i = 0; i < profiles->len; i++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, i);
+        GstTranscodingOutput *output = _gst_transcoding_stream_profile_get_private (profile)->output;
+
+        g_variant_builder_add (&inputs_builder, "(u@a{sv})",
+            GPOINTER_TO_UINT (g_hash_table_lookup (output_indices, output)),
+            _gst_transcoding_stream_profile_settings_to_variant (profile));
+      }
+
+      g_variant_builder_close (&inputs_builder);
+      g_variant_builder_close (&inputs_builder);
+    }
+
+    g_variant_builder_close (&inputs_builder);
+    g_variant_builder_close (&inputs_builder);
+    g_list_free (stream_ids);
+  }
+
+  g_list_free (uris);
+  g_hash_table_unref (output_indices);
+
+  return g_variant_new (JOB_FORMAT, &outputs_builder, &inputs_builder);
+}
+
+GBytes *
+gst_transcoding_job_to_bytes (GstTranscodingJob *self)
+{
+  GVariant *variant = g_variant_ref_sink (job_to_variant (self));
+  gsize size = g_variant_get_size (variant);
+  guint32 version = GUINT32_TO_LE (JOB_VERSION);
+  guint8 *data = g_malloc (JOB_HEADER_SIZE + size);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (variant);
+
+    g_variant_unref (variant);
+    variant = swapped;
+  }
+
+  memcpy (data, JOB_MAGIC, 4);
+  memcpy (data + 4, &version, 4);
+  g_variant_store (variant, data + JOB_HEADER_SIZE);
+  g_variant_unref (variant);
+
+  return g_bytes_new_take (data, JOB_HEADER_SIZE + size);
+}
+
+static gboolean
+job_add_outputs (GstTranscodingJob *job, GVariant *outputs, GPtrArray *uris, GError **error)
+{
+  GVariant *container, *meta_audio, *meta_video, *sequence;
+  GVariantIter iter;
+  const gchar *uri;
+  gboolean auto_link;
+
+  g_variant_iter_init (&iter, outputs);
+  while (g_variant_iter_next (&iter, "(&sb@a{sv}@a{sv}@a{sv}@as)", &uri, &auto_link, &container, &meta_audio, &meta_video,
+             &sequence)) {
+    GstTranscodingContainerProfile *profile = gst_transcoding_container_profile_new (NULL, NULL);
+    GstTranscodingOutput *output;
+    const gchar *format;
+    gchar **uris_in_sequence = NULL;
+
+    if (g_variant_n_children (sequence))
+      uris_in_sequence = g_variant_dup_strv (sequence, NULL);
+    if (g_variant_lookup (container, "format", "&s", &format))
+      profile->format = g_quark_from_string (format);
+    _gst_transcoding_stream_profile_settings_from_variant ((GstTranscodingStreamProfile *) profile->meta_audio_profile,
+        meta_audio);
+    _gst_transcoding_stream_profile_settings_from_variant ((GstTranscodingStreamProfile *) profile->meta_video_profile,
+        meta_video);
+
+    g_variant_unref (container);
+    g_variant_unref (meta_audio);
+    g_variant_unref (meta_video);
+    g_variant_unref (sequence);
+
+    output = gst_transcoding_job_add_output (job, uri, profile);
+    if (!output) {
+      g_strfreev (uris_in_sequence);
+      g_object_unref (profile);
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE, "Duplicate output %s", uri);
+      return FALSE;
+    }
+
+    output->auto_link = auto_link;
+    output->sequence = uris_in_sequence;
+    g_ptr_array_add (uris, (gpointer) uri);
+    g_object_unref (output);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+job_add_inputs (GstTranscodingJob *job, GVariant *inputs, GPtrArray *uris, GError **error)
+{
+  GVariantIter iter, *streams, *profiles;
+  const gchar *uri, *stream_id;
+  GstClockTime start, stop;
+  gboolean auto_link;
+  guchar media_type;
+  GVariant *settings;
+  guint index;
+
+  g_variant_iter_init (&iter, inputs);
+  while (g_variant_iter_next (&iter, "(&sbtta(sya(ua{sv})))", &uri, &auto_link, &start, &stop, &streams)) {
+    GstTranscodingInput *input = gst_transcoding_job_add_input (job, uri);
+
+    if (!input) {
+      g_variant_iter_free (streams);
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE, "Duplicate input %s", uri);
+      return FALSE;
+    }
+
+    input->auto_link = auto_link;
+    input->start = start;
+    input->stop = stop;
+    g_object_unref (input);
+
+    while (g_variant_iter_next (streams, "(&sya(ua{sv}))", &stream_id, &media_type, &profiles)) {
+      while (g_variant_iter_next (profiles, "(u@a{sv})", &index, &settings)) {
+        GstTranscodingStreamProfile *profile = NULL;
+
+        if (index < uris->len) {
+          if (media_type == VIDEO)
+            profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, uri, stream_id,
+                g_ptr_array_index (uris, index));
+          else
+            profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, uri, stream_id,
+                g_ptr_array_index (uris, index));
+        }
+
+        if (profile) {
+          _gst_transcoding_stream_profile_settings_from_variant (profile, settings);
+          g_object_unref (profile);
+        }
+
+        g_variant_unref (settings);
+
+        if (!profile) {
+          g_variant_iter_free (profiles);
+          g_variant_iter_free (streams);
+          g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE,
+              "Invalid mapping of stream %s of %s", stream_id, uri);
+          return FALSE;
+        }
+      }
+
+      g_variant_iter_free (profiles);
+    }
+
+    g_variant_iter_free (streams);
+  }
+
+  return TRUE;
+}
+
+GstTranscodingJob *
+gst_transcoding_job_from_bytes (GBytes *bytes, GError **error)
+{
+  GstTranscodingJob *job;
+  GVariant *variant, *outputs, *inputs;
+  const guint8 *data;
+  GBytes *body;
+  GPtrArray *uris;
+  guint32 version;
+  gsize size;
+  gboolean ret;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  if (size < JOB_HEADER_SIZE || memcmp (data, JOB_MAGIC, 4)) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE, "Not a serialized job");
+    return NULL;
+  }
+
+  memcpy (&version, data + 4, 4);
+  version = GUINT32_FROM_LE (version);
+  if (version != JOB_VERSION) {
+    g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE,
+        "Unsupported job format version %u", version);
+    return NULL;
+  }
+
+  /* Untrusted, so that malformed data is read as default values instead of
+   * crashing us */
+  body = g_bytes_new_from_bytes (bytes, JOB_HEADER_SIZE, size - JOB_HEADER_SIZE);
+  variant = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (JOB_FORMAT), body, FALSE));
+  g_bytes_unref (body);
+
+  if (G_BYTE_ORDER == G_BIG_ENDIAN) {
+    GVariant *swapped = g_variant_byteswap (variant);
+
+    g_variant_unref (variant);
+    variant = swapped;
+  }
+
+  job = gst_transcoding_job_new ();
+  /* Points into the variant, which outlives it */
+  uris = g_ptr_array_new ();
+  outputs = g_variant_get_child_value (variant, 0);
+  inputs = g_variant_get_child_value (variant, 1);
+
+  ret = job_add_outputs (job, outputs, uris, error) && job_add_inputs (job, inputs, uris, error);
+
+  g_variant_unref (outputs);
+  g_variant_unref (inputs);
+  g_ptr_array_unref (uris);
+  g_variant_unref (variant);
+
+  if (!ret)
+    g_clear_object (&job);
+
+  return job;
+}
+
+GstTranscodingJob *
+gst_transcoding_job_from_file (const gchar *path, GError **error)
+{
+  GMappedFile *file = g_mapped_file_new (path, FALSE, error);
+  GstTranscodingJob *ret;
+  GBytes *bytes;
+
+  if (!file)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  ret = gst_transcoding_job_from_bytes (bytes, error);
+
+  g_bytes_unref (bytes);
+  g_mapped_file_unref (file);
+
+  return ret;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "executor-private.h"
+
+G_BEGIN_DECLS
+
+/* A worker process, and our end of the socket connecting us to it */
+typedef struct _GstTranscodingWorker GstTranscodingWorker;
+
+G_GNUC_INTERNAL
+GstTranscodingWorker * _gst_transcoding_worker_spawn (const gchar *executable, GError **error);
+
+G_GNUC_INTERNAL
+void _gst_transcoding_worker_free (GstTranscodingWorker *self);
+
+/* Runs @job in the worker, its outputs are streamed back to us. Errors in
+ * the GST_TRANSCODING_ERROR domain are failures of the job itself, the
+ * worker can be reused after those. */
+G_GNUC_INTERNAL
+gboolean _gst_transcoding_worker_run_job (GstTranscodingWorker *self,
+                                          GstTranscodingJob *job,
+                                          GCancellable *cancellable,
+                                          GError **error);
+
+G_END_DECLS
@@ -0,0 +1,528 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "worker-private.h"
+
+/* Coordinator / worker protocol, over a Unix domain socket pair.
+ *
+ * Every message is a 32 bits big endian type, a 32 bits big endian size and
+ * a serialized GVariant of that size:
+ *
+ * - TASK, coordinator to worker: a job to run, with the encoder threads and
+ *   queue size it was given, see task_from_job()
+ * - DATA (u, ay), worker to coordinator: bytes of the output at that index
+ * - DONE (b, s), worker to coordinator: whether the task succeeded, and why
+ *   not
+ *
+ * The worker writes its outputs to local files first, and streams them
+ * back once the task has succeeded, the coordinator writes them to the
+ * outputs of its own job.
+ *
+ * Only failures reported with DONE come as GST_TRANSCODING_ERROR, anything
+ * else means the worker died or can't be trusted anymore.
+ */
+
+#define DATA_CHUNK_SIZE (64 * 1024)
+
+/* Larger sizes can only come from a broken peer, they are refused before
+ * anything is allocated. DATA only adds the output index to its chunk. */
+#define MAX_DATA_MESSAGE_SIZE (DATA_CHUNK_SIZE + 64)
+#define MAX_MESSAGE_SIZE (16 * 1024 * 1024)
+
+typedef enum
+{
+  MESSAGE_TASK = 1,
+  MESSAGE_DATA,
+  MESSAGE_DONE,
+} MessageType;
+
+#define TASK_FORMAT "(uua(stt)a(ss)a(ssyua{sv}))"
+
+struct _GstTranscodingWorker
+{
+  GSubprocess *process;
+  GSocketConnection *connection;
+};
+
+static gboolean
+write_message (GOutputStream *out, MessageType type, GVariant *payload,
+               GCancellable *cancellable, GError **error)
+{
+  guint32 header[2];
+  gboolean ret;
+
+  g_variant_ref_sink (payload);
+
+  header[0] = GUINT32_TO_BE (type);
+  header[1] = GUINT32_TO_BE ((guint32) g_variant_get_size (payload));
+
+  ret = g_output_stream_write_all (out, header, sizeof (header), NULL, cancellable, error) &&
+    g_output_stream_write_all (out, g_variant_get_data (payload), g_variant_get_size (payload),
+        NULL, cancellable, error);
+
+  g_variant_unref (payload);
+
+  return ret;
+}
+
+/* Returns NULL without setting @error when the peer closed the connection
+ * between two messages */
+static GVariant *
+read_message (GInputStream *in, MessageType *type, GCancellable *cancellable, GError **error)
+{
+  guint32 header[2];
+  gsize size, max_size, n_read;
+  gpointer data;
+  const GVariantType *vtype;
+
+  if (!g_input_stream_read_all (in, header, sizeof (header), &n_read, cancellable, error))
+    return NULL;
+
+  if (n_read == 0)
+    return NULL;
+
+  if (n_read != sizeof (header))
+    goto closed;
+
+  *type = GUINT32_FROM_BE (header[0]);
+  size = GUINT32_FROM_BE (header[1]);
+
+  switch (*type) {
+    case MESSAGE_TASK:
+      vtype = G_VARIANT_TYPE (TASK_FORMAT);
+      max_size = MAX_MESSAGE_SIZE;
+      break;
+    case MESSAGE_DATA:
+      vtype = G_VARIANT_TYPE ("(uay)");
+      max_size = MAX_DATA_MESSAGE_SIZE;
+      break;
+    case MESSAGE_DONE:
+      vtype = G_VARIANT_TYPE ("(bs)");
+      max_size = MAX_MESSAGE_SIZE;
+      break;
+    default:
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Unknown message type %u", *type);
+      return NULL;
+  }
+
+  if (size > max_size) {
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+        "Message of type %u too large (%" G_GSIZE_FORMAT " bytes)", *type, size);
+    return NULL;
+  }
+
+  data = g_malloc (size);
+
+  if (!g_input_stream_read_all (in, data, size, &n_read, cancellable, error)) {
+    g_free (data);
+    return NULL;
+  }
+
+  if (n_read != size) {
+    g_free (data);
+    goto closed;
+  }
+
+  return g_variant_ref_sink (g_variant_new_from_data (vtype, data, size, FALSE, g_free, data));
+
+closed:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "Connection closed mid-message");
+  return NULL;
+}
+
+/* Outputs of @job, sorted by URI, their index is how results refer to them */
+static GPtrArray *
+job_get_sorted_outputs (GstTranscodingJob *job)
+{
+  GList *uris = _gst_transcoding_hash_table_get_sorted_keys (job->outputs), *tmp;
+  GPtrArray *ret = g_ptr_array_new ();
+
+  for (tmp = uris; tmp; tmp = tmp->next)
+    g_ptr_array_add (ret, g_hash_table_lookup (job->outputs, tmp->data));
+
+  g_list_free (uris);
+
+  return ret;
+}
+
+static GVariant *
+task_from_job (GstTranscodingJob *job)
+{
+  GPtrArray *outputs = job_get_sorted_outputs (job);
+  GVariantBuilder inputs_builder, outputs_builder, mappings_builder;
+  GList *uris, *tmp;
+  guint i;
+
+  g_variant_builder_init (&inputs_builder, G_VARIANT_TYPE ("a(stt)"));
+  g_variant_builder_init (&outputs_builder, G_VARIANT_TYPE ("a(ss)"));
+  g_variant_builder_init (&mappings_builder, G_VARIANT_TYPE ("a(ssyua{sv})"));
+
+  for (i = 0; i < outputs->len; i++) {
+    GstTranscodingOutput *output = g_ptr_array_index (outputs, i);
+
+    g_variant_builder_add (&outputs_builder, "(ss)", output->uri,
+        g_quark_to_string (output->profile->format));
+  }
+
+  uris = _gst_transcoding_hash_table_get_sorted_keys (job->inputs);
+
+  for (tmp = uris; tmp; tmp = tmp->next) {
+    GstTranscodingInput *input = g_hash_table_lookup (job->inputs, tmp->data);
+    GList *stream_ids = _gst_transcoding_hash_table_get_sorted_keys (input->profiles), *stmp;
+
+    g_variant_builder_add (&inputs_builder, "(stt)", input->uri, input->start, input->stop);
+
+    for (stmp = stream_ids; stmp; stmp = stmp->next) {
+      GPtrArray *profiles = g_hash_table_lookup (input->profiles, stmp->data);
+      guint j;
+
+      for (j = 0; j < profiles->len; j++) {
+        GstTranscodingStreamProfile *profile = g_ptr_array_index (profiles, j);
+        GstTranscodingOutput *output = _gst_transcoding_stream_profile_get_private (profile)->output;
+        guint index;
+
+        for (index = 0; g_ptr_array_index (outputs, index) != output; index++);
+
+        g_variant_builder_add (&mappings_builder, "(ssyu@a{sv})", input->uri, stmp->data,
+            (guchar) _gst_transcoding_stream_profile_get_media_type (profile), index,
+            _gst_transcoding_stream_profile_settings_to_variant (profile));
+      }
+    }
+
+    g_list_free (stream_ids);
+  }
+
+  g_list_free (uris);
+  g_ptr_array_unref (outputs);
+
+  return g_variant_new (TASK_FORMAT, job->encoder_threads, job->queue_max_bytes,
+      &inputs_builder, &outputs_builder, &mappings_builder);
+}
+
+/* Rebuilds the job of @task, with its outputs written to @tmpdir, the paths
+ * of which are added to @paths */
+static GstTranscodingJob *
+task_to_job (GVariant *task, const gchar *tmpdir, GPtrArray *paths)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GVariantIter *inputs, *outputs, *mappings;
+  GPtrArray *uris = g_ptr_array_new_with_free_func (g_free);
+  const gchar *uri, *format, *stream_id;
+  GstClockTime start, stop;
+  GVariant *settings;
+  guchar media_type;
+  guint index;
+
+  g_variant_get (task, TASK_FORMAT, &job->encoder_threads, &job->queue_max_bytes, &inputs, &outputs, &mappings);
+
+  while (g_variant_iter_next (outputs, "(&s&s)", &uri, &format)) {
+    GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+    gchar *filename = g_strdup_printf ("output-%03u", paths->len);
+    gchar *path = g_build_filename (tmpdir, filename, NULL);
+    gchar *local_uri = gst_filename_to_uri (path, NULL);
+
+    gst_transcoding_container_profile_set_format (cprof, g_quark_from_string (format));
+    g_object_unref (gst_transcoding_job_add_output (job, local_uri, cprof));
+
+    g_ptr_array_add (paths, path);
+    g_ptr_array_add (uris, local_uri);
+    g_free (filename);
+  }
+
+  while (g_variant_iter_next (mappings, "(&s&syu@a{sv})", &uri, &stream_id, &media_type, &index, &settings)) {
+    GstTranscodingStreamProfile *profile = NULL;
+
+    if (index < uris->len) {
+      if (media_type == VIDEO)
+        profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_video_stream (job, uri, stream_id,
+            g_ptr_array_index (uris, index));
+      else
+        profile = (GstTranscodingStreamProfile *) gst_transcoding_job_map_audio_stream (job, uri, stream_id,
+            g_ptr_array_index (uris, index));
+    }
+
+    if (profile) {
+      _gst_transcoding_stream_profile_settings_from_variant (profile, settings);
+      g_object_unref (profile);
+    }
+
+    g_variant_unref (settings);
+  }
+
+  while (g_variant_iter_next (inputs, "(&stt)", &uri, &start, &stop)) {
+    GstTranscodingInput *input = g_hash_table_lookup (job->inputs, uri);
+
+    if (input) {
+      input->start = start;
+      input->stop = stop;
+    }
+  }
+
+  g_variant_iter_free (inputs);
+  g_variant_iter_free (outputs);
+  g_variant_iter_free (mappings);
+  g_ptr_array_unref (uris);
+
+  return job;
+}
+
+static gboolean
+worker_send_file (GOutputStream *out, guint index, const gchar *path, GError **error)
+{
+  GMappedFile *file = g_mapped_file_new (path, FALSE, error);
+  const guint8 *data;
+  gsize size, offset;
+  gboolean ret = TRUE;
+
+  if (!file)
+    return FALSE;
+
+  data = (const guint8 *) g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+
+  for (offset = 0; offset < size && ret; offset += DATA_CHUNK_SIZE) {
+    gsize len = MIN (DATA_CHUNK_SIZE, size - offset);
+
+    ret = write_message (out, MESSAGE_DATA, g_variant_new ("(u@ay)", index,
+            g_variant_new_fixed_array (G_VARIANT_TYPE_BYTE, data + offset, len, 1)), NULL, error);
+  }
+
+  g_mapped_file_unref (file);
+
+  return ret;
+}
+
+static gboolean
+worker_handle_task (GOutputStream *out, GVariant *task, GError **error)
+{
+  GPtrArray *paths = g_ptr_array_new_with_free_func (g_free);
+  GstTranscodingJob *job;
+  GError *job_error = NULL;
+  gchar *tmpdir;
+  gboolean ret = TRUE;
+  gboolean success;
+  guint i;
+
+  tmpdir = g_dir_make_tmp ("gst-transcoding-worker-XXXXXX", error);
+  if (!tmpdir) {
+    g_ptr_array_unref (paths);
+    return FALSE;
+  }
+
+  job = task_to_job (task, tmpdir, paths);
+  success = _gst_transcoding_executor_run_job (job, NULL, &job_error);
+  g_object_unref (job);
+
+  for (i = 0; success && ret && i < paths->len; i++)
+    ret = worker_send_file (out, i, g_ptr_array_index (paths, i), error);
+
+  if (ret)
+    ret = write_message (out, MESSAGE_DONE,
+        g_variant_new ("(bs)", success, job_error ? job_error->message : ""), NULL, error);
+
+  for (i = 0; i < paths->len; i++)
+    g_remove (g_ptr_array_index (paths, i));
+  g_rmdir (tmpdir);
+
+  g_clear_error (&job_error);
+  g_ptr_array_unref (paths);
+  g_free (tmpdir);
+
+  return ret;
+}
+
+gboolean
+gst_transcoding_worker_main (gint fd, GError **error)
+{
+  GSocket *socket = g_socket_new_from_fd (fd, error);
+  GSocketConnection *connection;
+  GInputStream *in;
+  GOutputStream *out;
+  gboolean ret = TRUE;
+
+  if (!socket)
+    return FALSE;
+
+  connection = g_socket_connection_factory_create_connection (socket);
+  in = g_io_stream_get_input_stream (G_IO_STREAM (connection));
+  out = g_io_stream_get_output_stream (G_IO_STREAM (connection));
+
+  while (ret) {
+    GError *read_error = NULL;
+    MessageType type;
+    GVariant *msg = read_message (in, &type, NULL, &read_error);
+
+    if (!msg) {
+      /* The coordinator is done with us */
+      if (read_error) {
+        g_propagate_error (error, read_error);
+        ret = FALSE;
+      }
+      break;
+    }
+
+    if (type == MESSAGE_TASK) {
+      ret = worker_handle_task (out, msg, error);
+    } else {
+      g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED,
+          "Unexpected message type %u", type);
+      ret = FALSE;
+    }
+
+    g_variant_unref (msg);
+  }
+
+  g_object_unref (connection);
+  g_object_unref (socket);
+
+  return ret;
+}
+
+GstTranscodingWorker *
+_gst_transcoding_worker_spawn (const gchar *executable, GError **error)
+{
+  GstTranscodingWorker *self;
+  GSubprocessLauncher *launcher;
+  GSubprocess *process;
+  GSocket *socket;
+  int fds[2];
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+        "Could not create a socket pair: %s", g_strerror (errno));
+    return NULL;
+  }
+
+  /* The worker finds its end of the pair as fd 3 */
+  launcher = g_subprocess_launcher_new (G_SUBPROCESS_FLAGS_NONE);
+  g_subprocess_launcher_take_fd (launcher, fds[1], 3);
+  process = g_subprocess_launcher_spawn (launcher, error, executable, "--fd", "3", NULL);
+  g_object_unref (launcher);
+
+  if (!process) {
+    close (fds[0]);
+    return NULL;
+  }
+
+  socket = g_socket_new_from_fd (fds[0], error);
+  if (!socket) {
+    close (fds[0]);
+    g_subprocess_force_exit (process);
+    g_object_unref (process);
+    return NULL;
+  }
+
+  self = g_new0 (GstTranscodingWorker, 1);
+  self->process = process;
+  self->connection = g_socket_connection_factory_create_connection (socket);
+  g_object_unref (socket);
+
+  return self;
+}
+
+void
+_gst_transcoding_worker_free (GstTranscodingWorker *self)
+{
+  /* Closing the connection makes an idle worker exit, a busy or stuck one
+   * gets killed */
+  g_io_stream_close (G_IO_STREAM (self->connection), NULL, NULL);
+  g_object_unref (self->connection);
+
+  g_subprocess_force_exit (self->process);
+  g_subprocess_wait (self->process, NULL, NULL);
+  g_object_unref (self->process);
+
+  g_free (self);
+}
+
+static GOutputStream *
+open_output (GstTranscodingOutput *output, GError **error)
+{
+  GFile *file = g_file_new_for_uri (output->uri);
+  GOutputStream *ret;
+
+  ret = (GOutputStream *) g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+  g_object_unref (file);
+
+  return ret;
+}
+
+gboolean
+_gst_transcoding_worker_run_job (GstTranscodingWorker *self, GstTranscodingJob *job,
+                                 GCancellable *cancellable, GError **error)
+{
+  GInputStream *in = g_io_stream_get_input_stream (G_IO_STREAM (self->connection));
+  GOutputStream *out = g_io_stream_get_output_stream (G_IO_STREAM (self->connection));
+  GPtrArray *outputs = job_get_sorted_outputs (job);
+  GOutputStream **streams = g_new0 (GOutputStream *, outputs->len);
+  gboolean ret, done = FALSE;
+  guint i;
+
+  ret = write_message (out, MESSAGE_TASK, task_from_job (job), cancellable, error);
+
+  while (ret && !done) {
+    MessageType type;
+    GVariant *msg = read_message (in, &type, cancellable, error);
+
+    if (!msg) {
+      if (error && !*error)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED, "Worker exited");
+      ret = FALSE;
+      break;
+    }
+
+    if (type == MESSAGE_DATA) {
+      GVariant *bytes;
+      const guint8 *data;
+      gsize size;
+      guint index;
+
+      g_variant_get (msg, "(u@ay)", &index, &bytes);
+      data = g_variant_get_fixed_array (bytes, &size, 1);
+
+      if (index >= outputs->len) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+            "Worker sent data for unknown output %u", index);
+        ret = FALSE;
+      } else if (!streams[index] && !(streams[index] = open_output (g_ptr_array_index (outputs, index), error))) {
+        ret = FALSE;
+      } else {
+        ret = g_output_stream_write_all (streams[index], data, size, NULL, cancellable, error);
+      }
+
+      g_variant_unref (bytes);
+    } else if (type == MESSAGE_DONE) {
+      const gchar *message;
+      gboolean success;
+
+      g_variant_get (msg, "(b&s)", &success, &message);
+
+      if (!success) {
+        g_set_error (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED, "%s", message);
+        ret = FALSE;
+      }
+
+      done = TRUE;
+    } else {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Unexpected message type %u", type);
+      ret = FALSE;
+    }
+
+    g_variant_unref (msg);
+  }
+
+  for (i = 0; i < outputs->len; i++) {
+    if (streams[i]) {
+      if (!g_output_stream_close (streams[i], NULL, ret ? error : NULL))
+        ret = FALSE;
+      g_object_unref (streams[i]);
+    }
+  }
+
+  g_free (streams);
+  g_ptr_array_unref (outputs);
+
+  return ret;
+}
@@ -0,0 +1,1521 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/transcoding/job.h>
+
+static GstTranscodingJob *
+create_missing_input_job (gchar **out_dir)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingVideoProfile *vprof;
+  gchar *out_path, *out_uri;
+
+  *out_dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  fail_unless (*out_dir != NULL);
+  out_path = g_build_filename (*out_dir, "out.mkv", NULL);
+  out_uri = gst_filename_to_uri (out_path, NULL);
+
+  vprof = gst_transcoding_job_map_video_stream (job, "file:///this/does/not/exist.mkv", "stream-id", out_uri);
+  fail_unless (vprof != NULL);
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_H264);
+  g_object_unref (vprof);
+
+  g_free (out_uri);
+  g_free (out_path);
+
+  return job;
+}
+
+static void
+remove_dir (gchar *dir)
+{
+  gchar *out_path = g_build_filename (dir, "out.mkv", NULL);
+
+  g_remove (out_path);
+  g_rmdir (dir);
+  g_free (out_path);
+  g_free (dir);
+}
+
+GST_START_TEST (test_run_missing_input)
+{
+  gchar *dir;
+  GstTranscodingJob *job = create_missing_input_job (&dir);
+  GError *error = NULL;
+
+  /* Running a job whose input can't be read fails, and tells us why */
+  fail_if (gst_transcoding_job_run (job, NULL, &error));
+  fail_unless (error != NULL);
+  g_error_free (error);
+
+  g_object_unref (job);
+  remove_dir (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_smart_render_missing_input)
+{
+  gchar *dir;
+  GstTranscodingJob *job = create_missing_input_job (&dir);
+  GError *error = NULL;
+  gchar *out_path = g_build_filename (dir, "out.mkv", NULL);
+
+  /* Scanning the input for its keyframes fails before anything is written */
+  gst_transcoding_job_set_smart_render (job, TRUE);
+  fail_if (gst_transcoding_job_run (job, NULL, &error));
+  fail_unless (error != NULL);
+  g_error_free (error);
+  fail_if (g_file_test (out_path, G_FILE_TEST_EXISTS));
+
+  g_free (out_path);
+  g_object_unref (job);
+  remove_dir (dir);
+}
+
+GST_END_TEST;
+
+static void
+run_done_cb (GstTranscodingJob *job, GAsyncResult *result, GMainLoop *loop)
+{
+  GError *error = NULL;
+
+  fail_if (gst_transcoding_job_run_finish (job, result, &error));
+  fail_unless (error != NULL);
+  g_error_free (error);
+
+  g_main_loop_quit (loop);
+}
+
+GST_START_TEST (test_run_async_missing_input)
+{
+  gchar *dir;
+  GstTranscodingJob *job = create_missing_input_job (&dir);
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+
+  gst_transcoding_job_run_async (job, NULL, (GAsyncReadyCallback) run_done_cb, loop);
+  g_main_loop_run (loop);
+
+  g_main_loop_unref (loop);
+  g_object_unref (job);
+  remove_dir (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_auto_link_missing_input)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingInput *input;
+  GstTranscodingOutput *output;
+  GError *error = NULL;
+
+  /* Nothing to link without an auto-link output */
+  input = gst_transcoding_job_add_input (job, "file:///this/does/not/exist.mkv");
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, &error));
+  g_assert_no_error (error);
+
+  /* Inputs that can't be probed make the whole pass fail */
+  output = gst_transcoding_job_add_output (job, "file:///this/does/not/exist/either.mkv", NULL);
+  fail_if (gst_transcoding_job_auto_link (job, 2, NULL, &error));
+  fail_unless (error != NULL);
+  g_error_free (error);
+
+  g_object_unref (output);
+  g_object_unref (input);
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+#define WAV_RATE 8000
+#define WAV_HEADER_SIZE 44
+
+/* Whether all the elements of the NULL terminated list are available, tests
+ * needing some that aren't are skipped */
+static G_GNUC_NULL_TERMINATED gboolean
+have_elements (const gchar *name, ...)
+{
+  gboolean ret = TRUE;
+  va_list args;
+
+  va_start (args, name);
+  for (; name && ret; name = va_arg (args, const gchar *))
+    ret = gst_registry_check_feature_version (gst_registry_get (), name, 1, 0, 0);
+  va_end (args);
+
+  return ret;
+}
+
+/* One second of 16 bits mono PCM, each sample holding its index so that
+ * where data comes from can be told */
+static gchar *
+create_wav (const gchar *dir)
+{
+  gchar *path = g_build_filename (dir, "in.wav", NULL);
+  guint32 data_size = WAV_RATE * 2;
+  guint8 *wav = g_malloc0 (WAV_HEADER_SIZE + data_size);
+  guint i;
+
+  memcpy (wav, "RIFF", 4);
+  GST_WRITE_UINT32_LE (wav + 4, 36 + data_size);
+  memcpy (wav + 8, "WAVEfmt ", 8);
+  GST_WRITE_UINT32_LE (wav + 16, 16);
+  GST_WRITE_UINT16_LE (wav + 20, 1);
+  GST_WRITE_UINT16_LE (wav + 22, 1);
+  GST_WRITE_UINT32_LE (wav + 24, WAV_RATE);
+  GST_WRITE_UINT32_LE (wav + 28, WAV_RATE * 2);
+  GST_WRITE_UINT16_LE (wav + 32, 2);
+  GST_WRITE_UINT16_LE (wav + 34, 16);
+  memcpy (wav + 36, "data", 4);
+  GST_WRITE_UINT32_LE (wav + 40, data_size);
+
+  for (i = 0; i < WAV_RATE; i++)
+    GST_WRITE_UINT16_LE (wav + WAV_HEADER_SIZE + 2 * i, i);
+
+  fail_unless (g_file_set_contents (path, (gchar *) wav, WAV_HEADER_SIZE + data_size, NULL));
+  g_free (wav);
+
+  return path;
+}
+
+static void
+remove_dir_contents (const gchar *dir)
+{
+  GDir *entries = g_dir_open (dir, 0, NULL);
+  const gchar *name;
+
+  while (entries && (name = g_dir_read_name (entries))) {
+    gchar *entry = g_build_filename (dir, name, NULL);
+
+    g_remove (entry);
+    g_free (entry);
+  }
+
+  if (entries)
+    g_dir_close (entries);
+}
+
+static GstTranscodingJob *
+create_auto_link_job (const gchar *in_uri, const gchar *cache)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+
+  gst_transcoding_job_set_discovery_cache (job, cache);
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  g_object_unref (gst_transcoding_job_add_output (job, "file:///dev/null/out.mkv", NULL));
+
+  return job;
+}
+
+GST_START_TEST (test_auto_link_cache)
+{
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  gchar *cache = g_build_filename (dir, "cache", NULL);
+  gchar *path, *in_uri, *json, *cached_json, *garbage;
+  GstTranscodingJob *job;
+  GFileInfo *times;
+  GFile *file;
+  gsize size;
+
+  if (!gst_registry_check_feature_version (gst_registry_get (), "wavparse", 1, 0, 0)) {
+    g_free (cache);
+    g_rmdir (dir);
+    g_free (dir);
+    return;
+  }
+
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+  file = g_file_new_for_path (path);
+
+  job = create_auto_link_job (in_uri, cache);
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  json = gst_transcoding_job_to_json (job, FALSE);
+  fail_unless (strstr (json, "\"audio\"") != NULL);
+  g_object_unref (job);
+
+  /* Garbage of the same size and modification time still reads as the
+   * cached stream layout */
+  times = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  fail_unless (g_file_get_contents (path, &garbage, &size, NULL));
+  memset (garbage, 0xff, size);
+  fail_unless (g_file_set_contents (path, garbage, size, NULL));
+  fail_unless (g_file_set_attributes_from_info (file, times, G_FILE_QUERY_INFO_NONE, NULL, NULL));
+
+  job = create_auto_link_job (in_uri, cache);
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  cached_json = gst_transcoding_job_to_json (job, FALSE);
+  g_object_unref (job);
+
+  fail_unless_equals_string (json, cached_json);
+
+  remove_dir_contents (cache);
+  g_rmdir (cache);
+  g_remove (path);
+  g_rmdir (dir);
+
+  g_object_unref (times);
+  g_object_unref (file);
+  g_free (garbage);
+  g_free (cached_json);
+  g_free (json);
+  g_free (in_uri);
+  g_free (path);
+  g_free (cache);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static GstTranscodingJob *
+create_output_cache_job (const gchar *in_uri, const gchar *out_uri, const gchar *cache,
+                         GstTranscodingOutput **output)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+
+  gst_transcoding_job_set_output_cache (job, cache);
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  *output = gst_transcoding_job_add_output (job, out_uri, NULL);
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+  return job;
+}
+
+GST_START_TEST (test_output_cache)
+{
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  gchar *cache = g_build_filename (dir, "cache", NULL);
+  gchar *out_path = g_build_filename (dir, "out.raw", NULL);
+  gchar *path, *in_uri, *out_uri, *contents, *cached_contents;
+  gsize size, cached_size;
+  GstTranscodingOutput *output;
+  GstTranscodingJob *job;
+
+  if (!gst_registry_check_feature_version (gst_registry_get (), "wavparse", 1, 0, 0)) {
+    g_free (out_path);
+    g_free (cache);
+    g_rmdir (dir);
+    g_free (dir);
+    return;
+  }
+
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+  out_uri = gst_filename_to_uri (out_path, NULL);
+
+  /* Passed through, as the default profiles are */
+  job = create_output_cache_job (in_uri, out_uri, cache, &output);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  fail_unless_equals_int (gst_transcoding_output_get_cache_status (output), GST_TRANSCODING_CACHE_STATUS_MISS);
+  g_object_unref (output);
+  g_object_unref (job);
+
+  fail_unless (g_file_get_contents (out_path, &contents, &size, NULL));
+  g_remove (out_path);
+
+  job = create_output_cache_job (in_uri, out_uri, cache, &output);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  fail_unless_equals_int (gst_transcoding_output_get_cache_status (output), GST_TRANSCODING_CACHE_STATUS_HIT);
+  g_object_unref (output);
+  g_object_unref (job);
+
+  fail_unless (g_file_get_contents (out_path, &cached_contents, &cached_size, NULL));
+  fail_unless_equals_uint64 (size, cached_size);
+  fail_unless (memcmp (contents, cached_contents, size) == 0);
+
+  remove_dir_contents (cache);
+  g_rmdir (cache);
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (cached_contents);
+  g_free (contents);
+  g_free (out_uri);
+  g_free (in_uri);
+  g_free (path);
+  g_free (out_path);
+  g_free (cache);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_output_and_discovery_cache)
+{
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  gchar *output_cache = g_build_filename (dir, "outputs", NULL);
+  gchar *discovery_cache = g_build_filename (dir, "discovery", NULL);
+  gchar *out_path = g_build_filename (dir, "out.raw", NULL);
+  gchar *path, *in_uri, *out_uri;
+  GstTranscodingOutput *output;
+  GstTranscodingJob *job;
+  guint i;
+
+  if (!have_elements ("wavparse", NULL)) {
+    g_free (out_path);
+    g_free (discovery_cache);
+    g_free (output_cache);
+    g_rmdir (dir);
+    g_free (dir);
+    return;
+  }
+
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+  out_uri = gst_filename_to_uri (out_path, NULL);
+
+  /* Setting one cache leaves the other alone, whatever the order */
+  for (i = 0; i < 2; i++) {
+    job = gst_transcoding_job_new ();
+    gst_transcoding_job_set_output_cache (job, output_cache);
+    gst_transcoding_job_set_discovery_cache (job, discovery_cache);
+    g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+    output = gst_transcoding_job_add_output (job, out_uri, NULL);
+    fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+    fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+
+    fail_unless_equals_int (gst_transcoding_output_get_cache_status (output),
+        i == 0 ? GST_TRANSCODING_CACHE_STATUS_MISS : GST_TRANSCODING_CACHE_STATUS_HIT);
+    fail_unless (g_file_test (output_cache, G_FILE_TEST_IS_DIR));
+    fail_unless (g_file_test (discovery_cache, G_FILE_TEST_IS_DIR));
+
+    g_object_unref (output);
+    g_object_unref (job);
+  }
+
+  remove_dir_contents (output_cache);
+  g_rmdir (output_cache);
+  remove_dir_contents (discovery_cache);
+  g_rmdir (discovery_cache);
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (out_uri);
+  g_free (in_uri);
+  g_free (path);
+  g_free (out_path);
+  g_free (discovery_cache);
+  g_free (output_cache);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static GstTranscodingJob *
+create_passthrough_job (const gchar *in_uri, const gchar *out_uri)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  g_object_unref (gst_transcoding_job_add_output (job, out_uri, NULL));
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+  return job;
+}
+
+GST_START_TEST (test_passthrough)
+{
+  gchar *dir, *path, *in_uri, *out_path, *out_uri, *wav, *contents;
+  gsize wav_size, size;
+  GstTranscodingJob *job;
+
+  if (!have_elements ("wavparse", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+  out_path = g_build_filename (dir, "out.raw", NULL);
+  out_uri = gst_filename_to_uri (out_path, NULL);
+
+  job = create_passthrough_job (in_uri, out_uri);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  g_object_unref (job);
+
+  /* The parsed samples, untouched */
+  fail_unless (g_file_get_contents (path, &wav, &wav_size, NULL));
+  fail_unless (g_file_get_contents (out_path, &contents, &size, NULL));
+  fail_unless_equals_uint64 (size, wav_size - WAV_HEADER_SIZE);
+  fail_unless (memcmp (contents, wav + WAV_HEADER_SIZE, size) == 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (contents);
+  g_free (wav);
+  g_free (out_uri);
+  g_free (out_path);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* Passes @in_uri through to @name in @dir, split in chunks of
+ * @segment_duration unless it is GST_CLOCK_TIME_NONE, returns what was
+ * written */
+static gchar *
+run_passthrough (const gchar *dir, const gchar *in_uri, const gchar *name, GstClockTime segment_duration,
+                 const gchar *worker_executable, gsize *size)
+{
+  gchar *out_path = g_build_filename (dir, name, NULL);
+  gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+  GstTranscodingJob *job = create_passthrough_job (in_uri, out_uri);
+  gchar *ret;
+
+  gst_transcoding_job_set_segment_duration (job, segment_duration);
+  gst_transcoding_job_set_max_workers (job, 2);
+  gst_transcoding_job_set_worker_executable (job, worker_executable);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  fail_unless (g_file_get_contents (out_path, &ret, size, NULL));
+
+  g_object_unref (job);
+  g_free (out_uri);
+  g_free (out_path);
+
+  return ret;
+}
+
+GST_START_TEST (test_segmented_passthrough)
+{
+  gchar *dir, *path, *in_uri, *plain, *segmented;
+  gsize plain_size, segmented_size;
+
+  if (!have_elements ("wavparse", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* Chunks transcoded apart and stitched back give the same samples, none
+   * lost nor repeated at the bounds, whatever size the input buffers are */
+  plain = run_passthrough (dir, in_uri, "plain.raw", GST_CLOCK_TIME_NONE, NULL, &plain_size);
+  segmented = run_passthrough (dir, in_uri, "segmented.raw", 150 * GST_MSECOND, NULL, &segmented_size);
+
+  fail_unless_equals_uint64 (plain_size, WAV_RATE * 2);
+  fail_unless_equals_uint64 (segmented_size, plain_size);
+  fail_unless (memcmp (plain, segmented, plain_size) == 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (segmented);
+  g_free (plain);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_segmented_passthrough_in_workers)
+{
+  const gchar *worker = g_getenv ("GST_TRANSCODING_WORKER");
+  gchar *dir, *path, *in_uri, *threaded, *spawned;
+  gsize threaded_size, spawned_size;
+
+  /* Set by the build to the gst-transcoding-worker tool */
+  if (!worker || !have_elements ("wavparse", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* Chunks streamed back from worker processes give the same output as
+   * chunks transcoded in threads */
+  threaded = run_passthrough (dir, in_uri, "threaded.raw", 150 * GST_MSECOND, NULL, &threaded_size);
+  spawned = run_passthrough (dir, in_uri, "spawned.raw", 150 * GST_MSECOND, worker, &spawned_size);
+
+  fail_unless_equals_uint64 (threaded_size, WAV_RATE * 2);
+  fail_unless_equals_uint64 (spawned_size, threaded_size);
+  fail_unless (memcmp (threaded, spawned, threaded_size) == 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (spawned);
+  g_free (threaded);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static void
+run_to_eos (GstElement *pipeline)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  gst_object_unref (bus);
+}
+
+/* Raw audio in matroska, the samples of @wav_path in one track and half as
+ * many of silence in another */
+static gchar *
+create_two_track_file (const gchar *dir, const gchar *wav_path)
+{
+  gchar *ret = g_build_filename (dir, "tracks.mkv", NULL);
+  gchar *desc = g_strdup_printf ("matroskamux name=mux ! filesink location=\"%s\" "
+      "filesrc location=\"%s\" ! wavparse ! mux. "
+      "audiotestsrc wave=silence num-buffers=4 samplesperbuffer=%u ! "
+      "audio/x-raw, format=S16LE, rate=%u, channels=1 ! mux.", ret, wav_path, WAV_RATE / 8, WAV_RATE);
+  GstElement *pipeline = gst_parse_launch (desc, NULL);
+
+  fail_unless (pipeline != NULL);
+  run_to_eos (pipeline);
+
+  gst_object_unref (pipeline);
+  g_free (desc);
+
+  return ret;
+}
+
+/* The stream-ids of the input of @job, in the order they are serialized */
+static gchar **
+get_stream_ids (GstTranscodingJob *job)
+{
+  gchar *json = gst_transcoding_job_to_json (job, FALSE);
+  GPtrArray *ret = g_ptr_array_new ();
+  const gchar *p = json, *end;
+
+  while ((p = strstr (p, "\"stream-id\":\""))) {
+    p += strlen ("\"stream-id\":\"");
+    end = strchr (p, '"');
+    g_ptr_array_add (ret, g_strndup (p, end - p));
+    p = end;
+  }
+
+  g_ptr_array_add (ret, NULL);
+  g_free (json);
+
+  return (gchar **) g_ptr_array_free (ret, FALSE);
+}
+
+GST_START_TEST (test_unmapped_stream_dropped)
+{
+  gchar *dir, *path, *tracks_path, *in_uri, *out_uri, *wav, **stream_ids, *contents[2];
+  gsize wav_size, sizes[2];
+  GstTranscodingJob *job;
+  guint i, wav_track;
+
+  if (!have_elements ("wavparse", "audiotestsrc", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  tracks_path = create_two_track_file (dir, path);
+  in_uri = gst_filename_to_uri (tracks_path, NULL);
+
+  job = gst_transcoding_job_new ();
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  /* Only probed, for the stream-ids */
+  out_uri = g_strconcat (in_uri, ".copy.mkv", NULL);
+  g_object_unref (gst_transcoding_job_add_output (job, out_uri, NULL));
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  stream_ids = get_stream_ids (job);
+  fail_unless_equals_int (g_strv_length (stream_ids), 2);
+  g_object_unref (job);
+  g_free (out_uri);
+
+  /* Each track alone, whichever it is, the other one never gets anywhere */
+  for (i = 0; i < 2; i++) {
+    gchar *name = g_strdup_printf ("out-%u.raw", i);
+    gchar *out_path = g_build_filename (dir, name, NULL);
+
+    out_uri = gst_filename_to_uri (out_path, NULL);
+    job = gst_transcoding_job_new ();
+    g_object_unref (gst_transcoding_job_map_audio_stream (job, in_uri, stream_ids[i], out_uri));
+    fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+    fail_unless (g_file_get_contents (out_path, &contents[i], &sizes[i], NULL));
+
+    g_object_unref (job);
+    g_free (out_uri);
+    g_free (out_path);
+    g_free (name);
+  }
+
+  fail_unless (g_file_get_contents (path, &wav, &wav_size, NULL));
+  wav_track = sizes[0] == wav_size - WAV_HEADER_SIZE ? 0 : 1;
+
+  fail_unless_equals_uint64 (sizes[wav_track], wav_size - WAV_HEADER_SIZE);
+  fail_unless (memcmp (contents[wav_track], wav + WAV_HEADER_SIZE, sizes[wav_track]) == 0);
+
+  fail_unless_equals_uint64 (sizes[1 - wav_track], WAV_RATE);
+  for (i = 0; i < sizes[1 - wav_track]; i++)
+    fail_unless_equals_int (contents[1 - wav_track][i], 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (contents[1]);
+  g_free (contents[0]);
+  g_free (wav);
+  g_strfreev (stream_ids);
+  g_free (in_uri);
+  g_free (tracks_path);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  guint64 n_samples;
+  gint rate;
+} DecodedAudio;
+
+static void
+decoded_handoff_cb (GstElement *sink, GstBuffer *buf, GstPad *pad, DecodedAudio *decoded)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+
+  gst_structure_get_int (gst_caps_get_structure (caps, 0), "rate", &decoded->rate);
+  decoded->n_samples += gst_buffer_get_size (buf) / 2;
+  gst_caps_unref (caps);
+}
+
+/* Decodes the audio of @path, as 16 bits mono */
+static void
+decode_audio (const gchar *path, DecodedAudio *decoded)
+{
+  gchar *desc = g_strdup_printf ("filesrc location=\"%s\" ! decodebin ! audioconvert ! "
+      "audio/x-raw, format=S16LE, channels=1 ! fakesink name=sink signal-handoffs=true", path);
+  GstElement *pipeline = gst_parse_launch (desc, NULL);
+  GstElement *sink;
+
+  fail_unless (pipeline != NULL);
+  decoded->n_samples = 0;
+  decoded->rate = 0;
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (decoded_handoff_cb), decoded);
+  gst_object_unref (sink);
+
+  run_to_eos (pipeline);
+
+  gst_object_unref (pipeline);
+  g_free (desc);
+}
+
+/* Decoders may trim or pad a little around the encoder delay */
+#define assert_decoded_duration(decoded, expected_samples) \
+  fail_unless ((decoded)->n_samples + (decoded)->rate / 10 >= (expected_samples) && \
+      (decoded)->n_samples <= (expected_samples) + (decoded)->rate / 10)
+
+/* Vorbis in matroska, resampled to @rate unless it is 0 */
+static GstTranscodingContainerProfile *
+create_vorbis_profile (guint rate, GstTranscodingSpeedPreset speed_preset)
+{
+  GstTranscodingAudioProfile *aprof = gst_transcoding_audio_profile_new ();
+  GstTranscodingContainerProfile *ret;
+
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_FORMAT_VORBIS);
+  gst_transcoding_stream_profile_set_speed_preset (GST_TRANSCODING_STREAM_PROFILE (aprof), speed_preset);
+  if (rate)
+    gst_transcoding_audio_profile_set_rate (aprof, rate);
+
+  ret = gst_transcoding_container_profile_new (aprof, NULL);
+  gst_transcoding_container_profile_set_format (ret, GST_TRANSCODING_FORMAT_MATROSKA);
+
+  return ret;
+}
+
+/* Auto-links the stream of @in_uri to one output per profile of @profiles,
+ * named out-<index>.mkv, runs the job and decodes them back */
+static void
+run_renditions (const gchar *dir, const gchar *in_uri, GstTranscodingContainerProfile **profiles, guint n_profiles,
+                DecodedAudio *decoded)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  gchar **out_paths = g_new0 (gchar *, n_profiles + 1);
+  guint i;
+
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+
+  for (i = 0; i < n_profiles; i++) {
+    gchar *name = g_strdup_printf ("out-%u.mkv", i);
+    gchar *out_uri;
+
+    out_paths[i] = g_build_filename (dir, name, NULL);
+    out_uri = gst_filename_to_uri (out_paths[i], NULL);
+    g_object_unref (gst_transcoding_job_add_output (job, out_uri, profiles[i]));
+
+    g_free (out_uri);
+    g_free (name);
+  }
+
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  g_object_unref (job);
+
+  for (i = 0; i < n_profiles; i++)
+    decode_audio (out_paths[i], &decoded[i]);
+
+  g_strfreev (out_paths);
+}
+
+GST_START_TEST (test_shared_encoder)
+{
+  GstTranscodingContainerProfile *profiles[2];
+  DecodedAudio decoded[2];
+  gchar *dir, *path, *in_uri;
+  guint i;
+
+  if (!have_elements ("wavparse", "vorbisenc", "vorbisdec", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* Encoded once, teed to both muxers */
+  for (i = 0; i < 2; i++)
+    profiles[i] = create_vorbis_profile (0, GST_TRANSCODING_SPEED_PRESET_DEFAULT);
+
+  run_renditions (dir, in_uri, profiles, 2, decoded);
+
+  for (i = 0; i < 2; i++) {
+    fail_unless_equals_int (decoded[i].rate, WAV_RATE);
+    assert_decoded_duration (&decoded[i], WAV_RATE);
+  }
+
+  fail_unless_equals_uint64 (decoded[0].n_samples, decoded[1].n_samples);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_shared_conversion)
+{
+  GstTranscodingContainerProfile *profiles[3];
+  DecodedAudio decoded[3];
+  gchar *dir, *path, *in_uri;
+  guint i;
+
+  if (!have_elements ("wavparse", "vorbisenc", "vorbisdec", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* Two encoders resampled by the same conversion, one at the input rate */
+  profiles[0] = create_vorbis_profile (2 * WAV_RATE, GST_TRANSCODING_SPEED_PRESET_FAST);
+  profiles[1] = create_vorbis_profile (2 * WAV_RATE, GST_TRANSCODING_SPEED_PRESET_SLOW);
+  profiles[2] = create_vorbis_profile (0, GST_TRANSCODING_SPEED_PRESET_DEFAULT);
+
+  run_renditions (dir, in_uri, profiles, 3, decoded);
+
+  for (i = 0; i < 2; i++) {
+    fail_unless_equals_int (decoded[i].rate, 2 * WAV_RATE);
+    assert_decoded_duration (&decoded[i], 2 * WAV_RATE);
+  }
+
+  fail_unless_equals_int (decoded[2].rate, WAV_RATE);
+  assert_decoded_duration (&decoded[2], WAV_RATE);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_encoded_stream_parsed)
+{
+  GstTranscodingAudioProfile *aprof;
+  GstTranscodingContainerProfile *profile;
+  DecodedAudio decoded;
+  gchar *dir, *path, *in_uri;
+
+  if (!have_elements ("wavparse", "lamemp3enc", "mpegaudioparse", "mp4mux", "qtdemux", "mpg123audiodec", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* The MP4 muxer only takes parsed MP3, which the encoder doesn't claim */
+  aprof = gst_transcoding_audio_profile_new ();
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_FORMAT_MP3);
+  profile = gst_transcoding_container_profile_new (aprof, NULL);
+  gst_transcoding_container_profile_set_format (profile, GST_TRANSCODING_FORMAT_MP4);
+
+  run_renditions (dir, in_uri, &profile, 1, &decoded);
+
+  fail_unless_equals_int (decoded.rate, WAV_RATE);
+  assert_decoded_duration (&decoded, WAV_RATE);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pipeline_pool)
+{
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  gchar *path, *in_uri, *contents[2];
+  gsize sizes[2];
+  guint i;
+
+  if (!gst_registry_check_feature_version (gst_registry_get (), "wavparse", 1, 0, 0)) {
+    g_rmdir (dir);
+    g_free (dir);
+    return;
+  }
+
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* The second job runs in the pipeline of the first one, rebound to its
+   * own output */
+  gst_transcoding_set_max_idle_pipelines (1);
+
+  for (i = 0; i < 2; i++) {
+    gchar *name = g_strdup_printf ("out-%u.raw", i);
+    gchar *out_path = g_build_filename (dir, name, NULL);
+    gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+    GstTranscodingJob *job = create_passthrough_job (in_uri, out_uri);
+
+    fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+    fail_unless (g_file_get_contents (out_path, &contents[i], &sizes[i], NULL));
+
+    g_object_unref (job);
+    g_free (out_uri);
+    g_free (out_path);
+    g_free (name);
+  }
+
+  gst_transcoding_set_max_idle_pipelines (0);
+
+  fail_unless (sizes[0] > 0);
+  fail_unless_equals_uint64 (sizes[0], sizes[1]);
+  fail_unless (memcmp (contents[0], contents[1], sizes[0]) == 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (contents[1]);
+  g_free (contents[0]);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* Within a tenth of a second, of which the samples are their index */
+#define assert_about(value, expected) \
+  fail_unless ((value) + WAV_RATE / 10 >= (expected) && (value) <= (expected) + WAV_RATE / 10)
+
+GST_START_TEST (test_input_range)
+{
+  GstClockTime starts[2] = { GST_SECOND / 4, GST_SECOND / 2 };
+  GstClockTime stops[2] = { 3 * GST_SECOND / 4, GST_CLOCK_TIME_NONE };
+  gchar *dir, *path, *in_uri;
+  guint i;
+
+  if (!have_elements ("wavparse", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* The second range is seeked to in the pipeline of the first one, its
+   * pads blocked and unblocked again */
+  gst_transcoding_set_max_idle_pipelines (1);
+
+  for (i = 0; i < 2; i++) {
+    gchar *name = g_strdup_printf ("out-%u.raw", i);
+    gchar *out_path = g_build_filename (dir, name, NULL);
+    gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+    GstTranscodingJob *job = gst_transcoding_job_new ();
+    GstTranscodingInput *input = gst_transcoding_job_add_input (job, in_uri);
+    gchar *contents;
+    gsize size;
+
+    gst_transcoding_input_set_range (input, starts[i], stops[i]);
+    g_object_unref (input);
+    g_object_unref (gst_transcoding_job_add_output (job, out_uri, NULL));
+    fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+    fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+    fail_unless (g_file_get_contents (out_path, &contents, &size, NULL));
+
+    fail_unless (size >= 2);
+    assert_about (GST_READ_UINT16_LE (contents), WAV_RATE / 4 * (i + 1));
+    assert_about (size / 2, WAV_RATE / 2);
+
+    g_free (contents);
+    g_object_unref (job);
+    g_free (out_uri);
+    g_free (out_path);
+    g_free (name);
+  }
+
+  gst_transcoding_set_max_idle_pipelines (0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* Passes the range of @in_uri through to @name in @dir, smart rendered or
+ * not, returns what was written */
+static gchar *
+run_ranged_passthrough (const gchar *dir, const gchar *in_uri, const gchar *name, gboolean smart_render,
+                        gsize *size)
+{
+  gchar *out_path = g_build_filename (dir, name, NULL);
+  gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingInput *input = gst_transcoding_job_add_input (job, in_uri);
+  gchar *ret;
+
+  gst_transcoding_input_set_range (input, GST_SECOND / 4, 3 * GST_SECOND / 4);
+  g_object_unref (input);
+  g_object_unref (gst_transcoding_job_add_output (job, out_uri, NULL));
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+  gst_transcoding_job_set_smart_render (job, smart_render);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  fail_unless (g_file_get_contents (out_path, &ret, size, NULL));
+
+  g_object_unref (job);
+  g_free (out_uri);
+  g_free (out_path);
+
+  return ret;
+}
+
+GST_START_TEST (test_smart_render_audio)
+{
+  gchar *dir, *path, *in_uri, *plain, *smart;
+  gsize plain_size, smart_size;
+
+  if (!have_elements ("wavparse", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_wav (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* Without video there is nothing to copy, the range is a single chunk */
+  plain = run_ranged_passthrough (dir, in_uri, "plain.raw", FALSE, &plain_size);
+  smart = run_ranged_passthrough (dir, in_uri, "smart.raw", TRUE, &smart_size);
+
+  fail_unless (plain_size > 0);
+  fail_unless_equals_uint64 (smart_size, plain_size);
+  fail_unless (memcmp (plain, smart, plain_size) == 0);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (smart);
+  g_free (plain);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+#define VIDEO_RATE 10
+
+typedef struct
+{
+  guint n_frames;
+  gint width;
+  gint height;
+} DecodedVideo;
+
+static void
+decoded_video_handoff_cb (GstElement *sink, GstBuffer *buf, GstPad *pad, DecodedVideo *decoded)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+
+  gst_structure_get_int (gst_caps_get_structure (caps, 0), "width", &decoded->width);
+  gst_structure_get_int (gst_caps_get_structure (caps, 0), "height", &decoded->height);
+  decoded->n_frames++;
+  gst_caps_unref (caps);
+}
+
+static void
+decode_video (const gchar *path, DecodedVideo *decoded)
+{
+  gchar *desc = g_strdup_printf ("filesrc location=\"%s\" ! decodebin ! videoconvert ! "
+      "video/x-raw, format=I420 ! fakesink name=sink signal-handoffs=true", path);
+  GstElement *pipeline = gst_parse_launch (desc, NULL);
+  GstElement *sink;
+
+  fail_unless (pipeline != NULL);
+  decoded->n_frames = 0;
+  decoded->width = 0;
+  decoded->height = 0;
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (sink, "handoff", G_CALLBACK (decoded_video_handoff_cb), decoded);
+  gst_object_unref (sink);
+
+  run_to_eos (pipeline);
+
+  gst_object_unref (pipeline);
+  g_free (desc);
+}
+
+/* Two seconds of VP8 in matroska, with a keyframe every half second */
+static gchar *
+create_vp8 (const gchar *dir)
+{
+  gchar *ret = g_build_filename (dir, "in.mkv", NULL);
+  gchar *desc = g_strdup_printf ("videotestsrc num-buffers=%u ! video/x-raw, width=64, height=48, framerate=%u/1 ! "
+      "vp8enc keyframe-max-dist=%u ! matroskamux ! filesink location=\"%s\"",
+      2 * VIDEO_RATE, VIDEO_RATE, VIDEO_RATE / 2, ret);
+  GstElement *pipeline = gst_parse_launch (desc, NULL);
+
+  fail_unless (pipeline != NULL);
+  run_to_eos (pipeline);
+
+  gst_object_unref (pipeline);
+  g_free (desc);
+
+  return ret;
+}
+
+GST_START_TEST (test_smart_render_video)
+{
+  guint widths[2] = { 0, 32 };
+  gchar *dir, *path, *in_uri;
+  guint i;
+
+  if (!have_elements ("videotestsrc", "vp8enc", "vp8dec", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_vp8 (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* The first GOPs of the range are copied when the video is kept as is,
+   * or if the encoder doesn't produce the same caps the range is
+   * transcoded as a whole, the scaled one always is */
+  for (i = 0; i < G_N_ELEMENTS (widths); i++) {
+    GstTranscodingVideoProfile *vprof = gst_transcoding_video_profile_new ();
+    GstTranscodingContainerProfile *profile = gst_transcoding_container_profile_new (NULL, vprof);
+    gchar *name = g_strdup_printf ("out-%u.mkv", i);
+    gchar *out_path = g_build_filename (dir, name, NULL);
+    gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+    GstTranscodingJob *job = gst_transcoding_job_new ();
+    GstTranscodingInput *input = gst_transcoding_job_add_input (job, in_uri);
+    DecodedVideo decoded;
+
+    gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_VP8);
+    if (widths[i])
+      gst_transcoding_video_profile_set_size (vprof, widths[i], widths[i] * 3 / 4);
+    gst_transcoding_container_profile_set_format (profile, GST_TRANSCODING_FORMAT_MATROSKA);
+
+    gst_transcoding_input_set_range (input, GST_SECOND / 4, 7 * GST_SECOND / 4);
+    g_object_unref (input);
+    g_object_unref (gst_transcoding_job_add_output (job, out_uri, profile));
+    fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+    gst_transcoding_job_set_smart_render (job, TRUE);
+    fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+
+    decode_video (out_path, &decoded);
+    fail_unless_equals_int (decoded.width, widths[i] ? widths[i] : 64);
+    fail_unless (decoded.n_frames + 2 >= 3 * VIDEO_RATE / 2 && decoded.n_frames <= 3 * VIDEO_RATE / 2 + 2);
+
+    g_object_unref (job);
+    g_free (out_uri);
+    g_free (out_path);
+    g_free (name);
+  }
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* Two seconds of VP8 as create_vp8(), with as much raw audio */
+static gchar *
+create_vp8_with_audio (const gchar *dir)
+{
+  gchar *ret = g_build_filename (dir, "in.mkv", NULL);
+  gchar *desc = g_strdup_printf ("matroskamux name=mux ! filesink location=\"%s\" "
+      "videotestsrc num-buffers=%u ! video/x-raw, width=64, height=48, framerate=%u/1 ! "
+      "vp8enc keyframe-max-dist=%u ! mux. "
+      "audiotestsrc num-buffers=%u samplesperbuffer=%u ! audio/x-raw, format=S16LE, rate=%u, channels=1 ! mux.",
+      ret, 2 * VIDEO_RATE, VIDEO_RATE, VIDEO_RATE / 2, 2 * VIDEO_RATE, WAV_RATE / VIDEO_RATE, WAV_RATE);
+  GstElement *pipeline = gst_parse_launch (desc, NULL);
+
+  fail_unless (pipeline != NULL);
+  run_to_eos (pipeline);
+
+  gst_object_unref (pipeline);
+  g_free (desc);
+
+  return ret;
+}
+
+/* Copies the video and encodes the audio of @in_uri into @name in @dir,
+ * returns its path */
+static gchar *
+run_segmented_vorbis (const gchar *dir, const gchar *in_uri, const gchar *name, GstClockTime segment_duration)
+{
+  gchar *out_path = g_build_filename (dir, name, NULL);
+  gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  g_object_unref (gst_transcoding_job_add_output (job, out_uri,
+          create_vorbis_profile (0, GST_TRANSCODING_SPEED_PRESET_DEFAULT)));
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+
+  gst_transcoding_job_set_segment_duration (job, segment_duration);
+  gst_transcoding_job_set_max_workers (job, 2);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+
+  g_object_unref (job);
+  g_free (out_uri);
+
+  return out_path;
+}
+
+GST_START_TEST (test_segmented_encoded_audio)
+{
+  gchar *dir, *path, *in_uri, *plain, *segmented;
+  DecodedAudio decoded[2];
+  DecodedVideo video;
+
+  if (!have_elements ("videotestsrc", "vp8enc", "vp8dec", "audiotestsrc", "vorbisenc", "vorbisdec",
+          "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_vp8_with_audio (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  /* The video is cut in chunks, the audio encoded in one go along them:
+   * encoders prime and pad every stream, which would leave gaps at each
+   * join of chunks encoded apart */
+  plain = run_segmented_vorbis (dir, in_uri, "plain.mkv", GST_CLOCK_TIME_NONE);
+  segmented = run_segmented_vorbis (dir, in_uri, "segmented.mkv", GST_SECOND / 2);
+
+  decode_audio (plain, &decoded[0]);
+  decode_audio (segmented, &decoded[1]);
+  fail_unless_equals_int (decoded[1].rate, WAV_RATE);
+  assert_decoded_duration (&decoded[1], 2 * WAV_RATE);
+  fail_unless_equals_uint64 (decoded[1].n_samples, decoded[0].n_samples);
+
+  decode_video (segmented, &video);
+  fail_unless_equals_int (video.n_frames, 2 * VIDEO_RATE);
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (segmented);
+  g_free (plain);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_video_ladder)
+{
+  GstTranscodingLadderRung rungs[] = {
+    { "wide.mkv", 64, 0, 0 },
+    { "square.mkv", 24, 24, 0 },
+    { "small.mkv", 16, 12, 0 },
+  };
+  gint sizes[][2] = { { 64, 48 }, { 24, 24 }, { 16, 12 } };
+  gchar *dir, *path, *in_uri, *probe_uri, *out_uris[G_N_ELEMENTS (rungs)], **stream_ids;
+  GstTranscodingJob *job;
+  GError *error = NULL;
+  GPtrArray *profiles;
+  guint i;
+
+  if (!have_elements ("videotestsrc", "vp8enc", "vp8dec", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  path = create_vp8 (dir);
+  in_uri = gst_filename_to_uri (path, NULL);
+
+  job = gst_transcoding_job_new ();
+  g_object_unref (gst_transcoding_job_add_input (job, in_uri));
+  /* Only probed, for the stream-id */
+  probe_uri = g_strconcat (in_uri, ".copy.mkv", NULL);
+  g_object_unref (gst_transcoding_job_add_output (job, probe_uri, NULL));
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  stream_ids = get_stream_ids (job);
+  fail_unless_equals_int (g_strv_length (stream_ids), 1);
+  g_object_unref (job);
+  g_free (probe_uri);
+
+  job = gst_transcoding_job_new ();
+  for (i = 0; i < G_N_ELEMENTS (rungs); i++) {
+    GstTranscodingVideoProfile *vprof = gst_transcoding_video_profile_new ();
+    GstTranscodingContainerProfile *profile = gst_transcoding_container_profile_new (NULL, vprof);
+    gchar *out_path = g_build_filename (dir, rungs[i].out_uri, NULL);
+
+    gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_VP8);
+    gst_transcoding_container_profile_set_format (profile, GST_TRANSCODING_FORMAT_MATROSKA);
+    out_uris[i] = gst_filename_to_uri (out_path, NULL);
+    g_object_unref (gst_transcoding_job_add_output (job, out_uris[i], profile));
+    rungs[i].out_uri = out_uris[i];
+
+    g_free (out_path);
+  }
+
+  /* The rung with only a width is the largest one, and can't be scaled from
+   * the square one without taking its aspect ratio */
+  profiles = gst_transcoding_job_map_video_ladder (job, in_uri, stream_ids[0], rungs, G_N_ELEMENTS (rungs), &error);
+  g_assert_no_error (error);
+  g_ptr_array_unref (profiles);
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+  g_object_unref (job);
+
+  for (i = 0; i < G_N_ELEMENTS (rungs); i++) {
+    gchar *out_path = g_filename_from_uri (out_uris[i], NULL, NULL);
+    DecodedVideo decoded;
+
+    decode_video (out_path, &decoded);
+    fail_unless_equals_int (decoded.width, sizes[i][0]);
+    fail_unless_equals_int (decoded.height, sizes[i][1]);
+    fail_unless_equals_int (decoded.n_frames, 2 * VIDEO_RATE);
+
+    g_free (out_path);
+    g_free (out_uris[i]);
+  }
+
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_strfreev (stream_ids);
+  g_free (in_uri);
+  g_free (path);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+/* Plays @in_uris one after the other into @name in @dir, returns its path */
+static gchar *
+run_sequence (const gchar *dir, gchar **in_uris, const gchar *name, GstTranscodingContainerProfile *profile)
+{
+  gchar *out_path = g_build_filename (dir, name, NULL);
+  gchar *out_uri = gst_filename_to_uri (out_path, NULL);
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingOutput *output;
+  guint i;
+
+  for (i = 0; in_uris[i]; i++)
+    g_object_unref (gst_transcoding_job_add_input (job, in_uris[i]));
+
+  output = gst_transcoding_job_add_output (job, out_uri, profile);
+  gst_transcoding_output_set_sequence (output, (const gchar * const *) in_uris);
+  g_object_unref (output);
+
+  fail_unless (gst_transcoding_job_auto_link (job, 0, NULL, NULL));
+  fail_unless (gst_transcoding_job_run (job, NULL, NULL));
+
+  g_object_unref (job);
+  g_free (out_uri);
+
+  return out_path;
+}
+
+GST_START_TEST (test_sequence)
+{
+  gchar *dir, *sub_dir, *paths[2], *in_uris[3] = { NULL, }, *out_path, *wav, *contents;
+  gsize wav_size, size, pcm_size;
+  DecodedAudio decoded;
+  guint i;
+
+  if (!have_elements ("wavparse", "matroskamux", "matroskademux", NULL))
+    return;
+
+  dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  sub_dir = g_build_filename (dir, "second", NULL);
+  fail_unless (g_mkdir (sub_dir, 0755) == 0);
+
+  paths[0] = create_wav (dir);
+  paths[1] = create_wav (sub_dir);
+  for (i = 0; i < 2; i++)
+    in_uris[i] = gst_filename_to_uri (paths[i], NULL);
+
+  /* Copied as is from both inputs */
+  out_path = run_sequence (dir, in_uris, "out.raw", NULL);
+  fail_unless (g_file_get_contents (paths[0], &wav, &wav_size, NULL));
+  fail_unless (g_file_get_contents (out_path, &contents, &size, NULL));
+  pcm_size = wav_size - WAV_HEADER_SIZE;
+
+  fail_unless_equals_uint64 (size, 2 * pcm_size);
+  fail_unless (memcmp (contents, wav + WAV_HEADER_SIZE, pcm_size) == 0);
+  fail_unless (memcmp (contents + pcm_size, wav + WAV_HEADER_SIZE, pcm_size) == 0);
+
+  g_free (contents);
+  g_free (out_path);
+
+  /* Encoded from both inputs, the second one following the first in time */
+  if (have_elements ("vorbisenc", "vorbisdec", NULL)) {
+    out_path = run_sequence (dir, in_uris, "out.mkv", create_vorbis_profile (0, GST_TRANSCODING_SPEED_PRESET_DEFAULT));
+    decode_audio (out_path, &decoded);
+    fail_unless_equals_int (decoded.rate, WAV_RATE);
+    assert_decoded_duration (&decoded, 2 * WAV_RATE);
+    g_free (out_path);
+  }
+
+  remove_dir_contents (sub_dir);
+  g_rmdir (sub_dir);
+  remove_dir_contents (dir);
+  g_rmdir (dir);
+
+  g_free (wav);
+  for (i = 0; i < 2; i++) {
+    g_free (in_uris[i]);
+    g_free (paths[i]);
+  }
+  g_free (sub_dir);
+  g_free (dir);
+}
+
+GST_END_TEST;
+
+static gpointer
+worker_thread (gpointer fd)
+{
+  GError *error = NULL;
+  gboolean ret = gst_transcoding_worker_main (GPOINTER_TO_INT (fd), &error);
+
+  g_assert_no_error (error);
+
+  return GINT_TO_POINTER (ret);
+}
+
+GST_START_TEST (test_worker_exits_on_close)
+{
+  GThread *thread;
+  int fds[2];
+
+  fail_unless (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  thread = g_thread_new ("worker", worker_thread, GINT_TO_POINTER (fds[1]));
+
+  /* A worker is done once its coordinator goes away */
+  close (fds[0]);
+  fail_unless (GPOINTER_TO_INT (g_thread_join (thread)));
+}
+
+GST_END_TEST;
+
+static gpointer
+failing_worker_thread (gpointer fd)
+{
+  GError *error = NULL;
+
+  fail_if (gst_transcoding_worker_main (GPOINTER_TO_INT (fd), &error));
+
+  return error;
+}
+
+GST_START_TEST (test_worker_rejects_oversized_message)
+{
+  guint32 header[2] = { GUINT32_TO_BE (1), GUINT32_TO_BE (G_MAXUINT32) };
+  GThread *thread;
+  GError *error;
+  int fds[2];
+
+  fail_unless (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  thread = g_thread_new ("worker", failing_worker_thread, GINT_TO_POINTER (fds[1]));
+
+  /* A task announcing 4 GiB is refused before anything is allocated */
+  fail_unless (write (fds[0], header, sizeof (header)) == sizeof (header));
+  error = g_thread_join (thread);
+  fail_unless (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA));
+
+  g_error_free (error);
+  close (fds[0]);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_transcoding_executor_suite (void)
+{
+  Suite *s = suite_create ("GstTranscodingExecutor");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_run_missing_input);
+  tcase_add_test (tc_chain, test_run_async_missing_input);
+  tcase_add_test (tc_chain, test_smart_render_missing_input);
+  tcase_add_test (tc_chain, test_auto_link_missing_input);
+  tcase_add_test (tc_chain, test_auto_link_cache);
+  tcase_add_test (tc_chain, test_output_cache);
+  tcase_add_test (tc_chain, test_output_and_discovery_cache);
+  tcase_add_test (tc_chain, test_passthrough);
+  tcase_add_test (tc_chain, test_shared_encoder);
+  tcase_add_test (tc_chain, test_shared_conversion);
+  tcase_add_test (tc_chain, test_encoded_stream_parsed);
+  tcase_add_test (tc_chain, test_segmented_passthrough);
+  tcase_add_test (tc_chain, test_segmented_passthrough_in_workers);
+  tcase_add_test (tc_chain, test_unmapped_stream_dropped);
+  tcase_add_test (tc_chain, test_pipeline_pool);
+  tcase_add_test (tc_chain, test_input_range);
+  tcase_add_test (tc_chain, test_smart_render_audio);
+  tcase_add_test (tc_chain, test_smart_render_video);
+  tcase_add_test (tc_chain, test_video_ladder);
+  tcase_add_test (tc_chain, test_segmented_encoded_audio);
+  tcase_add_test (tc_chain, test_sequence);
+  tcase_add_test (tc_chain, test_worker_exits_on_close);
+  tcase_add_test (tc_chain, test_worker_rejects_oversized_message);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gst_transcoding_executor);
@@ -1,3 +1,5 @@
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <gst/check/gstcheck.h>
 #include <gst/transcoding/job.h>
 
@@ -77,7 +79,7 @@ GST_START_TEST (test_manual_mapping)
   fail_unless (output != NULL);
   uri = gst_transcoding_output_get_uri (output);
   fail_unless_equals_string (uri, "file:///foo/baz.mkv");
-  g_object_unref (input);
+  g_object_unref (output);
   g_free (uri);
 
   /* Make sure creating this input is no longer possible */
@@ -334,6 +336,446 @@ GST_START_TEST (test_hybrid_mapping)
 
 GST_END_TEST;
 
+GST_START_TEST (test_to_json_compact)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingOutput *output;
+  gchar *json;
+
+  output = gst_transcoding_job_add_output (job, "file:///foo/baz.mkv", NULL);
+  g_object_unref (output);
+
+  /* Without pretty printing, no whitespace is emitted at all */
+  json = gst_transcoding_job_to_json (job, FALSE);
+  fail_unless_equals_string (json,
+      "{\"outputs\":[{\"uri\":\"file:///foo/baz.mkv\",\"autolink\":true,"
+      "\"container-profile\":{\"format\":\"video/x-matroska\","
+      "\"meta-audio-profile\":{\"format\":\"application/unknown\"},"
+      "\"meta-video-profile\":{\"format\":\"application/unknown\"}}}],"
+      "\"inputs\":[]}");
+  g_free (json);
+
+  json = gst_transcoding_job_to_json (job, TRUE);
+  fail_unless (strstr (json, "\n    {\n      \"uri\" : \"file:///foo/baz.mkv\",\n") != NULL);
+  g_free (json);
+
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_from_json_round_trip)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingJob *parsed;
+  GstTranscodingVideoProfile *vprof;
+  GstTranscodingAudioProfile *aprof;
+  const gchar *sequence[] = { "file:///foo/bar", "file:///foo/bar", NULL };
+  GstTranscodingOutput *output;
+  GstTranscodingInput *input;
+  GInputStream *stream;
+  GError *error = NULL;
+  gchar *json, *parsed_json;
+
+  vprof = gst_transcoding_job_map_video_stream (job, "file:///foo/bar", "stream-id", "file:///foo/baz.mkv");
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_H264);
+  gst_transcoding_stream_profile_set_bitrate (GST_TRANSCODING_STREAM_PROFILE (vprof), 2000000);
+  gst_transcoding_stream_profile_set_rate_control (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_RATE_CONTROL_CBR);
+  gst_transcoding_stream_profile_set_speed_preset (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_SPEED_PRESET_FAST);
+  gst_transcoding_stream_profile_set_tune (GST_TRANSCODING_STREAM_PROFILE (vprof), "zerolatency");
+  gst_transcoding_stream_profile_set_threads (GST_TRANSCODING_STREAM_PROFILE (vprof), 2);
+  g_object_unref (vprof);
+  vprof = gst_transcoding_job_map_video_stream (job, "file:///foo/bar", "stream-id", "file:///foo/baz.mkv");
+  g_object_unref (vprof);
+  aprof = gst_transcoding_job_map_audio_stream (job, "file:///foo/bar", "audio-stream-id", "file:///foo/baz.mkv");
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_FORMAT_OPUS);
+  gst_transcoding_audio_profile_set_rate (aprof, 48000);
+  gst_transcoding_audio_profile_set_channels (aprof, 2);
+  gst_transcoding_audio_profile_set_sample_format (aprof, "S16LE");
+  input = gst_transcoding_stream_profile_get_input (GST_TRANSCODING_STREAM_PROFILE (aprof));
+  gst_transcoding_input_set_range (input, 600 * GST_SECOND, GST_CLOCK_TIME_NONE);
+  g_object_unref (input);
+  output = gst_transcoding_stream_profile_get_output (GST_TRANSCODING_STREAM_PROFILE (aprof));
+  gst_transcoding_output_set_sequence (output, sequence);
+  g_object_unref (output);
+  g_object_unref (aprof);
+
+  json = gst_transcoding_job_to_json (job, TRUE);
+  fail_unless (strstr (json, "\"speed-preset\" : \"fast\"") != NULL);
+  fail_unless (strstr (json, "\"sample-format\" : \"S16LE\"") != NULL);
+  fail_unless (strstr (json, "\"start\" : 600000000000") != NULL);
+  fail_unless (strstr (json, "\"stop\"") == NULL);
+  fail_unless (strstr (json, "\"sequence\"") != NULL);
+
+  /* Parsing a serialized job gives back the same job */
+  parsed = gst_transcoding_job_from_json (json, &error);
+  g_assert_no_error (error);
+  parsed_json = gst_transcoding_job_to_json (parsed, TRUE);
+  fail_unless_equals_string (parsed_json, json);
+  g_free (parsed_json);
+  g_object_unref (parsed);
+
+  /* Whether it is read from memory or from a stream */
+  stream = g_memory_input_stream_new_from_data (json, -1, NULL);
+  parsed = gst_transcoding_job_from_json_stream (stream, NULL, &error);
+  g_assert_no_error (error);
+  parsed_json = gst_transcoding_job_to_json (parsed, TRUE);
+  fail_unless_equals_string (parsed_json, json);
+  g_free (parsed_json);
+  g_object_unref (parsed);
+  g_object_unref (stream);
+
+  /* Truncated jobs are rejected */
+  json[strlen (json) / 2] = '\0';
+  fail_unless (gst_transcoding_job_from_json (json, &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE));
+  g_clear_error (&error);
+
+  g_free (json);
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_from_json_invalid)
+{
+  GString *nested = g_string_new ("{\"unknown\":");
+  GstTranscodingJob *job;
+  GError *error = NULL;
+  guint i;
+
+  /* Unknown members are skipped, whatever they hold */
+  job = gst_transcoding_job_from_json ("{\"unknown\":[[{\"a\":[1,true]}]],\"outputs\":[],\"inputs\":[]}", &error);
+  g_assert_no_error (error);
+  g_object_unref (job);
+
+  /* As long as they aren't nested deep enough to run out of stack */
+  for (i = 0; i < 100000; i++)
+    g_string_append_c (nested, '[');
+  fail_unless (gst_transcoding_job_from_json (nested->str, &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE));
+  g_clear_error (&error);
+
+  /* Escapes must make valid UTF-8 */
+  fail_unless (gst_transcoding_job_from_json ("{\"outputs\":[{\"uri\":\"file:///\\udc00.mkv\"}]}", &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE));
+  g_clear_error (&error);
+
+  g_string_free (nested, TRUE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_bytes_round_trip)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingJob *parsed;
+  GstTranscodingAudioProfile *aprof;
+  GstTranscodingOutput *output;
+  GError *error = NULL;
+  gchar *json, *parsed_json, *path;
+  guint8 *data;
+  GBytes *bytes;
+  gsize size;
+  gint fd;
+
+  output = gst_transcoding_job_add_output (job, "file:///foo/baz.mkv", NULL);
+  gst_transcoding_output_set_sequence (output, (const gchar *[]) { "file:///foo/bar", NULL });
+  g_object_unref (output);
+  aprof = gst_transcoding_job_map_audio_stream (job, "file:///foo/bar", "stream-id", "file:///foo/baz.mkv");
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_FORMAT_AAC);
+  gst_transcoding_stream_profile_set_bitrate (GST_TRANSCODING_STREAM_PROFILE (aprof), 128000);
+  gst_transcoding_stream_profile_set_rate_control (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_RATE_CONTROL_VBR);
+  g_object_unref (aprof);
+
+  json = gst_transcoding_job_to_json (job, TRUE);
+  bytes = gst_transcoding_job_to_bytes (job);
+
+  /* The binary form holds the same job as the JSON one */
+  parsed = gst_transcoding_job_from_bytes (bytes, &error);
+  g_assert_no_error (error);
+  parsed_json = gst_transcoding_job_to_json (parsed, TRUE);
+  fail_unless_equals_string (parsed_json, json);
+  g_free (parsed_json);
+  g_object_unref (parsed);
+
+  /* Also when mapped from a file */
+  fd = g_file_open_tmp ("gst-transcoding-XXXXXX", &path, &error);
+  g_assert_no_error (error);
+  close (fd);
+  fail_unless (g_file_set_contents (path, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), NULL));
+  parsed = gst_transcoding_job_from_file (path, &error);
+  g_assert_no_error (error);
+  parsed_json = gst_transcoding_job_to_json (parsed, TRUE);
+  fail_unless_equals_string (parsed_json, json);
+  g_free (parsed_json);
+  g_object_unref (parsed);
+  g_unlink (path);
+  g_free (path);
+
+  /* Version 1 had no sequences, and is no longer read */
+  size = g_bytes_get_size (bytes);
+  data = g_malloc (size);
+  memcpy (data, g_bytes_get_data (bytes, NULL), size);
+  GST_WRITE_UINT32_LE (data + 4, 1);
+  g_bytes_unref (bytes);
+  bytes = g_bytes_new_take (data, size);
+  fail_unless (gst_transcoding_job_from_bytes (bytes, &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE));
+  g_clear_error (&error);
+  g_bytes_unref (bytes);
+
+  /* Anything else is rejected */
+  bytes = g_bytes_new_static (json, strlen (json));
+  fail_unless (gst_transcoding_job_from_bytes (bytes, &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_PARSE));
+  g_clear_error (&error);
+  g_bytes_unref (bytes);
+
+  g_free (json);
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_meta_profile_settings_are_copied)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingVideoProfile *meta_vprof, *vprof, *vprof2;
+  GstTranscodingContainerProfile *cprof;
+  GstTranscodingOutput *output;
+
+  meta_vprof = gst_transcoding_video_profile_new ();
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (meta_vprof), GST_TRANSCODING_FORMAT_H264);
+  gst_transcoding_stream_profile_set_speed_preset (GST_TRANSCODING_STREAM_PROFILE (meta_vprof), GST_TRANSCODING_SPEED_PRESET_SLOW);
+  cprof = gst_transcoding_container_profile_new (NULL, g_object_ref (meta_vprof));
+  output = gst_transcoding_job_add_output (job, "file:///foo/baz.mkv", cprof);
+  g_object_unref (output);
+
+  vprof = gst_transcoding_job_map_video_stream (job, "file:///foo/bar", "stream-id", "file:///foo/baz.mkv");
+  vprof2 = gst_transcoding_job_map_video_stream (job, "file:///foo/bar", "stream-id", "file:///foo/baz.mkv");
+
+  /* Encoder settings come along with the format */
+  fail_unless (gst_transcoding_stream_profile_get_speed_preset (GST_TRANSCODING_STREAM_PROFILE (vprof)) == GST_TRANSCODING_SPEED_PRESET_SLOW);
+
+  /* Changing a mapped profile affects neither the meta profile nor the other
+   * profiles mapped from it */
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_NONE);
+  fail_unless (gst_transcoding_stream_profile_get_format (GST_TRANSCODING_STREAM_PROFILE (meta_vprof)) == GST_TRANSCODING_FORMAT_H264);
+  fail_unless (gst_transcoding_stream_profile_get_format (GST_TRANSCODING_STREAM_PROFILE (vprof2)) == GST_TRANSCODING_FORMAT_H264);
+
+  /* Changing the meta profile doesn't affect the profiles already mapped */
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (meta_vprof), GST_TRANSCODING_FORMAT_NONE);
+  fail_unless (gst_transcoding_stream_profile_get_format (GST_TRANSCODING_STREAM_PROFILE (vprof2)) == GST_TRANSCODING_FORMAT_H264);
+
+  g_object_unref (vprof);
+  g_object_unref (vprof2);
+  g_object_unref (meta_vprof);
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_map_streams)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingStreamMapping mappings[] = {
+    { "file:///foo/bar", "video-stream-id", GST_TRANSCODING_MEDIA_TYPE_VIDEO, "file:///foo/baz.mkv" },
+    { "file:///foo/bar", "audio-stream-id", GST_TRANSCODING_MEDIA_TYPE_AUDIO, "file:///foo/baz.mkv" },
+    { "file:///foo/bar", "video-stream-id", GST_TRANSCODING_MEDIA_TYPE_VIDEO, "file:///foo/qux.mkv" },
+  };
+  GstTranscodingStreamMapping conflicting[] = {
+    { "file:///foo/other", "stream-id", GST_TRANSCODING_MEDIA_TYPE_VIDEO, "file:///foo/baz.mkv" },
+    { "file:///foo/bar", "audio-stream-id", GST_TRANSCODING_MEDIA_TYPE_VIDEO, "file:///foo/baz.mkv" },
+  };
+  GstTranscodingInput *input, *input2;
+  GError *error = NULL;
+  GPtrArray *profiles;
+
+  profiles = gst_transcoding_job_map_streams (job, mappings, G_N_ELEMENTS (mappings), &error);
+  g_assert_no_error (error);
+  fail_unless_equals_int (profiles->len, 3);
+  fail_unless (GST_TRANSCODING_IS_VIDEO_PROFILE (g_ptr_array_index (profiles, 0)));
+  fail_unless (GST_TRANSCODING_IS_AUDIO_PROFILE (g_ptr_array_index (profiles, 1)));
+  fail_unless (GST_TRANSCODING_IS_VIDEO_PROFILE (g_ptr_array_index (profiles, 2)));
+
+  /* All of them share the same input */
+  input = gst_transcoding_stream_profile_get_input (g_ptr_array_index (profiles, 0));
+  input2 = gst_transcoding_stream_profile_get_input (g_ptr_array_index (profiles, 2));
+  fail_unless (input == input2);
+  g_object_unref (input);
+  g_object_unref (input2);
+  g_ptr_array_unref (profiles);
+
+  /* A conflict with the job fails the whole batch */
+  fail_unless (gst_transcoding_job_map_streams (job, conflicting, G_N_ELEMENTS (conflicting), &error) == NULL);
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED));
+  g_clear_error (&error);
+
+  /* Including the mappings before the conflicting one, so their input
+   * wasn't created */
+  input = gst_transcoding_job_add_input (job, "file:///foo/other");
+  fail_unless (input != NULL);
+  g_object_unref (input);
+
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_map_video_ladder)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingLadderRung rungs[] = {
+    { "file:///foo/1080.mp4", 0, 1080, 5000000 },
+    { "file:///foo/720.mp4", 0, 720, 3000000 },
+    { "file:///foo/360.mp4", 640, 360, 800000 },
+  };
+  GstTranscodingJob *parsed;
+  GError *error = NULL;
+  GPtrArray *profiles;
+  gchar *json, *parsed_json;
+  guint width, height;
+
+  profiles = gst_transcoding_job_map_video_ladder (job, "file:///foo/bar", "stream-id",
+      rungs, G_N_ELEMENTS (rungs), &error);
+  g_assert_no_error (error);
+  fail_unless_equals_int (profiles->len, 3);
+
+  gst_transcoding_video_profile_get_size (g_ptr_array_index (profiles, 1), &width, &height);
+  fail_unless_equals_int (width, 0);
+  fail_unless_equals_int (height, 720);
+  gst_transcoding_video_profile_get_size (g_ptr_array_index (profiles, 2), &width, &height);
+  fail_unless_equals_int (width, 640);
+  fail_unless_equals_int (height, 360);
+  fail_unless_equals_int (gst_transcoding_stream_profile_get_bitrate (g_ptr_array_index (profiles, 2)), 800000);
+  g_ptr_array_unref (profiles);
+
+  /* Sizes survive serialization */
+  json = gst_transcoding_job_to_json (job, TRUE);
+  fail_unless (strstr (json, "\"height\" : 720") != NULL);
+  parsed = gst_transcoding_job_from_json (json, &error);
+  g_assert_no_error (error);
+  parsed_json = gst_transcoding_job_to_json (parsed, TRUE);
+  fail_unless_equals_string (parsed_json, json);
+  g_free (parsed_json);
+  g_object_unref (parsed);
+  g_free (json);
+
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+#define STRESS_N_INPUTS 16
+#define STRESS_N_STREAMS 2000
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  guint index;
+} StressThread;
+
+static gpointer
+map_streams_thread (StressThread *thread)
+{
+  guint i;
+
+  for (i = 0; i < STRESS_N_STREAMS; i++) {
+    gchar *in_uri = g_strdup_printf ("file:///foo/bar-%u", i % STRESS_N_INPUTS);
+    gchar *out_uri = g_strdup_printf ("file:///foo/baz-%u.mkv", i % STRESS_N_INPUTS);
+    gchar *stream_id = g_strdup_printf ("stream-%u-%u", thread->index, i);
+    GstTranscodingVideoProfile *vprof;
+
+    vprof = gst_transcoding_job_map_video_stream (thread->job, in_uri, stream_id, out_uri);
+    fail_unless (vprof != NULL);
+    g_object_unref (vprof);
+
+    g_free (stream_id);
+    g_free (out_uri);
+    g_free (in_uri);
+  }
+
+  return NULL;
+}
+
+GST_START_TEST (test_concurrent_mapping)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  guint n_threads = MAX (4, g_get_num_processors ());
+  StressThread *threads = g_new0 (StressThread, n_threads);
+  GThread **handles = g_new0 (GThread *, n_threads);
+  guint i, j;
+
+  for (i = 0; i < n_threads; i++) {
+    threads[i].job = job;
+    threads[i].index = i;
+    handles[i] = g_thread_new ("map", (GThreadFunc) map_streams_thread, &threads[i]);
+  }
+
+  for (i = 0; i < n_threads; i++)
+    g_thread_join (handles[i]);
+
+  /* Each input was created once, by whichever thread got there first */
+  for (i = 0; i < STRESS_N_INPUTS; i++) {
+    gchar *in_uri = g_strdup_printf ("file:///foo/bar-%u", i);
+
+    fail_unless (gst_transcoding_job_add_input (job, in_uri) == NULL);
+    g_free (in_uri);
+  }
+
+  /* And no mapping got lost: mapping any of the streams as audio fails */
+  for (i = 0; i < n_threads; i++) {
+    for (j = 0; j < STRESS_N_STREAMS; j++) {
+      gchar *in_uri = g_strdup_printf ("file:///foo/bar-%u", j % STRESS_N_INPUTS);
+      gchar *stream_id = g_strdup_printf ("stream-%u-%u", i, j);
+
+      fail_unless (gst_transcoding_job_map_audio_stream (job, in_uri, stream_id, "file:///foo/baz-0.mkv") == NULL);
+
+      g_free (stream_id);
+      g_free (in_uri);
+    }
+  }
+
+  g_free (handles);
+  g_free (threads);
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_container_from_extension)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  const struct
+  {
+    const gchar *uri;
+    GstTranscodingFormat format;
+  } outputs[] = {
+    { "file:///foo/baz.mkv", GST_TRANSCODING_FORMAT_MATROSKA },
+    { "file:///foo/baz.MP4", GST_TRANSCODING_FORMAT_MP4 },
+    { "file:///foo/baz.webm", GST_TRANSCODING_FORMAT_WEBM },
+    { "file:///foo/baz.ts", GST_TRANSCODING_FORMAT_MPEGTS },
+    { "file:///foo/baz.raw", GST_TRANSCODING_FORMAT_NONE },
+    { "file:///foo.mkv/baz", GST_TRANSCODING_FORMAT_NONE },
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (outputs); i++) {
+    GstTranscodingOutput *output = gst_transcoding_job_add_output (job, outputs[i].uri, NULL);
+    GstTranscodingContainerProfile *cprof = gst_transcoding_output_get_profile (output);
+
+    fail_unless (gst_transcoding_container_profile_get_format (cprof) == outputs[i].format);
+
+    g_object_unref (cprof);
+    g_object_unref (output);
+  }
+
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_transcoding_job_suite (void)
 {
@@ -344,7 +786,16 @@ gst_transcoding_job_suite (void)
   tcase_add_test (tc_chain, test_create_and_free);
   tcase_add_test (tc_chain, test_manual_mapping);
   tcase_add_test (tc_chain, test_automatic_mapping);
+  tcase_add_test (tc_chain, test_container_from_extension);
   tcase_add_test (tc_chain, test_hybrid_mapping);
+  tcase_add_test (tc_chain, test_to_json_compact);
+  tcase_add_test (tc_chain, test_from_json_round_trip);
+  tcase_add_test (tc_chain, test_from_json_invalid);
+  tcase_add_test (tc_chain, test_bytes_round_trip);
+  tcase_add_test (tc_chain, test_meta_profile_settings_are_copied);
+  tcase_add_test (tc_chain, test_map_streams);
+  tcase_add_test (tc_chain, test_map_video_ladder);
+  tcase_add_test (tc_chain, test_concurrent_mapping);
 
   return s;
 }
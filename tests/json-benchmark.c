@@ -0,0 +1,138 @@
+/* Compares the peak memory and time of serializing a large job with
+ * gst_transcoding_job_write_json() against going through a json-glib
+ * document, as gst_transcoding_job_to_json() used to, and of parsing it
+ * back with gst_transcoding_job_from_json() against json-glib's parser and
+ * gst_transcoding_job_from_bytes().
+ *
+ * Usage: json-benchmark stream|dom|parse|dom-parse|binary-parse [n_inputs]
+ *
+ * Each mode must run in its own process for the peak memory to mean
+ * anything, and it only does for the serializing ones: parsing rarely
+ * grows past what building the job in the first place took. */
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <json-glib/json-glib.h>
+#include <gst/transcoding/job.h>
+
+static glong
+get_max_rss_kib (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+
+  return usage.ru_maxrss;
+}
+
+static GstTranscodingJob *
+create_job (guint n_inputs)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  guint i;
+
+  for (i = 0; i < n_inputs; i++) {
+    gchar *in_uri = g_strdup_printf ("file:///media/input-%06u.mkv", i);
+    gchar *out_uri = g_strdup_printf ("file:///media/output-%06u.mkv", i);
+    GstTranscodingVideoProfile *vprof;
+    GstTranscodingAudioProfile *aprof;
+
+    vprof = gst_transcoding_job_map_video_stream (job, in_uri, "video", out_uri);
+    gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_H264);
+    g_object_unref (vprof);
+
+    aprof = gst_transcoding_job_map_audio_stream (job, in_uri, "audio", out_uri);
+    gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (aprof), GST_TRANSCODING_FORMAT_AAC);
+    g_object_unref (aprof);
+
+    g_free (out_uri);
+    g_free (in_uri);
+  }
+
+  return job;
+}
+
+int
+main (int argc, char **argv)
+{
+  GstTranscodingJob *job;
+  const gchar *modes[] = { "stream", "dom", "parse", "dom-parse", "binary-parse", NULL };
+  guint n_inputs = 20000;
+  glong baseline;
+  gint64 start;
+
+  if (argc < 2 || !g_strv_contains (modes, argv[1])) {
+    g_printerr ("Usage: %s stream|dom|parse|dom-parse|binary-parse [n_inputs]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (argc > 2)
+    n_inputs = atoi (argv[2]);
+
+  job = create_job (n_inputs);
+  baseline = get_max_rss_kib ();
+
+  if (!g_strcmp0 (argv[1], "stream")) {
+    GFile *file = g_file_new_for_path ("/dev/null");
+    GOutputStream *stream = G_OUTPUT_STREAM (g_file_append_to (file, G_FILE_CREATE_NONE, NULL, NULL));
+    GError *error = NULL;
+
+    start = g_get_monotonic_time ();
+    if (!gst_transcoding_job_write_json (job, stream, TRUE, NULL, &error))
+      g_error ("Failed to write the job: %s", error->message);
+
+    g_object_unref (stream);
+    g_object_unref (file);
+  } else if (!g_strcmp0 (argv[1], "dom")) {
+    gchar *json = gst_transcoding_job_to_json (job, FALSE);
+    JsonNode *root = json_from_string (json, NULL);
+
+    /* The tree is parsed back rather than built, so only its generation is
+     * timed, but the peak memory is the one of the tree and the string */
+    g_free (json);
+    start = g_get_monotonic_time ();
+    json = json_to_string (root, TRUE);
+
+    g_free (json);
+    json_node_unref (root);
+  } else if (!g_strcmp0 (argv[1], "binary-parse")) {
+    GBytes *bytes = gst_transcoding_job_to_bytes (job);
+    GError *error = NULL;
+
+    g_clear_object (&job);
+    baseline = get_max_rss_kib ();
+    start = g_get_monotonic_time ();
+
+    job = gst_transcoding_job_from_bytes (bytes, &error);
+    if (!job)
+      g_error ("Failed to load the job: %s", error->message);
+
+    g_bytes_unref (bytes);
+  } else {
+    gchar *json = gst_transcoding_job_to_json (job, TRUE);
+
+    /* The job is only needed to get the document */
+    g_clear_object (&job);
+    baseline = get_max_rss_kib ();
+    start = g_get_monotonic_time ();
+
+    if (!g_strcmp0 (argv[1], "parse")) {
+      GError *error = NULL;
+
+      job = gst_transcoding_job_from_json (json, &error);
+      if (!job)
+        g_error ("Failed to parse the job: %s", error->message);
+    } else {
+      json_node_unref (json_from_string (json, NULL));
+    }
+
+    g_free (json);
+  }
+
+  g_print ("%s: %u inputs, %" G_GINT64_FORMAT " us, peak %ld KiB over the job\n",
+      argv[1], n_inputs, g_get_monotonic_time () - start, get_max_rss_kib () - baseline);
+
+  g_clear_object (&job);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/* Measures the cost per mapping of building a large job with
+ * gst_transcoding_job_map_video_stream() / gst_transcoding_job_map_audio_stream()
+ * against gst_transcoding_job_map_streams(), and of the single calls made
+ * from one thread per processor.
+ *
+ * Usage: map-benchmark single|batch|concurrent [n_inputs]
+ */
+
+#include <stdlib.h>
+#include <gst/transcoding/job.h>
+
+#define STREAMS_PER_INPUT 4
+
+static const gchar *stream_ids[STREAMS_PER_INPUT] = { "video", "audio-0", "audio-1", "audio-2" };
+
+typedef struct
+{
+  GstTranscodingJob *job;
+  const gchar *modes[] = { "single", "batch", "concurrent", NULL };
+  GstTranscodingStreamMapping *mappings;
+  guint n_mappings;
+} Slice;
+
+static gpointer
+map_slice (Slice *slice)
+{
+  guint i;
+
+  for (i = 0; i < slice->n_mappings; i++) {
+    GstTranscodingStreamMapping *mapping = &slice->mappings[i];
+    gpointer profile;
+
+    if (mapping->media_type == GST_TRANSCODING_MEDIA_TYPE_VIDEO)
+      profile = gst_transcoding_job_map_video_stream (slice->job, mapping->in_uri, mapping->stream_id, mapping->out_uri);
+    else
+      profile = gst_transcoding_job_map_audio_stream (slice->job, mapping->in_uri, mapping->stream_id, mapping->out_uri);
+
+    g_object_unref (profile);
+  }
+
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  const gchar *modes[] = { "single", "batch", "concurrent", NULL };
+  GstTranscodingStreamMapping *mappings;
+  GstTranscodingJob *job;
+  GPtrArray *uris;
+  guint n_inputs = 100000, n_mappings, i;
+  gint64 start, elapsed;
+
+  if (argc < 2 || !g_strv_contains (modes, argv[1])) {
+    g_printerr ("Usage: %s single|batch|concurrent [n_inputs]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (argc > 2)
+    n_inputs = atoi (argv[2]);
+
+  n_mappings = n_inputs * STREAMS_PER_INPUT;
+  uris = g_ptr_array_new_with_free_func (g_free);
+  mappings = g_new (GstTranscodingStreamMapping, n_mappings);
+
+  for (i = 0; i < n_mappings; i++) {
+    if (i % STREAMS_PER_INPUT == 0) {
+      g_ptr_array_add (uris, g_strdup_printf ("file:///media/input-%06u.mkv", i / STREAMS_PER_INPUT));
+      g_ptr_array_add (uris, g_strdup_printf ("file:///media/output-%06u.mkv", i / STREAMS_PER_INPUT));
+    }
+
+    mappings[i].in_uri = g_ptr_array_index (uris, uris->len - 2);
+    mappings[i].stream_id = stream_ids[i % STREAMS_PER_INPUT];
+    mappings[i].media_type = i % STREAMS_PER_INPUT ? GST_TRANSCODING_MEDIA_TYPE_AUDIO : GST_TRANSCODING_MEDIA_TYPE_VIDEO;
+    mappings[i].out_uri = g_ptr_array_index (uris, uris->len - 1);
+  }
+
+  job = gst_transcoding_job_new ();
+  start = g_get_monotonic_time ();
+
+  if (!g_strcmp0 (argv[1], "single")) {
+    Slice slice = { job, mappings, n_mappings };
+
+    map_slice (&slice);
+  } else if (!g_strcmp0 (argv[1], "batch")) {
+    GPtrArray *profiles = gst_transcoding_job_map_streams (job, mappings, n_mappings, NULL);
+
+    g_ptr_array_unref (profiles);
+  } else {
+    guint n_threads = g_get_num_processors ();
+    Slice *slices = g_new (Slice, n_threads);
+    GThread **threads = g_new (GThread *, n_threads);
+
+    /* Each thread gets whole inputs, so no stream is mapped twice */
+    for (i = 0; i < n_threads; i++) {
+      guint first = n_inputs * i / n_threads * STREAMS_PER_INPUT;
+      guint last = n_inputs * (i + 1) / n_threads * STREAMS_PER_INPUT;
+
+      slices[i].job = job;
+      slices[i].mappings = mappings + first;
+      slices[i].n_mappings = last - first;
+      threads[i] = g_thread_new ("map", (GThreadFunc) map_slice, &slices[i]);
+    }
+
+    for (i = 0; i < n_threads; i++)
+      g_thread_join (threads[i]);
+
+    g_free (threads);
+    g_free (slices);
+  }
+
+  elapsed = g_get_monotonic_time () - start;
+  g_print ("%s: %u mappings, %" G_GINT64_FORMAT " us, %.0f ns per mapping\n",
+      argv[1], n_mappings, elapsed, elapsed * 1000.0 / n_mappings);
+
+  g_object_unref (job);
+  g_free (mappings);
+  g_ptr_array_unref (uris);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+#include <gst/transcoding/scheduler.h>
+
+typedef struct
+{
+  GMainLoop *loop;
+  GPtrArray *finished;
+  guint n_pending;
+} SubmitState;
+
+typedef struct
+{
+  SubmitState *state;
+  const gchar *name;
+  gboolean cancelled;
+} Submission;
+
+static GstTranscodingJob *
+create_missing_input_job (const gchar *dir, const gchar *name)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingVideoProfile *vprof;
+  gchar *out_path, *out_uri;
+
+  out_path = g_build_filename (dir, name, NULL);
+  out_uri = gst_filename_to_uri (out_path, NULL);
+
+  vprof = gst_transcoding_job_map_video_stream (job, "file:///this/does/not/exist.mkv", "stream-id", out_uri);
+  fail_unless (vprof != NULL);
+  gst_transcoding_stream_profile_set_format (GST_TRANSCODING_STREAM_PROFILE (vprof), GST_TRANSCODING_FORMAT_H264);
+  g_object_unref (vprof);
+
+  g_free (out_uri);
+  g_free (out_path);
+
+  return job;
+}
+
+static void
+submit_done_cb (GstTranscodingScheduler *scheduler, GAsyncResult *result, Submission *submission)
+{
+  SubmitState *state = submission->state;
+  GError *error = NULL;
+
+  fail_if (gst_transcoding_scheduler_submit_finish (scheduler, result, &error));
+  fail_unless (error != NULL);
+  fail_unless_equals_int (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED), submission->cancelled);
+  g_error_free (error);
+
+  g_ptr_array_add (state->finished, (gpointer) submission->name);
+  g_free (submission);
+
+  if (--state->n_pending == 0)
+    g_main_loop_quit (state->loop);
+}
+
+static void
+submit_cancellable (GstTranscodingScheduler *scheduler, GstTranscodingJob *job, gint priority,
+                    GCancellable *cancellable, SubmitState *state, const gchar *name)
+{
+  Submission *submission = g_new0 (Submission, 1);
+
+  submission->state = state;
+  submission->name = name;
+  submission->cancelled = g_cancellable_is_cancelled (cancellable);
+  state->n_pending++;
+  gst_transcoding_scheduler_submit (scheduler, job, priority, cancellable,
+      (GAsyncReadyCallback) submit_done_cb, submission);
+}
+
+static void
+submit (GstTranscodingScheduler *scheduler, GstTranscodingJob *job, gint priority,
+        SubmitState *state, const gchar *name)
+{
+  submit_cancellable (scheduler, job, priority, NULL, state, name);
+}
+
+static void
+remove_dir (gchar *dir)
+{
+  GDir *files = g_dir_open (dir, 0, NULL);
+  const gchar *name;
+
+  while ((name = g_dir_read_name (files))) {
+    gchar *path = g_build_filename (dir, name, NULL);
+
+    g_remove (path);
+    g_free (path);
+  }
+  g_dir_close (files);
+  g_rmdir (dir);
+  g_free (dir);
+}
+
+GST_START_TEST (test_submit_priority)
+{
+  GstTranscodingScheduler *scheduler = gst_transcoding_scheduler_new (1);
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  GstTranscodingJob *first, *low, *high;
+  SubmitState state = { 0, };
+
+  fail_unless (dir != NULL);
+  state.loop = g_main_loop_new (NULL, FALSE);
+  state.finished = g_ptr_array_new ();
+
+  first = create_missing_input_job (dir, "first.mkv");
+  low = create_missing_input_job (dir, "low.mkv");
+  high = create_missing_input_job (dir, "high.mkv");
+
+  gst_transcoding_scheduler_set_thread_budget (scheduler, 2);
+  gst_transcoding_scheduler_set_memory_budget (scheduler, 16 * 1024 * 1024);
+
+  /* With a single slot, the first job starts right away and the others
+   * queue up, the high priority one overtaking the low priority one */
+  submit (scheduler, first, 0, &state, "first");
+  submit (scheduler, low, -1, &state, "low");
+  submit (scheduler, high, 1, &state, "high");
+  g_main_loop_run (state.loop);
+
+  fail_unless_equals_int (state.finished->len, 3);
+  fail_unless_equals_string (g_ptr_array_index (state.finished, 0), "first");
+  fail_unless_equals_string (g_ptr_array_index (state.finished, 1), "high");
+  fail_unless_equals_string (g_ptr_array_index (state.finished, 2), "low");
+
+  remove_dir (dir);
+
+  g_ptr_array_unref (state.finished);
+  g_main_loop_unref (state.loop);
+  g_object_unref (first);
+  g_object_unref (low);
+  g_object_unref (high);
+  g_object_unref (scheduler);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_submit_cancelled)
+{
+  GstTranscodingScheduler *scheduler = gst_transcoding_scheduler_new (1);
+  gchar *dir = g_dir_make_tmp ("gst-transcoding-XXXXXX", NULL);
+  GCancellable *cancellable = g_cancellable_new ();
+  GstTranscodingJob *first, *cancelled, *last;
+  SubmitState state = { 0, };
+
+  fail_unless (dir != NULL);
+  state.loop = g_main_loop_new (NULL, FALSE);
+  state.finished = g_ptr_array_new ();
+
+  first = create_missing_input_job (dir, "first.mkv");
+  cancelled = create_missing_input_job (dir, "cancelled.mkv");
+  last = create_missing_input_job (dir, "last.mkv");
+
+  /* Cancelled while pending, it is completed without being run nor holding
+   * up the job behind it */
+  g_cancellable_cancel (cancellable);
+  submit (scheduler, first, 0, &state, "first");
+  submit_cancellable (scheduler, cancelled, 1, cancellable, &state, "cancelled");
+  submit (scheduler, last, 0, &state, "last");
+  g_main_loop_run (state.loop);
+
+  fail_unless_equals_int (state.finished->len, 3);
+  fail_unless_equals_string (g_ptr_array_index (state.finished, 2), "last");
+
+  remove_dir (dir);
+
+  g_ptr_array_unref (state.finished);
+  g_main_loop_unref (state.loop);
+  g_object_unref (cancellable);
+  g_object_unref (first);
+  g_object_unref (cancelled);
+  g_object_unref (last);
+  g_object_unref (scheduler);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_transcoding_scheduler_suite (void)
+{
+  Suite *s = suite_create ("GstTranscodingScheduler");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_submit_priority);
+  tcase_add_test (tc_chain, test_submit_cancelled);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gst_transcoding_scheduler);
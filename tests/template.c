@@ -0,0 +1,143 @@
+#include <gst/check/gstcheck.h>
+#include <gst/transcoding/template.h>
+
+/* Same shape as the template job of the tests, with actual URIs */
+static GstTranscodingJob *
+create_job (const gchar *in_uri, const gchar *out_uri)
+{
+  GstTranscodingJob *job = gst_transcoding_job_new ();
+  GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+  GstTranscodingVideoProfile *vprof;
+  GstTranscodingOutput *output;
+
+  gst_transcoding_container_profile_set_format (cprof, GST_TRANSCODING_FORMAT_NONE);
+  output = gst_transcoding_job_add_output (job, out_uri, cprof);
+  fail_unless (output != NULL);
+  g_object_unref (output);
+
+  vprof = gst_transcoding_job_map_video_stream (job, in_uri, "video", out_uri);
+  fail_unless (vprof != NULL);
+  g_object_unref (vprof);
+
+  return job;
+}
+
+GST_START_TEST (test_instantiate)
+{
+  GstTranscodingJob *job = create_job ("{in}", "{out}");
+  GstTranscodingJobTemplate *template;
+  GHashTable *bindings = g_hash_table_new (g_str_hash, g_str_equal);
+  GError *error = NULL;
+  guint i;
+
+  template = gst_transcoding_job_template_new (job, &error);
+  g_assert_no_error (error);
+  fail_unless (template != NULL);
+  g_object_unref (job);
+
+  for (i = 0; i < 3; i++) {
+    gchar *in_uri = g_strdup_printf ("file:///foo/bar-%u", i);
+    gchar *out_uri = g_strdup_printf ("file:///foo/baz-%u", i);
+    GstTranscodingJob *expected = create_job (in_uri, out_uri);
+    gchar *json, *expected_json;
+
+    g_hash_table_insert (bindings, "in", in_uri);
+    g_hash_table_insert (bindings, "out", out_uri);
+
+    job = gst_transcoding_job_template_instantiate (template, bindings, &error);
+    g_assert_no_error (error);
+    fail_unless (job != NULL);
+
+    json = gst_transcoding_job_to_json (job, FALSE);
+    expected_json = gst_transcoding_job_to_json (expected, FALSE);
+    fail_unless_equals_string (json, expected_json);
+
+    g_free (expected_json);
+    g_free (json);
+    g_object_unref (expected);
+    g_object_unref (job);
+    g_free (out_uri);
+    g_free (in_uri);
+  }
+
+  /* Every placeholder must be bound */
+  g_hash_table_remove_all (bindings);
+  g_hash_table_insert (bindings, "in", "file:///foo/bar");
+  fail_if (gst_transcoding_job_template_instantiate (template, bindings, &error));
+  fail_unless (error != NULL);
+  g_clear_error (&error);
+
+  g_hash_table_unref (bindings);
+  g_object_unref (template);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_instantiate_duplicate_output)
+{
+  GstTranscodingJob *job = create_job ("{in}", "{out}");
+  GstTranscodingContainerProfile *cprof = gst_transcoding_container_profile_new (NULL, NULL);
+  GstTranscodingJobTemplate *template;
+  GHashTable *bindings = g_hash_table_new (g_str_hash, g_str_equal);
+  GstTranscodingOutput *output;
+  GstTranscodingVideoProfile *vprof;
+  GError *error = NULL;
+
+  gst_transcoding_container_profile_set_format (cprof, GST_TRANSCODING_FORMAT_NONE);
+  output = gst_transcoding_job_add_output (job, "{other}", cprof);
+  g_object_unref (output);
+  vprof = gst_transcoding_job_map_video_stream (job, "{in}", "video", "{other}");
+  g_object_unref (vprof);
+
+  template = gst_transcoding_job_template_new (job, &error);
+  g_assert_no_error (error);
+  g_object_unref (job);
+
+  /* The profile of the output that could not be added is not leaked */
+  g_hash_table_insert (bindings, "in", "file:///foo/bar");
+  g_hash_table_insert (bindings, "out", "file:///foo/baz");
+  g_hash_table_insert (bindings, "other", "file:///foo/baz");
+  fail_if (gst_transcoding_job_template_instantiate (template, bindings, &error));
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_FAILED));
+  g_clear_error (&error);
+
+  g_hash_table_unref (bindings);
+  g_object_unref (template);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_invalid_template)
+{
+  GstTranscodingJob *job = create_job ("{in}", "{out}");
+  GstTranscodingAudioProfile *aprof;
+  GError *error = NULL;
+
+  /* Without a container, an output can only hold a single stream */
+  aprof = gst_transcoding_job_map_audio_stream (job, "{in}", "audio", "{out}");
+  g_object_unref (aprof);
+
+  fail_if (gst_transcoding_job_template_new (job, &error));
+  fail_unless (g_error_matches (error, GST_TRANSCODING_ERROR, GST_TRANSCODING_ERROR_NOT_SUPPORTED));
+  g_error_free (error);
+
+  g_object_unref (job);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_transcoding_template_suite (void)
+{
+  Suite *s = suite_create ("GstTranscodingJobTemplate");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_instantiate);
+  tcase_add_test (tc_chain, test_instantiate_duplicate_output);
+  tcase_add_test (tc_chain, test_invalid_template);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gst_transcoding_template);
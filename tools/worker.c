@@ -0,0 +1,36 @@
+#include <gst/transcoding/job.h>
+
+/* Worker process for segment-parallel jobs, see
+ * gst_transcoding_job_set_worker_executable() */
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  gint fd = 3;
+  GOptionEntry entries[] = {
+    { "fd", 0, 0, G_OPTION_ARG_INT, &fd, "File descriptor of the coordinator socket", "FD" },
+    { NULL }
+  };
+
+  context = g_option_context_new ("- gst-transcoding worker");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    g_option_context_free (context);
+    return 1;
+  }
+
+  g_option_context_free (context);
+
+  if (!gst_transcoding_worker_main (fd, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    return 1;
+  }
+
+  return 0;
+}